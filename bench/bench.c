@@ -0,0 +1,923 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "list.h"
+#include "darray.h"
+#include "arena.h"
+#include "hashing.h"
+#include "intern.h"
+#include "bstree.h"
+#include "containers.h"
+#include "desktop_entries.h"
+#include "icons.h"
+
+// Microbenchmarks for the containers and parsers.
+// Every result is one line of key=value pairs, timings are the median and p95 over all runs.
+
+#define DEFAULT_RUNS 21
+#define DEFAULT_SIZE 10000
+#define DESKTOP_FILES 500
+
+static int runs = DEFAULT_RUNS;
+static size_t size = DEFAULT_SIZE;
+static const char *app_dir = NULL;
+
+static volatile size_t sink;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+// xorshift64, so every run of the bench sees the same keys
+static uint64_t Random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static long long NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int LongLongCmp(const void *a, const void *b)
+{
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+static int SizeCmp(const void *a, const void *b)
+{
+    size_t x = *(const size_t*)a;
+    size_t y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Percentile of an already sorted array
+#define PERCENTILE(array, count, p) ((array)[MIN((count) - 1, (size_t)((double)(count) * (p) / 100.0))])
+
+// ops and bytes are per run, pass 0 to leave out the throughput
+static void Report(const char *name, long long *samples, size_t ops, size_t bytes)
+{
+    qsort(samples, runs, sizeof(*samples), LongLongCmp);
+
+    long long median = PERCENTILE(samples, (size_t)runs, 50);
+    long long p95 = PERCENTILE(samples, (size_t)runs, 95);
+
+    printf("bench=%s runs=%d median_ns=%lld p95_ns=%lld", name, runs, median, p95);
+
+    if (ops)
+        printf(" ops=%zu ns_per_op=%.2f", ops, (double)median / ops);
+
+    if (bytes)
+        printf(" bytes=%zu mb_per_sec=%.2f", bytes, (bytes / (1024.0 * 1024.0)) / (median / 1e9));
+
+    printf("\n");
+}
+
+// Probe lengths are counted in slots, a key sitting in its home slot has a probe length of 1
+static void ReportProbes(const char *name, size_t *probes, size_t count, size_t capacity)
+{
+    if (count == 0)
+        return;
+
+    qsort(probes, count, sizeof(*probes), SizeCmp);
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += probes[i];
+
+    printf("bench=%s keys=%zu capacity=%zu load=%.2f mean=%.2f p50=%zu p95=%zu p99=%zu max=%zu\n",
+           name, count, capacity, (double)count / capacity, (double)total / count,
+           PERCENTILE(probes, count, 50), PERCENTILE(probes, count, 95),
+           PERCENTILE(probes, count, 99), probes[count - 1]);
+}
+
+// Names shaped like the ones found in icon themes and desktop entries
+static char **CreateKeys(size_t count)
+{
+    static const char *prefixes[] = { "applications-", "org.gnome.", "org.kde.", "preferences-", "system-", "" };
+    static const char *words[] = { "audio", "video", "editor", "terminal", "browser", "settings", "viewer", "player", "monitor", "manager" };
+
+    char **keys = malloc(sizeof(*keys) * count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "%s%s-%s%zu",
+                 prefixes[Random() % ARRAY_SIZE(prefixes)],
+                 words[Random() % ARRAY_SIZE(words)],
+                 words[Random() % ARRAY_SIZE(words)], i);
+        keys[i] = strdup(buffer);
+    }
+
+    return keys;
+}
+
+static void DestroyKeys(char **keys, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        free(keys[i]);
+    free(keys);
+}
+
+static void Shuffle(char **keys, size_t count)
+{
+    for (size_t i = count - 1; i > 0; i--)
+    {
+        size_t j = Random() % (i + 1);
+        char *temp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = temp;
+    }
+}
+
+#define LABEL_SIZE 128
+
+static const char *Label(char *label, const char *name, const char *what)
+{
+    snprintf(label, LABEL_SIZE, "%s_%s", name, what);
+    return label;
+}
+
+static void BenchHashMap(const char *name, char **keys, char **misses, size_t count)
+{
+    char label[LABEL_SIZE];
+    long long samples[runs];
+    HashMap *map = NULL;
+
+    for (int run = 0; run < runs; run++)
+    {
+        map = HashMapCreate();
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            HashMapInsert(map, keys[i], keys[i]);
+        samples[run] = NowNs() - start;
+
+        if (run + 1 < runs)
+            HashMapDestroy(map);
+    }
+    Report(Label(label, name, "insert"), samples, count, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            found += HashMapGet(map, keys[i]) != NULL;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report(Label(label, name, "get_hit"), samples, count, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            found += HashMapGet(map, misses[i]) != NULL;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report(Label(label, name, "get_miss"), samples, count, 0);
+
+    size_t *probes = malloc(sizeof(*probes) * map->table.size);
+    size_t probe_count = HashTableProbeLengths(&map->table, probes);
+    ReportProbes(Label(label, name, "probes"), probes, probe_count, map->table.capacity);
+    free(probes);
+
+    HashMapDestroy(map);
+}
+
+static void NoDestroy(void *ptr)
+{
+    (void)ptr;
+}
+
+static void BenchHashMap2(const char *name, char **keys, char **misses, size_t count)
+{
+    char label[LABEL_SIZE];
+    long long samples[runs];
+    HashMap2 *map = NULL;
+
+    for (int run = 0; run < runs; run++)
+    {
+        map = HashMapCreate2(NoDestroy, NULL);
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            HashMapInsert2(map, keys[i], keys[i]);
+        samples[run] = NowNs() - start;
+
+        if (run + 1 < runs)
+            HashMapDestroy2(map);
+    }
+    Report(Label(label, name, "insert"), samples, count, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            found += HashMapGet2(map, keys[i]) != NULL;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report(Label(label, name, "get_hit"), samples, count, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            found += HashMapGet2(map, misses[i]) != NULL;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report(Label(label, name, "get_miss"), samples, count, 0);
+
+    size_t *probes = malloc(sizeof(*probes) * map->table.size);
+    size_t probe_count = HashTableProbeLengths(&map->table, probes);
+    ReportProbes(Label(label, name, "probes"), probes, probe_count, map->table.capacity);
+    free(probes);
+
+    HashMapDestroy2(map);
+}
+
+static void BenchHashSet(const char *name, char **keys, char **misses, size_t count)
+{
+    char label[LABEL_SIZE];
+    long long samples[runs];
+    HashSet *set = NULL;
+
+    for (int run = 0; run < runs; run++)
+    {
+        set = HashSetCreate(32);
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            HashSetInsert(set, keys[i]);
+        samples[run] = NowNs() - start;
+
+        if (run + 1 < runs)
+            HashSetDestroy(set);
+    }
+    Report(Label(label, name, "insert"), samples, count, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            found += HashSetContains(set, keys[i]);
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report(Label(label, name, "contains_hit"), samples, count, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            found += HashSetContains(set, misses[i]);
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report(Label(label, name, "contains_miss"), samples, count, 0);
+
+    size_t *probes = malloc(sizeof(*probes) * set->table.size);
+    size_t probe_count = HashTableProbeLengths(&set->table, probes);
+    ReportProbes(Label(label, name, "probes"), probes, probe_count, set->table.capacity);
+    free(probes);
+
+    HashSetDestroy(set);
+}
+
+static int StringCmp(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+static inline int StrCmp(char *const *a, char *const *b)
+{
+    return strcmp(*a, *b);
+}
+
+// qsort hands over pointers to the elements
+static int KeyCmp(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void BenchBSTInsert(const char *name, char **keys, size_t count)
+{
+    long long samples[runs];
+
+    for (int run = 0; run < runs; run++)
+    {
+        BTreeNode *root = NULL;
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            root = BSTInsertNode(root, keys[i], StringCmp);
+        samples[run] = NowNs() - start;
+
+        BSTDestroy(&root, NoDestroy);
+    }
+    Report(name, samples, count, 0);
+}
+
+static void BenchBST(char **keys)
+{
+    // Inserting in sorted order degrades the tree into a list, so keep it small enough to finish
+    size_t count = MIN(size, 2000);
+
+    char **sorted = malloc(sizeof(*sorted) * count);
+    memcpy(sorted, keys, sizeof(*sorted) * count);
+    qsort(sorted, count, sizeof(*sorted), KeyCmp);
+
+    BenchBSTInsert("bst_insert_sorted", sorted, count);
+
+    Shuffle(sorted, count);
+    BenchBSTInsert("bst_insert_random", sorted, count);
+
+    free(sorted);
+}
+
+// The linear search wants a match test, the binary search wants an ordering
+static int DArrayMatchCmp(const void *a, const void *b)
+{
+    return strcmp(a, b) == 0;
+}
+
+static void BenchDArray(char **keys)
+{
+    long long samples[runs];
+    DArray *darray = DArrayCreate(size, NULL, DArrayMatchCmp, KeyCmp);
+
+    for (int run = 0; run < runs; run++)
+    {
+        darray->size = 0;
+        for (size_t i = 0; i < size; i++)
+            DArrayAdd(darray, keys[i]);
+
+        long long start = NowNs();
+        DArraySort(darray);
+        samples[run] = NowNs() - start;
+    }
+    Report("darray_sort", samples, size, 0);
+
+    // A linear search over all keys is quadratic, only look up a slice of them
+    size_t lookups = MIN(size, 1000);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < lookups; i++)
+            found += DArrayLinearSearch(darray, keys[(i * 7919) % size]) != NULL;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report("darray_search_linear", samples, lookups, 0);
+
+    darray->SearchCompareCallback = StringCmp;
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < size; i++)
+            found += DArrayBinarySearch(darray, keys[i]) != NULL;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report("darray_search_binary", samples, size, 0);
+
+    DArrayDestroy(darray);
+}
+
+VEC_DEFINE_SORTED(StrVec, char*, const char*, StrCmp, StrKeyCmp)
+
+static void BenchStrVec(char **keys)
+{
+    long long samples[runs];
+    StrVec vec;
+    StrVecInit(&vec, size);
+
+    for (int run = 0; run < runs; run++)
+    {
+        vec.size = 0;
+        for (size_t i = 0; i < size; i++)
+            StrVecPush(&vec, keys[i]);
+
+        long long start = NowNs();
+        StrVecSort(&vec);
+        samples[run] = NowNs() - start;
+    }
+    Report("strvec_sort", samples, size, 0);
+
+    size_t lookups = MIN(size, 1000);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < lookups; i++)
+            found += StrVecIndexOf(&vec, keys[(i * 7919) % size]) != VEC_NOT_FOUND;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report("strvec_search_linear", samples, lookups, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < size; i++)
+            found += StrVecFind(&vec, keys[i]) != NULL;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report("strvec_search_binary", samples, size, 0);
+
+    StrVecDestroy(&vec);
+}
+
+// First sight of every key, then the same keys again, which is what most category and directory names are
+static void BenchIntern(char **keys)
+{
+    long long samples[runs];
+
+    for (int run = 0; run < runs; run++)
+    {
+        InternDestroy();
+        long long start = NowNs();
+        for (size_t i = 0; i < size; i++)
+            Intern(keys[i]);
+        samples[run] = NowNs() - start;
+    }
+    Report("intern_insert", samples, size, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < size; i++)
+            found += Intern(keys[i])->len;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report("intern_hit", samples, size, 0);
+
+    InternDestroy();
+}
+
+// What LoadDesktopEntries used to insert the entries with
+static int EntryNameCmp(const void *a, const void *b)
+{
+    return strcasecmp(((const XDGDesktopEntry*)a)->name, ((const XDGDesktopEntry*)b)->name);
+}
+
+static int EntryNameKeyCmp(const void *a, const void *b)
+{
+    return strcasecmp(((const XDGDesktopEntry*)a)->name, b);
+}
+
+// The entry store as a tree against the sorted vector, with the names in directory (random) order
+static void BenchEntryStore(char **keys)
+{
+    long long samples[runs];
+    XDGDesktopEntry *entries = calloc(size, sizeof(*entries));
+    char **shuffled = malloc(sizeof(*shuffled) * size);
+
+    memcpy(shuffled, keys, sizeof(*shuffled) * size);
+    Shuffle(shuffled, size);
+    for (size_t i = 0; i < size; i++)
+        entries[i].name = shuffled[i];
+
+    BTreeNode *root = NULL;
+    for (int run = 0; run < runs; run++)
+    {
+        BSTDestroy(&root, NoDestroy);
+        long long start = NowNs();
+        for (size_t i = 0; i < size; i++)
+            root = BSTInsertNode(root, &entries[i], EntryNameCmp);
+        samples[run] = NowNs() - start;
+    }
+    Report("entries_bst_build", samples, size, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < size; i++)
+            found += BSTSearchNode(root, keys[i], EntryNameKeyCmp) != NULL;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report("entries_bst_search", samples, size, 0);
+    BSTDestroy(&root, NoDestroy);
+
+    EntryStore *store = EntriesCreate();
+    for (int run = 0; run < runs; run++)
+    {
+        store->entries.size = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < size; i++)
+            EntryVecPush(&store->entries, &entries[i]);
+        EntriesSort(store);
+        samples[run] = NowNs() - start;
+    }
+    Report("entries_vec_build", samples, size, 0);
+
+    for (int run = 0; run < runs; run++)
+    {
+        size_t found = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < size; i++)
+            found += EntriesSearch(store, keys[i]) != NULL;
+        samples[run] = NowNs() - start;
+        sink = found;
+    }
+    Report("entries_vec_search", samples, size, 0);
+
+    // The entries belong to this function, not to the store's arena, which stays empty
+    EntriesDestroy(store);
+    free(shuffled);
+    free(entries);
+}
+
+static void WriteDesktopFile(const char *dir, size_t index)
+{
+    static const char *categories[] = { "AudioVideo;Audio;", "Development;IDE;", "Graphics;Viewer;", "Network;WebBrowser;",
+                                        "Office;WordProcessor;", "System;TerminalEmulator;", "Utility;TextEditor;", "Game;" };
+    static const char *locales[] = { "de", "es", "fr", "it", "ja", "pt_BR", "ru", "zh_CN" };
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench-app-%zu.desktop", dir, index);
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return;
+
+    fprintf(fp, "[Desktop Entry]\nType=Application\nVersion=1.0\nName=Bench App %zu\n", index);
+
+    for (size_t i = 0; i < ARRAY_SIZE(locales); i++)
+    {
+        fprintf(fp, "Name[%s]=Bench App %zu (%s)\n", locales[i], index, locales[i]);
+        fprintf(fp, "Comment[%s]=A generated application used to benchmark the parser\n", locales[i]);
+    }
+
+    fprintf(fp, "Comment=A generated application used to benchmark the parser\n"
+                "Exec=bench-app-%zu %%U\nIcon=bench-app-%zu\nTerminal=false\n"
+                "Categories=%s\nKeywords=bench;generated;test;\nStartupNotify=true\n\n"
+                "[Desktop Action new-window]\nName=New Window\nExec=bench-app-%zu --new-window\n",
+                index, index, categories[index % ARRAY_SIZE(categories)], index);
+
+    fclose(fp);
+}
+
+static void BenchDesktopEntries(void)
+{
+    char temp_dir[] = "/tmp/jwm-bench-XXXXXX";
+    const char *dir = app_dir;
+
+    if (dir == NULL)
+    {
+        if (mkdtemp(temp_dir) == NULL)
+        {
+            perror("mkdtemp");
+            return;
+        }
+
+        for (size_t i = 0; i < DESKTOP_FILES; i++)
+            WriteDesktopFile(temp_dir, i);
+
+        dir = temp_dir;
+    }
+
+    DArray *paths = DArrayCreate(256, free, NULL, NULL);
+    size_t bytes = 0;
+
+    DIR *d = opendir(dir);
+    struct dirent *dirp;
+    while (d != NULL && (dirp = readdir(d)) != NULL)
+    {
+        char *ext = strrchr(dirp->d_name, '.');
+        if (ext == NULL || strcmp(ext, ".desktop") != 0)
+            continue;
+
+        char path[512];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, dirp->d_name);
+        if (stat(path, &st) != 0)
+            continue;
+
+        bytes += st.st_size;
+        DArrayAdd(paths, strdup(path));
+    }
+    if (d != NULL)
+        closedir(d);
+
+    long long samples[runs];
+
+    // Freeing the arena is part of each run, like freeing every entry was
+    for (int run = 0; run < runs && paths->size; run++)
+    {
+        Arena arena;
+        ArenaInit(&arena, 64 * 1024);
+
+        long long start = NowNs();
+        for (size_t i = 0; i < paths->size; i++)
+            ReadDesktopEntry(paths->data[i], &arena);
+        ArenaDestroy(&arena);
+        samples[run] = NowNs() - start;
+    }
+
+    if (paths->size)
+        Report("read_desktop_entry", samples, paths->size, bytes);
+
+    if (dir == temp_dir)
+    {
+        for (size_t i = 0; i < paths->size; i++)
+            unlink(paths->data[i]);
+        rmdir(temp_dir);
+    }
+
+    DArrayDestroy(paths);
+}
+
+static void BenchIconThemes(void)
+{
+    const char *icon_dir = GetIconBaseDir();
+    DIR *d = opendir(icon_dir);
+    if (d == NULL)
+        return;
+
+    struct dirent *dirp;
+    while ((dirp = readdir(d)) != NULL)
+    {
+        if (dirp->d_name[0] == '.')
+            continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s/index.theme", icon_dir, dirp->d_name);
+        if (access(path, R_OK) != 0)
+            continue;
+
+        long long samples[runs];
+        size_t num_dirs = 0;
+
+        for (int run = 0; run < runs; run++)
+        {
+            long long start = NowNs();
+            IconTheme *theme = LoadIconTheme(dirp->d_name);
+            samples[run] = NowNs() - start;
+
+            num_dirs = theme->icon_dirs.size;
+            UnLoadIconTheme(theme);
+        }
+
+        char name[300];
+        snprintf(name, sizeof(name), "parse_theme_icons theme=%s dirs=%zu", dirp->d_name, num_dirs);
+        Report(name, samples, 0, 0);
+    }
+
+    closedir(d);
+}
+
+// Every file name, without its extension, in the themes under the icon dir
+static void CollectIconNames(const char *path, int depth, HashSet *seen, DArray *names)
+{
+    DIR *d = opendir(path);
+    if (d == NULL)
+        return;
+
+    struct dirent *dirp;
+    while ((dirp = readdir(d)) != NULL)
+    {
+        if (dirp->d_name[0] == '.')
+            continue;
+
+        char child[1024];
+        struct stat st;
+        snprintf(child, sizeof(child), "%s/%s", path, dirp->d_name);
+        if (stat(child, &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+        {
+            if (depth < 4)
+                CollectIconNames(child, depth + 1, seen, names);
+            continue;
+        }
+
+        char name[256];
+        snprintf(name, sizeof(name), "%s", dirp->d_name);
+        char *ext = strrchr(name, '.');
+        if (ext != NULL)
+            *ext = '\0';
+
+        if (!HashSetContains(seen, name))
+        {
+            HashSetInsert(seen, name);
+            DArrayAdd(names, strdup(name));
+        }
+    }
+
+    closedir(d);
+}
+
+// FNV-1a, which the tables used before HashBytes, to compare against
+static uint64_t Fnv1a(const char *key, size_t len)
+{
+    uint64_t hash = 14695981039346656037u;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211u;
+    }
+
+    return hash;
+}
+
+static void BenchHashFunctions(const char *name, char **keys, size_t count)
+{
+    char label[LABEL_SIZE];
+    long long samples[runs];
+    size_t *lengths = malloc(sizeof(*lengths) * count);
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        lengths[i] = strlen(keys[i]);
+        bytes += lengths[i];
+    }
+
+    for (int run = 0; run < runs; run++)
+    {
+        uint64_t sum = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            sum ^= HashBytes(keys[i], lengths[i]);
+        samples[run] = NowNs() - start;
+        sink = sum;
+    }
+    Report(Label(label, name, "hash_bytes"), samples, count, bytes);
+
+    for (int run = 0; run < runs; run++)
+    {
+        uint64_t sum = 0;
+        long long start = NowNs();
+        for (size_t i = 0; i < count; i++)
+            sum ^= Fnv1a(keys[i], lengths[i]);
+        samples[run] = NowNs() - start;
+        sink = sum;
+    }
+    Report(Label(label, name, "fnv1a"), samples, count, bytes);
+
+    free(lengths);
+}
+
+// The hashing and container benchmarks again, with a set of real names as keys
+static void BenchKeySet(const char *name, DArray *names)
+{
+    char label[LABEL_SIZE];
+    size_t count = names->size;
+    char **keys = (char**)names->data;
+    char **misses = malloc(sizeof(*misses) * count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        misses[i] = strdup(keys[i]);
+        misses[i][0] = '#';
+    }
+
+    BenchHashFunctions(name, keys, count);
+    BenchHashMap(Label(label, name, "hashmap"), keys, misses, count);
+    BenchHashSet(Label(label, name, "hashset"), keys, misses, count);
+
+    DestroyKeys(misses, count);
+}
+
+static void BenchIconNames(void)
+{
+    HashSet *seen = HashSetCreate(1024);
+    DArray *names = DArrayCreate(1024, free, NULL, NULL);
+
+    CollectIconNames(GetIconBaseDir(), 0, seen, names);
+    HashSetDestroy(seen);
+
+    if (names->size)
+        BenchKeySet("icon_names", names);
+
+    DArrayDestroy(names);
+}
+
+// Desktop IDs are the file names of the entries, only taken from -a
+static void BenchDesktopIds(void)
+{
+    if (app_dir == NULL)
+        return;
+
+    DArray *names = DArrayCreate(256, free, NULL, NULL);
+
+    DIR *d = opendir(app_dir);
+    struct dirent *dirp;
+    while (d != NULL && (dirp = readdir(d)) != NULL)
+    {
+        char *ext = strrchr(dirp->d_name, '.');
+        if (ext != NULL && strcmp(ext, ".desktop") == 0)
+            DArrayAdd(names, strdup(dirp->d_name));
+    }
+    if (d != NULL)
+        closedir(d);
+
+    if (names->size)
+        BenchKeySet("desktop_ids", names);
+
+    DArrayDestroy(names);
+}
+
+static void Usage(void)
+{
+    printf("Usage: bench [-n runs] [-s keys] [-a app_dir] [-i icon_dir]\n\n"
+           "  -n RUNS    Runs per benchmark (default %d)\n"
+           "  -s KEYS    Number of keys for the container benchmarks (default %d)\n"
+           "  -a DIR     Parse the desktop entries in DIR instead of generated ones\n"
+           "  -i DIR     Parse the icon themes and take the icon names from DIR instead of /usr/share/icons\n",
+           DEFAULT_RUNS, DEFAULT_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "hn:s:a:i:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                runs = atoi(optarg);
+                break;
+            case 's':
+                size = strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                app_dir = optarg;
+                break;
+            case 'i':
+                SetIconBaseDir(optarg);
+                break;
+            case 'h':
+            default:
+                Usage();
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (runs < 1 || size < 1)
+    {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    char **keys = CreateKeys(size);
+    char **misses = CreateKeys(size);
+
+    // Make sure the misses can't be found
+    for (size_t i = 0; i < size; i++)
+        misses[i][0] = '#';
+
+    BenchHashFunctions("keys", keys, size);
+    BenchHashMap("hashmap", keys, misses, size);
+    BenchHashMap2("hashmap2", keys, misses, size);
+    BenchHashSet("hashset", keys, misses, size);
+    BenchBST(keys);
+    BenchDArray(keys);
+    BenchStrVec(keys);
+    BenchIntern(keys);
+    BenchEntryStore(keys);
+    BenchDesktopEntries();
+    BenchIconThemes();
+    BenchIconNames();
+    BenchDesktopIds();
+
+    DestroyKeys(keys, size);
+    DestroyKeys(misses, size);
+    InternDestroy();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,486 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+// Builds a synthetic tree of desktop entries and icon themes for scaling runs.
+//
+// DIR/applications/       N desktop entries
+// DIR/icons/Fixture-0..M  themes shaped like Papirus, each one inheriting the next, the last one inherits hicolor
+// DIR/icons/hicolor
+// DIR/home/               .gtkrc-2.0 and a jwms.conf that point at the above
+//
+// Run jwm-helper on it with HOME=DIR/home JWMS_APP_DIR=DIR/applications JWMS_ICON_DIR=DIR/icons
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+static size_t num_entries = 1000;
+static size_t num_themes = 3;
+static size_t files_per_dir = 2000;
+static uint64_t rng_state = 0x2545F4914F6CDD1Dull;
+
+static const char *locales[] =
+{
+    "ar", "ca", "cs", "da", "de", "el", "es", "fi", "fr", "he", "hu", "it",
+    "ja", "ko", "nl", "pl", "pt", "pt_BR", "ru", "sv", "tr", "uk", "zh_CN", "zh_TW"
+};
+
+// Roughly what a desktop with a few hundred applications installed looks like
+static const struct
+{
+    const char *categories;
+    int weight;
+} category_mix[] =
+{
+    { "Utility;",                      18 },
+    { "Utility;TextEditor;",            3 },
+    { "Development;IDE;",               6 },
+    { "Development;Debugger;",          4 },
+    { "Network;WebBrowser;",            3 },
+    { "Network;Email;",                 4 },
+    { "Network;InstantMessaging;",      4 },
+    { "Graphics;Viewer;",               5 },
+    { "Graphics;2DGraphics;RasterGraphics;", 3 },
+    { "AudioVideo;Audio;Player;",       5 },
+    { "AudioVideo;Video;Player;",       4 },
+    { "Office;WordProcessor;",          3 },
+    { "Office;Spreadsheet;",            3 },
+    { "System;Monitor;",                6 },
+    { "System;FileManager;",            2 },
+    { "Settings;DesktopSettings;",      8 },
+    { "Settings;HardwareSettings;",     4 },
+    { "Game;ArcadeGame;",               4 },
+    { "Education;Languages;",           2 },
+    { "Science;Math;",                  2 },
+    { "Qt;KDE;Utility;",                3 },
+    { "GTK;GNOME;Utility;",             3 }
+};
+
+// Contexts of a Papirus-like theme, the number of files in each is relative to files_per_dir
+static const struct
+{
+    const char *name;
+    const char *context;
+    int divisor;
+} theme_contexts[] =
+{
+    { "apps",       "Applications", 1  },
+    { "actions",    "Actions",      2  },
+    { "categories", "Categories",   16 },
+    { "devices",    "Devices",      8  },
+    { "emblems",    "Emblems",      16 },
+    { "emotes",     "Emotes",       16 },
+    { "mimetypes",  "MimeTypes",    2  },
+    { "places",     "Places",       4  },
+    { "status",     "Status",       4  },
+    { "panel",      "Status",       8  }
+};
+
+static const int theme_sizes[] = { 16, 18, 22, 24, 32, 48, 64, 84, 96, 128 };
+static const int hicolor_sizes[] = { 16, 22, 24, 32, 48, 64, 128, 256, 512 };
+
+static const char *extra_icons[] =
+{
+    "applications-multimedia", "applications-development", "applications-education", "applications-games",
+    "applications-graphics", "applications-internet", "applications-office", "applications-science",
+    "applications-system", "applications-utilities", "preferences-desktop", "system-search",
+    "view-refresh", "system-log-out", "system-shutdown", "system-reboot"
+};
+
+static uint64_t Random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static int MakeDirs(const char *path)
+{
+    char buffer[1024];
+    strncpy(buffer, path, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    for (char *c = buffer + 1; *c; c++)
+    {
+        if (*c != '/')
+            continue;
+
+        *c = '\0';
+        if (mkdir(buffer, 0755) != 0 && errno != EEXIST)
+            return -1;
+        *c = '/';
+    }
+
+    if (mkdir(buffer, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Failed to create %s: %s\n", buffer, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static void TouchFile(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0)
+        close(fd);
+}
+
+static const char *PickCategories(void)
+{
+    int total = 0;
+    for (size_t i = 0; i < ARRAY_SIZE(category_mix); i++)
+        total += category_mix[i].weight;
+
+    int pick = Random() % total;
+    for (size_t i = 0; i < ARRAY_SIZE(category_mix); i++)
+    {
+        pick -= category_mix[i].weight;
+        if (pick < 0)
+            return category_mix[i].categories;
+    }
+
+    return category_mix[0].categories;
+}
+
+// Most entries use an icon of the top theme, some only exist further down the inheritance chain,
+// in hicolor, or nowhere at all
+static void GetEntryIcon(char *icon, size_t size, size_t index)
+{
+    switch (index % 20)
+    {
+        case 17:
+            snprintf(icon, size, "hicolor-app-%zu", index % files_per_dir);
+            break;
+        case 18:
+            snprintf(icon, size, "missing-app-%zu", index);
+            break;
+        case 19:
+            snprintf(icon, size, "app-%zu", files_per_dir * (num_themes - 1) / 2 + index % files_per_dir);
+            break;
+        default:
+            snprintf(icon, size, "app-%zu", index % files_per_dir);
+            break;
+    }
+}
+
+static int WriteDesktopEntry(const char *dir, size_t index)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/fixture-app-%05zu.desktop", dir, index);
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    // The first few entries are the core programs the menu and tray look for
+    const char *categories;
+    switch (index)
+    {
+        case 0: categories = "System;TerminalEmulator;"; break;
+        case 1: categories = "Network;WebBrowser;"; break;
+        case 2: categories = "System;FileManager;"; break;
+        case 3: categories = "Utility;TextEditor;"; break;
+        default: categories = PickCategories(); break;
+    }
+
+    char icon[64];
+    GetEntryIcon(icon, sizeof(icon), index);
+
+    fprintf(fp, "[Desktop Entry]\n"
+                "Type=Application\n"
+                "Version=1.0\n"
+                "Name=Fixture App %zu\n"
+                "GenericName=Generated Application\n", index);
+
+    for (size_t i = 0; i < ARRAY_SIZE(locales); i++)
+    {
+        fprintf(fp, "Name[%s]=Fixture App %zu (%s)\n", locales[i], index, locales[i]);
+        fprintf(fp, "GenericName[%s]=Generated Application (%s)\n", locales[i], locales[i]);
+        fprintf(fp, "Comment[%s]=Synthetic entry number %zu used for scaling runs (%s)\n", locales[i], index, locales[i]);
+    }
+
+    fprintf(fp, "Comment=Synthetic entry number %zu used for scaling runs\n"
+                "Exec=fixture-app-%zu %%U\n"
+                "TryExec=fixture-app-%zu\n"
+                "Icon=%s\n"
+                "Terminal=false\n"
+                "Categories=%s\n"
+                "Keywords=fixture;generated;scaling;\n"
+                "MimeType=text/plain;image/png;\n"
+                "StartupNotify=true\n"
+                "StartupWMClass=fixture-app-%zu\n",
+                index, index, index, icon, categories, index);
+
+    // A few entries are hidden from the menu
+    if (index > 3 && index % 25 == 0)
+        fprintf(fp, "NoDisplay=true\n");
+
+    if (index % 4 == 0)
+    {
+        fprintf(fp, "Actions=new-window;\n\n"
+                    "[Desktop Action new-window]\n"
+                    "Name=New Window\n"
+                    "Exec=fixture-app-%zu --new-window\n", index);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static int WriteIconFiles(const char *dir, const char *prefix, size_t first, size_t count, const char *ext)
+{
+    if (MakeDirs(dir) != 0)
+        return -1;
+
+    char path[1152];
+    for (size_t i = first; i < first + count; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s%zu%s", dir, prefix, i, ext);
+        TouchFile(path);
+    }
+
+    return 0;
+}
+
+// Every theme holds files_per_dir application icons, each one shifted by half of that down the chain
+static int WriteTheme(const char *icons_dir, size_t theme_index)
+{
+    char theme_dir[640];
+    char path[1024];
+    snprintf(theme_dir, sizeof(theme_dir), "%s/Fixture-%zu", icons_dir, theme_index);
+
+    if (MakeDirs(theme_dir) != 0)
+        return -1;
+
+    snprintf(path, sizeof(path), "%s/index.theme", theme_dir);
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return -1;
+
+    char inherits[64];
+    if (theme_index + 1 < num_themes)
+        snprintf(inherits, sizeof(inherits), "Fixture-%zu,hicolor", theme_index + 1);
+    else
+        snprintf(inherits, sizeof(inherits), "hicolor");
+
+    fprintf(fp, "[Icon Theme]\nName=Fixture-%zu\nComment=Generated icon theme\nInherits=%s\n\nDirectories=",
+            theme_index, inherits);
+
+    for (size_t s = 0; s < ARRAY_SIZE(theme_sizes); s++)
+    {
+        for (int scale = 1; scale <= 2; scale++)
+        {
+            for (size_t c = 0; c < ARRAY_SIZE(theme_contexts); c++)
+            {
+                fprintf(fp, "%dx%d%s/%s,", theme_sizes[s], theme_sizes[s], scale == 2 ? "@2x" : "", theme_contexts[c].name);
+            }
+        }
+    }
+    fprintf(fp, "symbolic/actions,symbolic/apps\n\n");
+
+    size_t first_app = files_per_dir * theme_index / 2;
+
+    for (size_t s = 0; s < ARRAY_SIZE(theme_sizes); s++)
+    {
+        for (int scale = 1; scale <= 2; scale++)
+        {
+            for (size_t c = 0; c < ARRAY_SIZE(theme_contexts); c++)
+            {
+                int size = theme_sizes[s];
+                char sub_dir[64];
+                snprintf(sub_dir, sizeof(sub_dir), "%dx%d%s/%s", size, size, scale == 2 ? "@2x" : "", theme_contexts[c].name);
+
+                fprintf(fp, "[%s]\nContext=%s\nSize=%d\nScale=%d\nType=Fixed\n\n", sub_dir, theme_contexts[c].context, size, scale);
+
+                snprintf(path, sizeof(path), "%s/%s", theme_dir, sub_dir);
+
+                bool apps = c == 0;
+                size_t count = files_per_dir / theme_contexts[c].divisor;
+                if (WriteIconFiles(path, apps ? "app-" : theme_contexts[c].name, apps ? first_app : 0, count, ".svg") != 0)
+                {
+                    fclose(fp);
+                    return -1;
+                }
+
+                if (strcmp(theme_contexts[c].name, "categories") == 0 && theme_index == 0)
+                {
+                    for (size_t i = 0; i < ARRAY_SIZE(extra_icons); i++)
+                    {
+                        char icon_path[1152];
+                        snprintf(icon_path, sizeof(icon_path), "%s/%s.svg", path, extra_icons[i]);
+                        TouchFile(icon_path);
+                    }
+                }
+            }
+        }
+    }
+
+    fprintf(fp, "[symbolic/actions]\nContext=Actions\nSize=16\nMinSize=16\nMaxSize=512\nType=Scalable\n\n"
+                "[symbolic/apps]\nContext=Applications\nSize=16\nMinSize=16\nMaxSize=512\nType=Scalable\n\n");
+    fclose(fp);
+
+    snprintf(path, sizeof(path), "%s/symbolic/actions", theme_dir);
+    if (WriteIconFiles(path, "action-symbolic-", 0, files_per_dir / 4, ".svg") != 0)
+        return -1;
+
+    snprintf(path, sizeof(path), "%s/symbolic/apps", theme_dir);
+    return WriteIconFiles(path, "app-symbolic-", 0, files_per_dir / 4, ".svg");
+}
+
+static int WriteHicolor(const char *icons_dir)
+{
+    char theme_dir[640];
+    char path[1024];
+    snprintf(theme_dir, sizeof(theme_dir), "%s/hicolor", icons_dir);
+
+    if (MakeDirs(theme_dir) != 0)
+        return -1;
+
+    snprintf(path, sizeof(path), "%s/index.theme", theme_dir);
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return -1;
+
+    fprintf(fp, "[Icon Theme]\nName=Hicolor\nComment=Fallback icon theme\nHidden=true\n\nDirectories=");
+    for (size_t s = 0; s < ARRAY_SIZE(hicolor_sizes); s++)
+        fprintf(fp, "%dx%d/apps,", hicolor_sizes[s], hicolor_sizes[s]);
+    fprintf(fp, "scalable/apps\n\n");
+
+    for (size_t s = 0; s < ARRAY_SIZE(hicolor_sizes); s++)
+    {
+        int size = hicolor_sizes[s];
+        fprintf(fp, "[%dx%d/apps]\nContext=Applications\nSize=%d\nType=Threshold\n\n", size, size, size);
+
+        snprintf(path, sizeof(path), "%s/%dx%d/apps", theme_dir, size, size);
+        if (WriteIconFiles(path, "hicolor-app-", 0, files_per_dir / 4, ".png") != 0)
+        {
+            fclose(fp);
+            return -1;
+        }
+    }
+
+    // The parser drops the last section unless it is followed by a blank line
+    fprintf(fp, "[scalable/apps]\nContext=Applications\nSize=48\nMinSize=1\nMaxSize=512\nType=Scalable\n\n");
+    fclose(fp);
+
+    snprintf(path, sizeof(path), "%s/scalable/apps", theme_dir);
+    return WriteIconFiles(path, "hicolor-app-", 0, files_per_dir, ".svg");
+}
+
+static int WriteHome(const char *root)
+{
+    char path[1024];
+
+    snprintf(path, sizeof(path), "%s/home/.local/share/applications", root);
+    if (MakeDirs(path) != 0)
+        return -1;
+
+    snprintf(path, sizeof(path), "%s/home/.config/jwms", root);
+    if (MakeDirs(path) != 0)
+        return -1;
+
+    snprintf(path, sizeof(path), "%s/home/.gtkrc-2.0", root);
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return -1;
+    fprintf(fp, "gtk-icon-theme-name=\"Fixture-0\"\n");
+    fclose(fp);
+
+    snprintf(path, sizeof(path), "%s/home/.config/jwms/jwms.conf", root);
+    fp = fopen(path, "w");
+    if (fp == NULL)
+        return -1;
+    fprintf(fp, "global_terminal = \"fixture-app-0\"\n"
+                "global_preferred_icon_size = 32\n\n"
+                "tray primary {\n"
+                "    position = \"bottom\"\n"
+                "    programs = {\"fixture-app-1\", \"fixture-app-0\", \"fixture-app-2\"}\n"
+                "    tasklist_enabled = true\n"
+                "    clock_enabled = true\n"
+                "}\n");
+    fclose(fp);
+
+    return 0;
+}
+
+static void Usage(void)
+{
+    printf("Usage: fixtures -o DIR [-n entries] [-t themes] [-f files]\n\n"
+           "  -o DIR     Where to create the tree\n"
+           "  -n N       Number of desktop entries (default 1000)\n"
+           "  -t M       Number of themes in the inheritance chain, hicolor not included (default 3)\n"
+           "  -f FILES   Application icons per theme directory (default 2000)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *root = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "ho:n:t:f:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'o':
+                root = optarg;
+                break;
+            case 'n':
+                num_entries = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                num_themes = strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                files_per_dir = strtoul(optarg, NULL, 10);
+                break;
+            case 'h':
+            default:
+                Usage();
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (root == NULL || num_themes < 1 || files_per_dir < 16)
+    {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    char path[512];
+
+    snprintf(path, sizeof(path), "%s/applications", root);
+    if (MakeDirs(path) != 0)
+        return EXIT_FAILURE;
+
+    for (size_t i = 0; i < num_entries; i++)
+    {
+        if (WriteDesktopEntry(path, i) != 0)
+            return EXIT_FAILURE;
+    }
+
+    snprintf(path, sizeof(path), "%s/icons", root);
+    for (size_t i = 0; i < num_themes; i++)
+    {
+        if (WriteTheme(path, i) != 0)
+            return EXIT_FAILURE;
+    }
+
+    if (WriteHicolor(path) != 0 || WriteHome(root) != 0)
+        return EXIT_FAILURE;
+
+    printf("Created %zu desktop entries and %zu icon themes in %s\n", num_entries, num_themes + 1, root);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#!/bin/sh
+
+# Starts jwms on a private Xvfb display with a generated HOME and measures how long the login takes:
+# when the generators finished, when JWM owned WM_S0 and set _NET_SUPPORTING_WM_CHECK and when the tray got mapped.
+# Every run gets a fresh X server, the results are summed up as min, median and p95 over all runs.
+#
+# Usage: bench/login.sh [runs]    (default: 10)
+#
+# Needs Xvfb and jwm in PATH. ENTRIES, THEMES and FILES set the size of the generated tree.
+# The fingerprint is removed before every run, KEEP_FINGERPRINT=1 measures logins where nothing changed.
+
+JWMS="${JWMS:-./jwms}"
+FIXTURES="${FIXTURES:-build/bench/fixtures}"
+LOGIN_PROBE="${LOGIN_PROBE:-build/bench/login_probe}"
+ENTRIES="${ENTRIES:-1000}"
+THEMES="${THEMES:-3}"
+FILES="${FILES:-2000}"
+TIMEOUT_MS="${TIMEOUT_MS:-30000}"
+RUNS="${1:-10}"
+
+for bin in "$JWMS" "$FIXTURES" "$LOGIN_PROBE"; do
+    if [ ! -x "$bin" ]; then
+        echo "Please build $bin first (make && make fixtures && make $LOGIN_PROBE)."
+        exit 1
+    fi
+done
+
+for bin in Xvfb jwm; do
+    if ! command -v "$bin" > /dev/null; then
+        echo "$bin is needed to run the login harness"
+        exit 1
+    fi
+done
+
+AbsolutePath() {
+    echo "$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+}
+
+jwms="$(AbsolutePath "$JWMS")"
+probe="$(AbsolutePath "$LOGIN_PROBE")"
+
+dir="$(mktemp -d /tmp/jwm-login-XXXXXX)"
+xvfb_pid=""
+
+Cleanup() {
+    if [ -n "$xvfb_pid" ]; then
+        kill "$xvfb_pid" 2> /dev/null
+        wait "$xvfb_pid" 2> /dev/null
+    fi
+    rm -rf "$dir"
+}
+trap Cleanup EXIT
+trap 'exit 1' INT TERM
+
+if ! "$FIXTURES" -o "$dir" -n "$ENTRIES" -t "$THEMES" -f "$FILES" > /dev/null; then
+    echo "Failed to generate the fixtures"
+    exit 1
+fi
+
+# Pick a display nobody uses
+display=90
+while [ -e "/tmp/.X11-unix/X$display" ] || [ -e "/tmp/.X$display-lock" ]; do
+    display=$((display + 1))
+done
+
+echo "entries=$ENTRIES themes=$THEMES files=$FILES runs=$RUNS display=:$display"
+
+run=1
+while [ "$run" -le "$RUNS" ]; do
+    if [ "$KEEP_FINGERPRINT" != "1" ]; then
+        rm -f "$dir/home/.config/jwm/.fingerprint"
+    fi
+
+    Xvfb ":$display" -nolisten tcp -screen 0 1920x1080x24 > "$dir/xvfb.log" 2>&1 &
+    xvfb_pid=$!
+
+    tries=0
+    while [ ! -e "/tmp/.X11-unix/X$display" ] && [ "$tries" -lt 100 ]; do
+        sleep 0.05
+        tries=$((tries + 1))
+    done
+
+    DISPLAY=":$display" HOME="$dir/home" JWMS_APP_DIR="$dir/applications" JWMS_ICON_DIR="$dir/icons" \
+        "$probe" -r "$run" -t "$TIMEOUT_MS" -m "$dir/helper.mark" -- "$jwms" --helper-mark="$dir/helper.mark" \
+        | tee -a "$dir/results.txt"
+
+    kill "$xvfb_pid" 2> /dev/null
+    wait "$xvfb_pid" 2> /dev/null
+    xvfb_pid=""
+
+    run=$((run + 1))
+done
+
+# Runs that never got that far report -1 and are left out
+awk '
+    /^login / {
+        for (i = 2; i <= NF; i++) {
+            split($i, pair, "=")
+            if (pair[1] !~ /_ms$/ || pair[2] < 0)
+                continue
+            stage = pair[1]
+            sub(/_ms$/, "", stage)
+            if (!(stage in count))
+                order[++stages] = stage
+            values[stage, ++count[stage]] = pair[2]
+        }
+    }
+    END {
+        for (s = 1; s <= stages; s++) {
+            stage = order[s]
+            n = count[stage]
+            # Insertion sort, n is the number of runs
+            for (i = 2; i <= n; i++) {
+                v = values[stage, i]
+                for (j = i - 1; j >= 1 && values[stage, j] > v; j--)
+                    values[stage, j + 1] = values[stage, j]
+                values[stage, j + 1] = v
+            }
+            median = values[stage, int(n * 0.5) + 1 > n ? n : int(n * 0.5) + 1]
+            p95 = values[stage, int(n * 0.95) + 1 > n ? n : int(n * 0.95) + 1]
+            printf "summary stage=%s runs=%d min_ms=%.1f median_ms=%.1f p95_ms=%.1f\n", stage, n, values[stage, 1], median, p95
+        }
+    }' "$dir/results.txt"
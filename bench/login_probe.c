@@ -0,0 +1,318 @@
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+// Starts jwms on an X server that is already running and watches the root window to see how far the login got.
+// Every time is in milliseconds since jwms was started:
+//
+// helper_ms    the generators were done, written by jwms --helper-mark
+// wm_ms        a window manager owns WM_S0
+// wm_check_ms  _NET_SUPPORTING_WM_CHECK was set on the root window
+// tray_ms      the first dock window (the JWM tray) was mapped
+//
+// Usage: login_probe [-r run] [-t timeout_ms] [-m mark_file] -- jwms [args...]
+
+#define DEFAULT_TIMEOUT_MS 30000
+#define DISPLAY_RETRIES 100
+
+static long long NowUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static double SinceMs(long long start, long long time)
+{
+    return time < 0 ? -1.0 : (time - start) / 1000.0;
+}
+
+static long long ReadMark(const char *mark_path)
+{
+    long long time = -1;
+
+    if (mark_path == NULL)
+        return -1;
+
+    FILE *fp = fopen(mark_path, "r");
+    if (fp == NULL)
+        return -1;
+
+    if (fscanf(fp, "%lld", &time) != 1)
+        time = -1;
+
+    fclose(fp);
+    return time;
+}
+
+// Xvfb takes a moment to accept connections after its socket shows up
+static Display *OpenDisplay(void)
+{
+    for (int i = 0; i < DISPLAY_RETRIES; i++)
+    {
+        Display *display = XOpenDisplay(NULL);
+        if (display != NULL)
+            return display;
+
+        usleep(50000);
+    }
+
+    return NULL;
+}
+
+static bool IsDock(Display *display, Window window, Atom window_type, Atom dock)
+{
+    Atom type;
+    int format;
+    unsigned long count;
+    unsigned long remaining;
+    unsigned char *data = NULL;
+    bool found = false;
+
+    if (XGetWindowProperty(display, window, window_type, 0, 16, False, XA_ATOM, &type, &format,
+                           &count, &remaining, &data) != Success)
+    {
+        return false;
+    }
+
+    if (data != NULL && type == XA_ATOM && format == 32)
+    {
+        Atom *atoms = (Atom*)data;
+        for (unsigned long i = 0; i < count; i++)
+        {
+            if (atoms[i] == dock)
+                found = true;
+        }
+    }
+
+    if (data != NULL)
+        XFree(data);
+
+    return found;
+}
+
+// The window may be gone again by the time its properties are read
+static int IgnoreXError(Display *display, XErrorEvent *event)
+{
+    (void)display;
+    (void)event;
+    return 0;
+}
+
+static pid_t StartSession(char *argv[])
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "Failed to fork %s: %s\n", argv[0], strerror(errno));
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        // jwms does not stop jwm on exit, so the whole group gets killed once the run is over
+        setpgid(0, 0);
+        execvp(argv[0], argv);
+        fprintf(stderr, "Failed to run %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+
+    setpgid(pid, pid);
+    return pid;
+}
+
+static void StopSession(pid_t pid)
+{
+    kill(-pid, SIGTERM);
+
+    // Give it a second before killing whatever is left
+    for (int i = 0; i < 100; i++)
+    {
+        if (waitpid(pid, NULL, WNOHANG) != 0)
+            break;
+
+        usleep(10000);
+    }
+
+    kill(-pid, SIGKILL);
+    waitpid(pid, NULL, WNOHANG);
+}
+
+static int Probe(int run, long long timeout_ms, const char *mark_path, char *argv[])
+{
+    Display *display = OpenDisplay();
+    if (display == NULL)
+    {
+        fprintf(stderr, "Failed to open the display %s\n", getenv("DISPLAY") ? getenv("DISPLAY") : "(unset)");
+        return EXIT_FAILURE;
+    }
+
+    XSetErrorHandler(IgnoreXError);
+
+    Window root = DefaultRootWindow(display);
+    Atom wm_selection = XInternAtom(display, "WM_S0", False);
+    Atom manager = XInternAtom(display, "MANAGER", False);
+    Atom wm_check = XInternAtom(display, "_NET_SUPPORTING_WM_CHECK", False);
+    Atom window_type = XInternAtom(display, "_NET_WM_WINDOW_TYPE", False);
+    Atom dock = XInternAtom(display, "_NET_WM_WINDOW_TYPE_DOCK", False);
+
+    XSelectInput(display, root, SubstructureNotifyMask | StructureNotifyMask | PropertyChangeMask);
+    XSync(display, False);
+
+    if (mark_path != NULL)
+        unlink(mark_path);
+
+    long long start = NowUs();
+    long long deadline = start + timeout_ms * 1000;
+    long long wm_time = -1;
+    long long wm_check_time = -1;
+    long long tray_time = -1;
+    const char *status = "timeout";
+
+    pid_t pid = StartSession(argv);
+    if (pid < 0)
+    {
+        XCloseDisplay(display);
+        return EXIT_FAILURE;
+    }
+
+    int fd = ConnectionNumber(display);
+
+    while (tray_time < 0)
+    {
+        while (XPending(display))
+        {
+            XEvent event;
+            XNextEvent(display, &event);
+            long long now = NowUs();
+
+            switch (event.type)
+            {
+                case PropertyNotify:
+                    if (event.xproperty.window == root && event.xproperty.atom == wm_check &&
+                        event.xproperty.state == PropertyNewValue && wm_check_time < 0)
+                    {
+                        wm_check_time = now;
+                    }
+                    break;
+
+                // ICCCM managers announce themselves, not every one of them does though
+                case ClientMessage:
+                    if (event.xclient.message_type == manager && (Atom)event.xclient.data.l[1] == wm_selection &&
+                        wm_time < 0)
+                    {
+                        wm_time = now;
+                    }
+                    break;
+
+                case MapNotify:
+                    if (tray_time < 0 && IsDock(display, event.xmap.window, window_type, dock))
+                        tray_time = now;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        if (wm_time < 0 && XGetSelectionOwner(display, wm_selection) != None)
+            wm_time = NowUs();
+
+        if (tray_time >= 0)
+        {
+            status = "ok";
+            break;
+        }
+
+        if (waitpid(pid, NULL, WNOHANG) == pid)
+        {
+            status = "exited";
+            pid = -1;
+            break;
+        }
+
+        if (NowUs() >= deadline)
+            break;
+
+        // The selection owner has no event without XFixes, so it gets polled every millisecond
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+        struct timeval timeout = { .tv_sec = 0, .tv_usec = 1000 };
+        select(fd + 1, &fds, NULL, NULL, &timeout);
+    }
+
+    long long helper_time = ReadMark(mark_path);
+
+    if (pid > 0)
+        StopSession(pid);
+
+    XCloseDisplay(display);
+
+    printf("login run=%d status=%s helper_ms=%.1f wm_ms=%.1f wm_check_ms=%.1f tray_ms=%.1f\n", run, status,
+           SinceMs(start, helper_time), SinceMs(start, wm_time), SinceMs(start, wm_check_time),
+           SinceMs(start, tray_time));
+
+    return tray_time >= 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void Usage(void)
+{
+    printf("Usage: login_probe [-r run] [-t timeout_ms] [-m mark_file] -- jwms [args...]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] =
+    {
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    const char *mark_path = NULL;
+    long long timeout_ms = DEFAULT_TIMEOUT_MS;
+    int run = 1;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hr:t:m:", long_opts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'r':
+                run = atoi(optarg);
+                break;
+            case 't':
+                timeout_ms = atoll(optarg);
+                break;
+            case 'm':
+                mark_path = optarg;
+                break;
+            case 'h':
+            default:
+                Usage();
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    return Probe(run, timeout_ms, mark_path, &argv[optind]);
+}
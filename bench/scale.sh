@@ -0,0 +1,68 @@
+#!/bin/sh
+
+# Runs jwm-helper --all on generated trees of increasing size and prints how long each stage took.
+# Stage times come from the trace, so build with "make debug" or "make TRACE=1" to get more than the total.
+#
+# Usage: bench/scale.sh [entries...]    (default: 100 1000 10000 50000)
+
+JWM_HELPER="${JWM_HELPER:-./jwm-helper}"
+FIXTURES="${FIXTURES:-build/bench/fixtures}"
+THEMES="${THEMES:-3}"
+FILES="${FILES:-2000}"
+
+SIZES="$*"
+if [ -z "$SIZES" ]; then
+    SIZES="100 1000 10000 50000"
+fi
+
+if [ ! -x "$JWM_HELPER" ] || [ ! -x "$FIXTURES" ]; then
+    echo "Please build $JWM_HELPER and $FIXTURES first (make && make fixtures)."
+    exit 1
+fi
+
+for entries in $SIZES; do
+    dir="$(mktemp -d /tmp/jwm-scale-XXXXXX)"
+
+    if ! "$FIXTURES" -o "$dir" -n "$entries" -t "$THEMES" -f "$FILES" > /dev/null; then
+        echo "Failed to generate the fixtures for $entries entries"
+        rm -rf "$dir"
+        exit 1
+    fi
+
+    start=$(date +%s%N)
+    HOME="$dir/home" JWMS_APP_DIR="$dir/applications" JWMS_ICON_DIR="$dir/icons" \
+        "$JWM_HELPER" --force --all --trace="$dir/trace.json" > "$dir/output.txt" 2>&1
+    status=$?
+    end=$(date +%s%N)
+
+    echo "entries=$entries themes=$THEMES files=$FILES status=$status total_ms=$(( (end - start) / 1000000 ))"
+
+    # Sum up the trace events of each stage
+    if [ -f "$dir/trace.json" ]; then
+        awk -v entries="$entries" '
+            /"name":/ {
+                name = $0
+                sub(/.*"name":"/, "", name)
+                sub(/".*/, "", name)
+                split(name, words, " ")
+                # Per item events are grouped, the rest are stages of their own
+                stage = name
+                if (words[1] == "scan" || words[1] == "index" || words[1] == "resolve")
+                    stage = words[1]
+                else if (words[1] == "theme")
+                    stage = "theme load"
+                gsub(/ /, "_", stage)
+                dur = $0
+                sub(/.*"dur":/, "", dur)
+                sub(/,.*/, "", dur)
+                total[stage] += dur
+                count[stage]++
+            }
+            END {
+                for (stage in total)
+                    printf "entries=%s stage=%s count=%d total_ms=%.2f\n", entries, stage, count[stage], total[stage] / 1000
+            }' "$dir/trace.json" | sort
+    fi
+
+    rm -rf "$dir"
+done
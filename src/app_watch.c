@@ -0,0 +1,223 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syslog.h>
+#include <sys/inotify.h>
+
+#include "common.h"
+#include "darray.h"
+#include "event_loop.h"
+#include "helper_status.h"
+#include "helper.h"
+#include "app_watch.h"
+
+#define APP_WATCH_QUIET_MS 500
+#define APP_WATCH_MAX_DELAY_MS 5000
+
+// Package managers write a temporary file and rename it, editors write in place
+#define APP_DIR_EVENTS (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR)
+#define PARENT_DIR_EVENTS (IN_CREATE | IN_MOVED_TO | IN_ONLYDIR)
+
+static void AddAppDir(const char *path, void *data)
+{
+    AppWatch *watch = data;
+
+    if (watch->num_dirs >= (int)ARRAY_SIZE(watch->dirs))
+        return;
+
+    WatchedAppDir *dir = &watch->dirs[watch->num_dirs++];
+    dir->path = strdup(path);
+    dir->wd = -1;
+}
+
+// True if one of the directories that were missing is watched now
+static bool WatchMissingDirs(AppWatch *watch)
+{
+    bool appeared = false;
+
+    for (int i = 0; i < watch->num_dirs; i++)
+    {
+        WatchedAppDir *dir = &watch->dirs[i];
+        if (dir->path == NULL || dir->wd >= 0)
+            continue;
+
+        dir->wd = inotify_add_watch(watch->inotify, dir->path, APP_DIR_EVENTS);
+        if (dir->wd >= 0)
+            appeared = true;
+        else
+            WatchClosestDir(watch->inotify, dir->path, PARENT_DIR_EVENTS);
+    }
+
+    return appeared;
+}
+
+static WatchedAppDir *FindDir(AppWatch *watch, int wd)
+{
+    for (int i = 0; i < watch->num_dirs; i++)
+    {
+        if (watch->dirs[i].wd == wd)
+            return &watch->dirs[i];
+    }
+
+    return NULL;
+}
+
+static void AddChanged(AppWatch *watch, const char *dir_path, const char *name)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s%s", dir_path, name);
+
+    for (size_t i = 0; i < watch->changed->size; i++)
+    {
+        if (strcmp(watch->changed->data[i], path) == 0)
+            return;
+    }
+
+    DArrayAdd(watch->changed, strdup(path));
+}
+
+// True if the event is worth an update
+static bool HandleEvent(AppWatch *watch, const struct inotify_event *event)
+{
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+        watch->rescan = true;
+        return true;
+    }
+
+    WatchedAppDir *dir = FindDir(watch, event->wd);
+
+    // One of the parents watched for a missing directory
+    if (dir == NULL)
+    {
+        if (WatchMissingDirs(watch))
+            watch->rescan = true;
+
+        return watch->rescan;
+    }
+
+    // The directory itself went away, its entries with it
+    if (event->mask & IN_IGNORED)
+    {
+        dir->wd = -1;
+        WatchMissingDirs(watch);
+        watch->rescan = true;
+        return true;
+    }
+
+    const char *ext = event->len > 0 ? strrchr(event->name, '.') : NULL;
+    if (ext == NULL || strcmp(ext, ".desktop") != 0 || (event->mask & IN_ISDIR))
+        return false;
+
+    AddChanged(watch, dir->path, event->name);
+    return true;
+}
+
+static void OnInotify(uint32_t events, void *data)
+{
+    AppWatch *watch = data;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    bool changed = false;
+
+    (void)events;
+
+    while ((len = read(watch->inotify, buffer, sizeof(buffer))) > 0)
+    {
+        char *ptr = buffer;
+        while (ptr < buffer + len)
+        {
+            const struct inotify_event *event = (const struct inotify_event*)ptr;
+            changed |= HandleEvent(watch, event);
+            ptr += sizeof(*event) + event->len;
+        }
+    }
+
+    if (!changed)
+        return;
+
+    // Every change pushes the update back until things are quiet, but not forever
+    long long now = NowMs();
+    if (watch->first_change < 0)
+        watch->first_change = now;
+
+    TimerSetDeadline(watch->timer, MIN(now + APP_WATCH_QUIET_MS, watch->first_change + APP_WATCH_MAX_DELAY_MS));
+}
+
+static void OnTimer(uint32_t events, void *data)
+{
+    AppWatch *watch = data;
+    DArray *paths = watch->changed;
+
+    (void)events;
+    TimerClear(watch->timer);
+
+    if (watch->rescan)
+    {
+        DArrayDestroy(paths);
+        paths = NULL;
+    }
+
+    watch->changed = DArrayCreate(16, free, NULL, NULL);
+    watch->rescan = false;
+    watch->first_change = -1;
+
+    if (paths != NULL)
+        syslog(LOG_INFO, "JWMS: %zu desktop files changed", paths->size);
+    else
+        syslog(LOG_INFO, "JWMS: The application directories changed, reading them again");
+
+    watch->callback(paths, watch->data);
+}
+
+int AppWatchStart(AppWatch *watch, EventLoop *loop, AppWatchCallback callback, void *data)
+{
+    watch->loop = loop;
+    watch->callback = callback;
+    watch->data = data;
+    watch->num_dirs = 0;
+    watch->rescan = false;
+    watch->first_change = -1;
+    watch->inotify_source = NULL;
+    watch->timer_source = NULL;
+    watch->changed = DArrayCreate(16, free, NULL, NULL);
+    watch->timer = TimerCreate();
+    watch->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (watch->inotify < 0 || watch->timer < 0)
+    {
+        syslog(LOG_ERR, "JWMS: Failed to watch the application directories: %s", strerror(errno));
+        return -1;
+    }
+
+    HelperForEachAppDir(AddAppDir, watch);
+    WatchMissingDirs(watch);
+
+    watch->inotify_source = EventLoopAdd(loop, watch->inotify, OnInotify, watch);
+    watch->timer_source = EventLoopAdd(loop, watch->timer, OnTimer, watch);
+    return watch->inotify_source != NULL && watch->timer_source != NULL ? 0 : -1;
+}
+
+void AppWatchDestroy(AppWatch *watch)
+{
+    if (watch->inotify_source != NULL)
+        EventLoopRemove(watch->loop, watch->inotify_source);
+    if (watch->timer_source != NULL)
+        EventLoopRemove(watch->loop, watch->timer_source);
+
+    if (watch->inotify >= 0)
+        close(watch->inotify);
+    if (watch->timer >= 0)
+        close(watch->timer);
+
+    for (int i = 0; i < watch->num_dirs; i++)
+        free(watch->dirs[i].path);
+
+    DArrayDestroy(watch->changed);
+}
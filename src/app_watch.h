@@ -0,0 +1,46 @@
+#ifndef APP_WATCH_H
+#define APP_WATCH_H
+
+// Watches the directories the desktop entries are read from, for jwms. The desktop files that get added,
+// changed or removed are collected until none changed for APP_WATCH_QUIET_MS, or APP_WATCH_MAX_DELAY_MS
+// after the first one while they keep changing, and handed over as one batch. A package manager installing
+// a few programs ends up as one update of the menu.
+//
+// Needs darray.h and event_loop.h
+
+// The paths are NULL when events got lost or a directory that was missing showed up, every desktop file
+// has to be read again. Otherwise the callback owns them.
+typedef void (*AppWatchCallback)(DArray *paths, void *data);
+
+typedef struct
+{
+    char *path;
+    // -1 while the directory doesn't exist, the closest parent that does is watched for it instead
+    int wd;
+} WatchedAppDir;
+
+typedef struct
+{
+    EventLoop *loop;
+    int inotify;
+    EventSource *inotify_source;
+    int timer;
+    EventSource *timer_source;
+
+    WatchedAppDir dirs[2];
+    int num_dirs;
+
+    // Full paths of the desktop files changed since the last batch
+    DArray *changed;
+    bool rescan;
+    // CLOCK_MONOTONIC in milliseconds, -1 without changes
+    long long first_change;
+
+    AppWatchCallback callback;
+    void *data;
+} AppWatch;
+
+int AppWatchStart(AppWatch *watch, EventLoop *loop, AppWatchCallback callback, void *data);
+void AppWatchDestroy(AppWatch *watch);
+
+#endif
@@ -0,0 +1,112 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "common.h"
+#include "arena.h"
+#include "stats.h"
+
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+static ArenaChunk *ArenaChunkCreate(size_t size)
+{
+    ArenaChunk *chunk = malloc(sizeof(*chunk) + size);
+    if (chunk == NULL)
+        return NULL;
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    STATS_INC(arena_chunks);
+    return chunk;
+}
+
+// Nothing gets allocated until the first ArenaAlloc, so empty arenas are free
+void ArenaInit(Arena *arena, size_t chunk_size)
+{
+    arena->head = NULL;
+    arena->chunk_size = chunk_size;
+    arena->used = 0;
+}
+
+static void *ArenaAllocAligned(Arena *arena, size_t size, size_t align)
+{
+    ArenaChunk *chunk = arena->head;
+    size_t offset = chunk ? (chunk->used + align - 1) & ~(align - 1) : 0;
+
+    if (chunk == NULL || offset + size > chunk->size)
+    {
+        // Allocations bigger than a chunk get one of their own, behind the current chunk so its space isn't lost
+        if (size > arena->chunk_size / 4 && chunk != NULL)
+        {
+            ArenaChunk *big = ArenaChunkCreate(size);
+            if (big == NULL)
+                return NULL;
+
+            big->used = size;
+            big->next = chunk->next;
+            chunk->next = big;
+            arena->used += size;
+
+            STATS_INC(arena_allocs);
+            StatsAdd(&stats.arena_bytes, size);
+            return big->data;
+        }
+
+        chunk = ArenaChunkCreate(MAX(size, arena->chunk_size));
+        if (chunk == NULL)
+            return NULL;
+
+        chunk->next = arena->head;
+        arena->head = chunk;
+        offset = 0;
+    }
+
+    void *ptr = (char*)chunk->data + offset;
+    chunk->used = offset + size;
+    arena->used += size;
+
+    STATS_INC(arena_allocs);
+    StatsAdd(&stats.arena_bytes, size);
+    return ptr;
+}
+
+void *ArenaAlloc(Arena *arena, size_t size)
+{
+    return ArenaAllocAligned(arena, size, ARENA_ALIGN);
+}
+
+// Strings don't need any alignment, so they are packed back to back
+char *ArenaStrndup(Arena *arena, const char *str, size_t len)
+{
+    char *copy = ArenaAllocAligned(arena, len + 1, 1);
+    if (copy == NULL)
+        return NULL;
+
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *ArenaStrdup(Arena *arena, const char *str)
+{
+    return ArenaStrndup(arena, str, strlen(str));
+}
+
+void ArenaDestroy(Arena *arena)
+{
+    ArenaChunk *chunk = arena->head;
+
+    while (chunk != NULL)
+    {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->head = NULL;
+    arena->used = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+// Bump allocator, everything allocated from it is freed at once by ArenaDestroy
+typedef struct ArenaChunk
+{
+    struct ArenaChunk *next;
+    size_t size;
+    size_t used;
+    // Keeps data aligned for any type
+    max_align_t data[];
+} ArenaChunk;
+
+typedef struct
+{
+    ArenaChunk *head;
+    size_t chunk_size;
+    // Bytes handed out so far
+    size_t used;
+} Arena;
+
+void ArenaInit(Arena *arena, size_t chunk_size);
+void *ArenaAlloc(Arena *arena, size_t size);
+char *ArenaStrdup(Arena *arena, const char *str);
+char *ArenaStrndup(Arena *arena, const char *str, size_t len);
+void ArenaDestroy(Arena *arena);
+
+#endif
@@ -0,0 +1,856 @@
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <wordexp.h>
+#include <poll.h>
+#include <sys/syslog.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include <bsd/string.h>
+#include <confuse.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/Xfixes.h>
+
+#include "common.h"
+#include "containers.h"
+#include "list.h"
+#include "arena.h"
+#include "hashing.h"
+#include "darray.h"
+#include "desktop_entries.h"
+#include "icons.h"
+#include "config.h"
+#include "event_loop.h"
+#include "supervisor.h"
+#include "autostart.h"
+#include "trace.h"
+
+// How long processes hit by restart_kill get to exit before the new one starts
+#define KILL_WAIT_MS 500
+#define KILL_MAX_PROCESSES 32
+
+static char *CopyString(const char *str)
+{
+    return str != NULL ? strdup(str) : NULL;
+}
+
+// Socket paths get the same ~ and $VARIABLE expansion as the command line
+static char *ExpandSocketPath(const char *path)
+{
+    wordexp_t words;
+    char *expanded = NULL;
+
+    if (path == NULL)
+        return NULL;
+
+    if (wordexp(path, &words, WRDE_NOCMD) == 0)
+    {
+        if (words.we_wordc == 1)
+            expanded = strdup(words.we_wordv[0]);
+        wordfree(&words);
+    }
+
+    return expanded != NULL ? expanded : strdup(path);
+}
+
+static int FindProgram(const Autostart *autostart, const char *name)
+{
+    for (int i = 0; i < autostart->num_programs; i++)
+    {
+        if (autostart->programs[i].name != NULL && strcmp(autostart->programs[i].name, name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static bool HasConditions(const AutostartProgram *p, cfg_t *section)
+{
+    return cfg_size(section, "after") > 0 || p->wait_window != NULL || p->wait_selection != NULL ||
+           p->wait_socket != NULL;
+}
+
+static void ReadAfter(Autostart *autostart, int index, cfg_t *section, int barrier)
+{
+    AutostartProgram *p = &autostart->programs[index];
+    int n = cfg_size(section, "after");
+
+    // Nothing declared, it waits for the program before it that the script would have waited for
+    if (!HasConditions(p, section))
+    {
+        if (barrier >= 0)
+        {
+            p->after = malloc(sizeof(int));
+            if (p->after != NULL)
+                p->after[p->num_after++] = barrier;
+        }
+        return;
+    }
+
+    if (n == 0)
+        return;
+
+    p->after = malloc(sizeof(int) * n);
+    if (p->after == NULL)
+        return;
+
+    for (int i = 0; i < n; i++)
+    {
+        const char *name = cfg_getnstr(section, "after", i);
+        int dep = FindProgram(autostart, name);
+
+        if (dep < 0 || dep == index)
+        {
+            syslog(LOG_ERR, "JWMS: autostart %s waits for %s, which is not an autostart program", p->name, name);
+            continue;
+        }
+
+        p->after[p->num_after++] = dep;
+    }
+}
+
+// A program that ends up waiting for itself would never start, the edge that closes the loop gets dropped
+static void BreakCycles(Autostart *autostart, int index, char *visiting)
+{
+    AutostartProgram *p = &autostart->programs[index];
+
+    visiting[index] = 1;
+
+    for (int i = 0; i < p->num_after;)
+    {
+        int dep = p->after[i];
+
+        if (visiting[dep] == 1)
+        {
+            syslog(LOG_ERR, "JWMS: autostart %s and %s wait for each other, %s no longer waits for %s",
+                   p->name, autostart->programs[dep].name, p->name, autostart->programs[dep].name);
+            p->after[i] = p->after[--p->num_after];
+            continue;
+        }
+
+        if (visiting[dep] == 0)
+            BreakCycles(autostart, dep, visiting);
+
+        i++;
+    }
+
+    visiting[index] = 2;
+}
+
+static void SetCPUs(int first, int last, void *set)
+{
+    for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+        CPU_SET(cpu, (cpu_set_t*)set);
+}
+
+static void ReadSpawnOptions(AutostartProgram *p, cfg_t *section)
+{
+    SpawnOptions *options = &p->options;
+    AutostartScheduling scheduling;
+
+    if (ReadAutostartScheduling(section, &scheduling) > 0)
+        syslog(LOG_ERR, "JWMS: autostart %s has invalid scheduling options, they are left out", p->name);
+
+    options->nice = scheduling.nice;
+    options->ioprio_class = scheduling.io_class;
+    options->ioprio_level = scheduling.io_level;
+    options->sched_idle = scheduling.sched_idle;
+
+    if (scheduling.cpu_affinity != NULL)
+    {
+        CPU_ZERO(&options->affinity);
+        ParseCPUList(scheduling.cpu_affinity, SetCPUs, &options->affinity);
+        options->has_affinity = CPU_COUNT(&options->affinity) > 0;
+    }
+}
+
+int AutostartLoad(Autostart *autostart)
+{
+    JWM *jwm = NULL;
+    cfg_t *cfg = NULL;
+
+    autostart->programs = NULL;
+    autostart->num_programs = 0;
+    autostart->loop = NULL;
+    autostart->timer = -1;
+    autostart->timer_source = NULL;
+    autostart->watches.display = NULL;
+    autostart->watches.display_source = NULL;
+    autostart->watches.inotify = -1;
+    autostart->watches.inotify_source = NULL;
+
+    if (LoadJWMConfig(&jwm, &cfg) != 0)
+    {
+        if (cfg)
+            cfg_free(cfg);
+        return -1;
+    }
+
+    int n = jwm->global_native_autostart ? (int)cfg_size(cfg, "autostart") : 0;
+    cfg_t **sections = NULL;
+
+    if (n > 0)
+    {
+        autostart->programs = calloc(n, sizeof(AutostartProgram));
+        sections = malloc(sizeof(cfg_t*) * n);
+    }
+
+    for (int i = 0; i < n && autostart->programs != NULL && sections != NULL; i++)
+    {
+        cfg_t *section = cfg_getnsec(cfg, "autostart", i);
+        const char *program = cfg_getstr(section, "program");
+
+        if (program == NULL)
+        {
+            syslog(LOG_ERR, "JWMS: Program name was NULL for autostart %s", cfg_title(section));
+            continue;
+        }
+
+        sections[autostart->num_programs] = section;
+
+        AutostartProgram *p = &autostart->programs[autostart->num_programs++];
+        p->name = CopyString(cfg_title(section));
+        p->program = CopyString(program);
+        p->args = CopyString(cfg_getstr(section, "args"));
+        p->sleep_time = cfg_getint(section, "sleep_time");
+        p->fork = cfg_getbool(section, "fork_needed");
+        p->kill = cfg_getbool(section, "restart_kill");
+        p->restart_on_crash = cfg_getbool(section, "restart_on_crash");
+        p->wait_window = CopyString(cfg_getstr(section, "wait_window"));
+        p->wait_selection = CopyString(cfg_getstr(section, "wait_selection"));
+        p->wait_socket = ExpandSocketPath(cfg_getstr(section, "wait_socket"));
+        p->wait_timeout = cfg_getint(section, "wait_timeout");
+        ReadSpawnOptions(p, section);
+        p->state = AutostartWaiting;
+        p->autostart = autostart;
+        p->waiting_since = -1;
+        p->ready_at = -1;
+    }
+
+    // The names of the programs "after" refers to are only all known now
+    int barrier = -1;
+    for (int i = 0; i < autostart->num_programs; i++)
+    {
+        ReadAfter(autostart, i, sections[i], barrier);
+
+        if (!autostart->programs[i].fork)
+            barrier = i;
+    }
+
+    char *visiting = autostart->num_programs > 0 ? calloc(autostart->num_programs, 1) : NULL;
+    for (int i = 0; i < autostart->num_programs && visiting != NULL; i++)
+    {
+        if (visiting[i] == 0)
+            BreakCycles(autostart, i, visiting);
+    }
+
+    free(visiting);
+    free(sections);
+    free(jwm);
+    cfg_free(cfg);
+
+    return n > 0 && autostart->programs == NULL ? -1 : 0;
+}
+
+static void CloseWatches(Autostart *autostart);
+static void ReleaseStopping(Autostart *autostart, AutostartProgram *p);
+
+void AutostartDestroy(Autostart *autostart)
+{
+    CloseWatches(autostart);
+
+    if (autostart->timer >= 0)
+    {
+        EventLoopRemove(autostart->loop, autostart->timer_source);
+        close(autostart->timer);
+        autostart->timer = -1;
+    }
+
+    for (int i = 0; i < autostart->num_programs; i++)
+    {
+        AutostartProgram *p = &autostart->programs[i];
+
+        ReleaseStopping(autostart, p);
+        free(p->name);
+        free(p->program);
+        free(p->args);
+        free(p->after);
+        free(p->wait_window);
+        free(p->wait_selection);
+        free(p->wait_socket);
+    }
+
+    free(autostart->programs);
+    autostart->programs = NULL;
+    autostart->num_programs = 0;
+}
+
+// The kernel keeps the first 15 characters of the executable name, that is what pkill matched against
+static bool ProcessMatches(long pid, const char *name, uid_t uid)
+{
+    char path[64];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "/proc/%ld", pid);
+    if (stat(path, &st) != 0 || st.st_uid != uid)
+        return false;
+
+    snprintf(path, sizeof(path), "/proc/%ld/comm", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    char comm[32];
+    ssize_t len = read(fd, comm, sizeof(comm) - 1);
+    close(fd);
+
+    if (len <= 0)
+        return false;
+
+    comm[len] = '\0';
+    comm[strcspn(comm, "\n")] = '\0';
+
+    return strcmp(comm, name) == 0;
+}
+
+static void Step(Autostart *autostart);
+
+static void ReleaseStopping(Autostart *autostart, AutostartProgram *p)
+{
+    for (int i = 0; i < p->num_stopping; i++)
+    {
+        EventLoopRemove(autostart->loop, p->stopping[i].source);
+        close(p->stopping[i].pidfd);
+    }
+
+    free(p->stopping);
+    p->stopping = NULL;
+    p->num_stopping = 0;
+}
+
+// The source doesn't say which of the processes exited, the pidfd of one that did is readable
+static void OnStoppedExit(uint32_t events, void *data)
+{
+    AutostartProgram *p = data;
+
+    (void)events;
+
+    for (int i = 0; i < p->num_stopping;)
+    {
+        struct pollfd fd = { .fd = p->stopping[i].pidfd, .events = POLLIN };
+        if (poll(&fd, 1, 0) <= 0)
+        {
+            i++;
+            continue;
+        }
+
+        EventLoopRemove(p->autostart->loop, p->stopping[i].source);
+        close(p->stopping[i].pidfd);
+        p->stopping[i] = p->stopping[--p->num_stopping];
+    }
+
+    Step(p->autostart);
+}
+
+static void WatchStopping(Autostart *autostart, AutostartProgram *p, int pidfd)
+{
+    EventSource *source = p->stopping != NULL ? EventLoopAdd(autostart->loop, pidfd, OnStoppedExit, p) : NULL;
+    if (source == NULL)
+    {
+        close(pidfd);
+        return;
+    }
+
+    p->stopping[p->num_stopping].pidfd = pidfd;
+    p->stopping[p->num_stopping].source = source;
+    p->num_stopping++;
+}
+
+// What "pkill program" did in the script, without a pkill process. The signal goes through a pidfd that is only
+// opened after the name matched and checked again, so a pid that got reused in between is left alone.
+// The pidfds go into the event loop, the program starts from Step once they exited or KILL_WAIT_MS passed.
+static void KillRunning(Autostart *autostart, AutostartProgram *p, long long now)
+{
+    char name[16];
+    const char *base = strrchr(p->program, '/');
+
+    snprintf(name, sizeof(name), "%s", base != NULL ? base + 1 : p->program);
+
+    p->state = AutostartStopping;
+    p->stop_deadline = now + KILL_WAIT_MS;
+
+    DIR *proc = opendir("/proc");
+    if (proc == NULL)
+        return;
+
+    p->stopping = malloc(sizeof(StoppingProcess) * KILL_MAX_PROCESSES);
+    p->num_stopping = 0;
+
+    int found = 0;
+    uid_t uid = getuid();
+    pid_t self = getpid();
+    struct dirent *entry;
+
+    while ((entry = readdir(proc)) != NULL && found < KILL_MAX_PROCESSES)
+    {
+        char *end;
+        long pid = strtol(entry->d_name, &end, 10);
+
+        if (*end != '\0' || pid <= 0 || pid == self || !ProcessMatches(pid, name, uid))
+            continue;
+
+        int pidfd = PidfdOpen((pid_t)pid);
+        if (pidfd < 0)
+        {
+            if (errno == ENOSYS)
+                kill((pid_t)pid, SIGTERM);
+            continue;
+        }
+
+        if (ProcessMatches(pid, name, uid) && PidfdSendSignal(pidfd, SIGTERM) == 0)
+        {
+            syslog(LOG_INFO, "JWMS: Stopped %s (pid %ld) before starting it again", name, pid);
+            WatchStopping(autostart, p, pidfd);
+            found++;
+        }
+        else
+        {
+            close(pidfd);
+        }
+    }
+
+    closedir(proc);
+}
+
+static pid_t SpawnAutostart(void *data)
+{
+    AutostartProgram *p = data;
+
+    char command[4096];
+    if (p->args != NULL)
+        snprintf(command, sizeof(command), "%s %s", p->program, p->args);
+    else
+        strlcpy(command, p->program, sizeof(command));
+
+    pid_t pid;
+    wordexp_t words;
+
+    // The arguments get split and expanded like the shell did, pipes, redirections and the like still need one
+    bool expanded = wordexp(command, &words, WRDE_NOCMD) == 0;
+
+    if (expanded && words.we_wordc > 0)
+    {
+        pid = SpawnProgramWithOptions(words.we_wordv[0], words.we_wordv, &p->options);
+    }
+    else
+    {
+        char *sh_args[] = { "sh", "-c", command, NULL };
+        pid = SpawnProgramWithOptions("/bin/sh", sh_args, &p->options);
+    }
+
+    if (expanded)
+        wordfree(&words);
+
+    if (pid > 0)
+        syslog(LOG_INFO, "JWMS: Started %s (pid %d)", p->name, pid);
+
+    return pid;
+}
+
+static void AutostartExited(Process *process, int status, bool restarting, void *data)
+{
+    AutostartProgram *p = data;
+
+    (void)process;
+    (void)status;
+
+    if (!restarting)
+        p->state = AutostartDone;
+
+    // The ones after it were waiting for its first exit, a restart doesn't make it any less ready
+    if (!p->fork && p->ready_at < 0)
+        p->ready_at = NowMs();
+
+    Step(p->autostart);
+}
+
+static void Launch(Autostart *autostart, AutostartProgram *p)
+{
+    p->process = SupervisorStart(autostart->supervisor, p->name, SpawnAutostart, AutostartExited, p,
+                                 p->restart_on_crash);
+
+    if (p->process == NULL)
+    {
+        p->state = AutostartDone;
+        p->ready_at = NowMs();
+        return;
+    }
+
+    p->state = AutostartRunning;
+
+    if (p->fork)
+        p->ready_at = NowMs();
+}
+
+// Windows can be gone again by the time their WM_CLASS is read
+static int IgnoreXError(Display *display, XErrorEvent *event)
+{
+    (void)display;
+    (void)event;
+    return 0;
+}
+
+static void OnWatchEvent(uint32_t events, void *data);
+
+static void OpenWatches(Autostart *autostart)
+{
+    AutostartWatches *w = &autostart->watches;
+    bool need_x = false;
+    bool need_inotify = false;
+
+    w->clients_changed = true;
+
+    for (int i = 0; i < autostart->num_programs; i++)
+    {
+        AutostartProgram *p = &autostart->programs[i];
+        need_x |= p->wait_window != NULL || p->wait_selection != NULL;
+        need_inotify |= p->wait_socket != NULL;
+    }
+
+    if (need_x)
+    {
+        w->display = XOpenDisplay(NULL);
+        if (w->display == NULL)
+            syslog(LOG_ERR, "JWMS: Failed to open X display, not waiting for windows and selections");
+    }
+
+    if (w->display != NULL)
+    {
+        int event_base;
+        int error_base;
+
+        XSetErrorHandler(IgnoreXError);
+
+        w->root = DefaultRootWindow(w->display);
+        w->client_list = XInternAtom(w->display, "_NET_CLIENT_LIST", False);
+        bool has_fixes = XFixesQueryExtension(w->display, &event_base, &error_base);
+
+        // New clients change _NET_CLIENT_LIST, a new selection owner is an XFixes event.
+        // Without XFixes there is still the MANAGER message that owners of manager selections like the tray send.
+        XSelectInput(w->display, w->root, PropertyChangeMask | StructureNotifyMask);
+
+        for (int i = 0; i < autostart->num_programs; i++)
+        {
+            AutostartProgram *p = &autostart->programs[i];
+            if (p->wait_selection == NULL)
+                continue;
+
+            p->selection = XInternAtom(w->display, p->wait_selection, False);
+            if (has_fixes)
+                XFixesSelectSelectionInput(w->display, w->root, p->selection, XFixesSetSelectionOwnerNotifyMask);
+        }
+
+        XFlush(w->display);
+        w->display_source = EventLoopAdd(autostart->loop, ConnectionNumber(w->display), OnWatchEvent, autostart);
+    }
+
+    if (need_inotify)
+    {
+        w->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (w->inotify < 0)
+            syslog(LOG_ERR, "JWMS: Failed to watch for sockets: %s", strerror(errno));
+        else
+            w->inotify_source = EventLoopAdd(autostart->loop, w->inotify, OnWatchEvent, autostart);
+    }
+}
+
+static void CloseWatches(Autostart *autostart)
+{
+    AutostartWatches *w = &autostart->watches;
+
+    if (w->display != NULL)
+    {
+        EventLoopRemove(autostart->loop, w->display_source);
+        XCloseDisplay(w->display);
+        w->display = NULL;
+        w->display_source = NULL;
+    }
+
+    if (w->inotify >= 0)
+    {
+        EventLoopRemove(autostart->loop, w->inotify_source);
+        close(w->inotify);
+        w->inotify = -1;
+        w->inotify_source = NULL;
+    }
+}
+
+// Looks for the WM_CLASS of every program that still waits for a window among the clients JWM manages
+static void ScanClients(Autostart *autostart)
+{
+    AutostartWatches *w = &autostart->watches;
+    Atom type;
+    int format;
+    unsigned long count;
+    unsigned long remaining;
+    unsigned char *data = NULL;
+
+    w->clients_changed = false;
+
+    if (XGetWindowProperty(w->display, w->root, w->client_list, 0, 4096, False, XA_WINDOW, &type, &format,
+                           &count, &remaining, &data) != Success)
+    {
+        return;
+    }
+
+    if (data != NULL && type == XA_WINDOW && format == 32)
+    {
+        Window *windows = (Window*)data;
+
+        for (unsigned long i = 0; i < count; i++)
+        {
+            XClassHint hint;
+            if (!XGetClassHint(w->display, windows[i], &hint))
+                continue;
+
+            for (int j = 0; j < autostart->num_programs; j++)
+            {
+                AutostartProgram *p = &autostart->programs[j];
+                if (p->wait_window == NULL || p->window_seen)
+                    continue;
+
+                p->window_seen = (hint.res_name != NULL && strcmp(hint.res_name, p->wait_window) == 0) ||
+                                 (hint.res_class != NULL && strcmp(hint.res_class, p->wait_window) == 0);
+            }
+
+            if (hint.res_name != NULL)
+                XFree(hint.res_name);
+            if (hint.res_class != NULL)
+                XFree(hint.res_class);
+        }
+    }
+
+    if (data != NULL)
+        XFree(data);
+}
+
+// Selection owners are asked for directly, the events only say that it is worth asking again
+static void DrainWatches(AutostartWatches *w)
+{
+    if (w->display != NULL)
+    {
+        while (XPending(w->display))
+        {
+            XEvent event;
+            XNextEvent(w->display, &event);
+
+            if (event.type == PropertyNotify && event.xproperty.atom == w->client_list)
+                w->clients_changed = true;
+        }
+    }
+
+    if (w->inotify >= 0)
+    {
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        while (read(w->inotify, buffer, sizeof(buffer)) > 0);
+    }
+}
+
+static bool HasWaits(const AutostartProgram *p)
+{
+    return p->wait_window != NULL || p->wait_selection != NULL || p->wait_socket != NULL;
+}
+
+static bool WaitsMet(AutostartProgram *p, AutostartWatches *w, long long now)
+{
+    bool met = true;
+
+    if (p->wait_window != NULL && w->display != NULL && !p->window_seen)
+        met = false;
+
+    if (p->wait_selection != NULL && w->display != NULL && XGetSelectionOwner(w->display, p->selection) == None)
+        met = false;
+
+    if (p->wait_socket != NULL && access(p->wait_socket, F_OK) != 0)
+    {
+        if (w->inotify >= 0)
+            WatchClosestDir(w->inotify, p->wait_socket, IN_CREATE | IN_MOVED_TO | IN_ATTRIB);
+        met = false;
+    }
+
+    if (!met && p->wait_timeout > 0 && now >= p->waiting_since + (long long)p->wait_timeout * 1000)
+    {
+        syslog(LOG_ERR, "JWMS: autostart %s waited %d seconds, starting it anyway", p->name, p->wait_timeout);
+        return true;
+    }
+
+    return met;
+}
+
+// A waiting program gets its start time once the programs it comes after are ready and its wait_ conditions hold
+static void Schedule(Autostart *autostart, AutostartProgram *p, long long now)
+{
+    long long ready = autostart->start;
+
+    for (int i = 0; i < p->num_after; i++)
+    {
+        AutostartProgram *dep = &autostart->programs[p->after[i]];
+        if (dep->ready_at < 0)
+            return;
+
+        if (dep->ready_at > ready)
+            ready = dep->ready_at;
+    }
+
+    if (p->waiting_since < 0)
+        p->waiting_since = now;
+
+    if (HasWaits(p))
+    {
+        if (!WaitsMet(p, &autostart->watches, now))
+            return;
+
+        TRACE_EVENT_FMT(p->waiting_since * 1000, now * 1000, "autostart wait %s", p->name);
+        ready = now;
+    }
+
+    p->due = ready + (long long)p->sleep_time * 1000;
+    p->state = AutostartScheduled;
+}
+
+// Starts whatever is due, then arms the timer to the next deadline. Runs after every event that could let a
+// program go: the timer, an exit, a new window or selection owner and a new file.
+static void Step(Autostart *autostart)
+{
+    AutostartWatches *w = &autostart->watches;
+    bool again;
+
+    do
+    {
+        long long now = NowMs();
+        again = false;
+
+        DrainWatches(w);
+
+        if (w->display != NULL && w->clients_changed)
+            ScanClients(autostart);
+
+        for (int i = 0; i < autostart->num_programs; i++)
+        {
+            AutostartProgram *p = &autostart->programs[i];
+
+            if (p->state == AutostartWaiting)
+                Schedule(autostart, p, now);
+
+            // The ones after it may be able to go as well
+            if (p->state == AutostartScheduled && p->due <= now)
+            {
+                if (p->kill)
+                    KillRunning(autostart, p, now);
+                else
+                    Launch(autostart, p);
+
+                again = true;
+            }
+
+            // A new instance could otherwise still find the old one and quit
+            if (p->state == AutostartStopping && (p->num_stopping == 0 || p->stop_deadline <= now))
+            {
+                TRACE_EVENT_FMT((p->stop_deadline - KILL_WAIT_MS) * 1000, now * 1000, "autostart kill %s", p->name);
+                ReleaseStopping(autostart, p);
+                Launch(autostart, p);
+                again = true;
+            }
+        }
+
+        // Replies to the requests above can bring events along that never show up on the connection again
+        if (w->display != NULL && XEventsQueued(w->display, QueuedAlready) > 0)
+            again = true;
+    } while (again);
+
+    long long earliest = -1;
+    bool waiting = false;
+
+    for (int i = 0; i < autostart->num_programs; i++)
+    {
+        AutostartProgram *p = &autostart->programs[i];
+        long long deadline = -1;
+
+        if (p->state == AutostartScheduled)
+        {
+            deadline = p->due;
+        }
+        else if (p->state == AutostartStopping)
+        {
+            deadline = p->stop_deadline;
+        }
+        else if (p->state == AutostartWaiting)
+        {
+            waiting = true;
+            if (p->waiting_since >= 0 && HasWaits(p) && p->wait_timeout > 0)
+                deadline = p->waiting_since + (long long)p->wait_timeout * 1000;
+        }
+
+        if (deadline >= 0 && (earliest < 0 || deadline < earliest))
+            earliest = deadline;
+    }
+
+    TimerSetDeadline(autostart->timer, earliest);
+
+    // Nothing waits for a window, selection or socket anymore
+    if (!waiting)
+        CloseWatches(autostart);
+}
+
+static void OnWatchEvent(uint32_t events, void *data)
+{
+    (void)events;
+    Step(data);
+}
+
+static void OnTimer(uint32_t events, void *data)
+{
+    Autostart *autostart = data;
+
+    (void)events;
+    TimerClear(autostart->timer);
+    Step(autostart);
+}
+
+int AutostartStart(Autostart *autostart, EventLoop *loop, Supervisor *supervisor)
+{
+    if (autostart->num_programs == 0)
+        return 0;
+
+    autostart->loop = loop;
+    autostart->supervisor = supervisor;
+    autostart->start = NowMs();
+    autostart->timer = TimerCreate();
+
+    if (autostart->timer < 0)
+        return -1;
+
+    autostart->timer_source = EventLoopAdd(loop, autostart->timer, OnTimer, autostart);
+    if (autostart->timer_source == NULL)
+        return -1;
+
+    OpenWatches(autostart);
+    Step(autostart);
+    return 0;
+}
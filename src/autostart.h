@@ -0,0 +1,103 @@
+#ifndef AUTOSTART_H
+#define AUTOSTART_H
+
+// The autostart sections of jwms.conf, launched by jwms instead of the script jwm-helper generates.
+// Programs are started in the order of the config. One without fork_needed holds back the ones after it
+// until it exits and sleep_time counts from there, the same as the lines of the script did.
+//
+// A program with "after" or one of the wait_ options only waits for what it declares instead: the programs
+// it comes after being ready (started with fork_needed, exited without), a window with the WM_CLASS
+// wait_window being managed, the selection wait_selection being owned and the path wait_socket existing.
+// sleep_time then counts from when the last of them held. Programs that don't wait for each other
+// start in parallel.
+//
+// nice, io_class, cpu_affinity and sched_idle are set on the program before it execs.
+
+typedef enum
+{
+    AutostartWaiting,
+    AutostartScheduled,
+    // restart_kill stopped the instances that were running, it starts once they are gone
+    AutostartStopping,
+    AutostartRunning,
+    AutostartDone
+} AutostartState;
+
+typedef struct Autostart Autostart;
+
+typedef struct
+{
+    int pidfd;
+    EventSource *source;
+} StoppingProcess;
+
+typedef struct
+{
+    char *name;
+    char *program;
+    char *args;
+    int sleep_time;
+    bool fork;
+    bool kill;
+    bool restart_on_crash;
+    // nice, io_class, io_level, cpu_affinity and sched_idle
+    SpawnOptions options;
+
+    // Indexes of the programs this one waits for
+    int *after;
+    int num_after;
+    char *wait_window;
+    char *wait_selection;
+    char *wait_socket;
+    // Seconds until the wait_ conditions are given up on and the program starts anyway
+    int wait_timeout;
+    Atom selection;
+    bool window_seen;
+
+    AutostartState state;
+    Process *process;
+    // The instances restart_kill sent SIGTERM, they get until stop_deadline to exit
+    StoppingProcess *stopping;
+    int num_stopping;
+    long long stop_deadline;
+    Autostart *autostart;
+    // CLOCK_MONOTONIC in milliseconds, -1 while unknown
+    long long waiting_since;
+    long long due;
+    long long ready_at;
+} AutostartProgram;
+
+// What the wait_ conditions are watched with. The X connection and the inotify descriptor are only open
+// while a program needs them, without them its conditions count as met.
+typedef struct
+{
+    Display *display;
+    Window root;
+    Atom client_list;
+    bool clients_changed;
+    EventSource *display_source;
+    int inotify;
+    EventSource *inotify_source;
+} AutostartWatches;
+
+struct Autostart
+{
+    AutostartProgram *programs;
+    int num_programs;
+
+    EventLoop *loop;
+    Supervisor *supervisor;
+    // Armed to the next program that is due or the next wait_timeout
+    int timer;
+    EventSource *timer_source;
+    AutostartWatches watches;
+    long long start;
+};
+
+// Leaves autostart empty when global_native_autostart is turned off
+int AutostartLoad(Autostart *autostart);
+// Starts the programs as they become due from the event loop, the supervisor restarts the ones that asked for it
+int AutostartStart(Autostart *autostart, EventLoop *loop, Supervisor *supervisor);
+void AutostartDestroy(Autostart *autostart);
+
+#endif
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <dirent.h>
@@ -13,12 +14,13 @@
 #include <confuse.h>
 
 #include "common.h"
-#include "bstree.h"
+#include "containers.h"
 #include "darray.h"
+#include "arena.h"
 #include "hashing.h"
 #include "list.h"
-#include "icons.h"
 #include "desktop_entries.h"
+#include "icons.h"
 
 #include "config.h"
 
@@ -162,8 +164,19 @@ int LoadJWMConfig(JWM **jwm, cfg_t **cfg)
         CFG_INT("sleep_time", 0, CFGF_NONE),
         CFG_BOOL("fork_needed", false, CFGF_NONE),
         CFG_BOOL("restart_kill", false, CFGF_NONE),
+        CFG_BOOL("restart_on_crash", false, CFGF_NONE),
         CFG_STR("program", NULL, CFGF_NONE),
         CFG_STR("args", NULL, CFGF_NONE),
+        CFG_STR_LIST("after", NULL, CFGF_NONE),
+        CFG_STR("wait_window", NULL, CFGF_NONE),
+        CFG_STR("wait_selection", NULL, CFGF_NONE),
+        CFG_STR("wait_socket", NULL, CFGF_NONE),
+        CFG_INT("wait_timeout", 30, CFGF_NONE),
+        CFG_INT("nice", 0, CFGF_NONE),
+        CFG_STR("io_class", NULL, CFGF_NONE),
+        CFG_INT("io_level", 4, CFGF_NONE),
+        CFG_STR("cpu_affinity", NULL, CFGF_NONE),
+        CFG_BOOL("sched_idle", false, CFGF_NONE),
 		CFG_END()
 	};
 
@@ -202,6 +215,7 @@ int LoadJWMConfig(JWM **jwm, cfg_t **cfg)
         CFG_STR("global_shutdown_cmd", "poweroff", CFGF_NONE),
         CFG_STR("global_reboot_cmd", "reboot", CFGF_NONE),
         CFG_BOOL("global_enable_rofi", false, CFGF_NONE),
+        CFG_BOOL("global_native_autostart", false, CFGF_NONE),
 
         CFG_BOOL("window_use_global_decorations_style", true, CFGF_NONE),
         CFG_BOOL("window_use_global_colors", true, CFGF_NONE),
@@ -316,7 +330,7 @@ int LoadJWMConfig(JWM **jwm, cfg_t **cfg)
 
     *cfg = cfg_init(opts, CFGF_NONE);
 
-    if (ReadConfigFile(*cfg, "jwms.conf", "~/.config/jwms/", "/etc/jwms/") != 0)
+    if (ReadConfigFile(*cfg, JWMS_CONFIG_NAME, JWMS_USER_CONFIG_DIR, JWMS_SYSTEM_CONFIG_DIR) != 0)
         return -1;
 
     *jwm = calloc(1, sizeof(**jwm));
@@ -336,6 +350,7 @@ int LoadJWMConfig(JWM **jwm, cfg_t **cfg)
     (*jwm)->global_shutdown_cmd = cfg_getstr(*cfg, "global_shutdown_cmd");
     (*jwm)->global_reboot_cmd = cfg_getstr(*cfg, "global_reboot_cmd");
     (*jwm)->global_enable_rofi = cfg_getbool(*cfg, "global_enable_rofi");
+    (*jwm)->global_native_autostart = cfg_getbool(*cfg, "global_native_autostart");
 
     (*jwm)->terminal_name = cfg_getstr(*cfg, "global_terminal");
 
@@ -449,3 +464,95 @@ int LoadJWMConfig(JWM **jwm, cfg_t **cfg)
 
     return 0;
 }
+
+int ParseCPUList(const char *list, void (*Func)(int first, int last, void *args), void *args)
+{
+    const char *c = list;
+
+    if (*c == '\0' || strlen(list) > AUTOSTART_MAX_CPU_LIST)
+        return -1;
+
+    while (*c != '\0')
+    {
+        char *end;
+        long first = strtol(c, &end, 10);
+        long last = first;
+
+        if (end == c || first < 0)
+            return -1;
+
+        if (*end == '-')
+        {
+            c = end + 1;
+            last = strtol(c, &end, 10);
+            if (end == c || last < first)
+                return -1;
+        }
+
+        if (last >= AUTOSTART_MAX_CPUS)
+            return -1;
+
+        if (Func != NULL)
+            Func((int)first, (int)last, args);
+
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return -1;
+
+        c = end;
+    }
+
+    return 0;
+}
+
+int ReadAutostartScheduling(cfg_t *section, AutostartScheduling *scheduling)
+{
+    const char *title = cfg_title(section);
+    int invalid = 0;
+
+    scheduling->nice = cfg_getint(section, "nice");
+    if (scheduling->nice < -20 || scheduling->nice > 19)
+    {
+        printf("autostart %s has nice %d, it has to be between -20 and 19\n", title, scheduling->nice);
+        scheduling->nice = 0;
+        invalid++;
+    }
+
+    scheduling->io_class = AUTOSTART_IO_UNCHANGED;
+    scheduling->io_level = 4;
+
+    const char *io_class = cfg_getstr(section, "io_class");
+    if (io_class != NULL && strcmp(io_class, "idle") == 0)
+    {
+        scheduling->io_class = AUTOSTART_IO_IDLE;
+    }
+    else if (io_class != NULL && strcmp(io_class, "best-effort") == 0)
+    {
+        scheduling->io_class = AUTOSTART_IO_BEST_EFFORT;
+        scheduling->io_level = cfg_getint(section, "io_level");
+
+        if (scheduling->io_level < 0 || scheduling->io_level > 7)
+        {
+            printf("autostart %s has io_level %d, it has to be between 0 and 7\n", title, scheduling->io_level);
+            scheduling->io_level = 4;
+            invalid++;
+        }
+    }
+    else if (io_class != NULL)
+    {
+        printf("autostart %s has unknown io_class %s\n", title, io_class);
+        invalid++;
+    }
+
+    scheduling->cpu_affinity = cfg_getstr(section, "cpu_affinity");
+    if (scheduling->cpu_affinity != NULL && ParseCPUList(scheduling->cpu_affinity, NULL, NULL) != 0)
+    {
+        printf("autostart %s has an invalid cpu_affinity %s\n", title, scheduling->cpu_affinity);
+        scheduling->cpu_affinity = NULL;
+        invalid++;
+    }
+
+    scheduling->sched_idle = cfg_getbool(section, "sched_idle");
+    return invalid;
+}
@@ -44,6 +44,11 @@ typedef enum
     PopupStyle,
 } Styles;
 
+// jwms.conf is looked up in the user directory first, then in the system directory
+#define JWMS_CONFIG_NAME "jwms.conf"
+#define JWMS_USER_CONFIG_DIR "~/.config/jwms/"
+#define JWMS_SYSTEM_CONFIG_DIR "/etc/jwms/"
+
 #define MAX_TRAYS 6
 #define MAX_TRAY_PROGRAMS 48
 
@@ -88,6 +93,10 @@ typedef struct
 
     bool global_enable_rofi;
 
+    // jwms starts the autostart programs itself, JWM no longer runs the generated script. Only honoured
+    // inside jwms, jwm-helper on its own always has JWM run the script
+    bool global_native_autostart;
+
     bool tray_use_global_decorations_style;
     bool tray_use_global_colors;
     bool tray_use_global_font;
@@ -197,12 +206,37 @@ typedef struct
     char *desktop_background;
 
     char *autogen_config_path;
+    char *jwmrc_path;
     char *browser_name;
     char *terminal_name;
     char *filemanager_name;
 } JWM;
 
-int CreateJWMFolder(JWM *jwm);
+// The scheduling options of an autostart section. The generated script and jwms both read them through
+// ReadAutostartScheduling, so they accept and leave out the same values. The I/O classes are those of ionice -c.
+#define AUTOSTART_IO_UNCHANGED 0
+#define AUTOSTART_IO_BEST_EFFORT 2
+#define AUTOSTART_IO_IDLE 3
+// CPU_SETSIZE of glibc
+#define AUTOSTART_MAX_CPUS 1024
+// Longer cpu_affinity lists are rejected, the script has a fixed size buffer for the wrappers
+#define AUTOSTART_MAX_CPU_LIST 128
+
+typedef struct
+{
+    int nice;
+    int io_class;
+    // 0 to 7, only counts for best effort
+    int io_level;
+    // A list ParseCPUList accepts, NULL without one
+    const char *cpu_affinity;
+    bool sched_idle;
+} AutostartScheduling;
+
+FILE *OutputOpen(const char *path);
+int OutputClose(FILE *fp, const char *path);
+void OutputAbort(FILE *fp, const char *path);
+int CreateJWMFolder(JWM *jwm, const char *output_dir);
 int CreateJWMStartup(JWM *jwm);
 int CreateJWMGroup(JWM *jwm);
 int CreateJWMPreferences(JWM *jwm);
@@ -211,10 +245,14 @@ int CreateJWMRCBackup(char *path, char *backup_path);
 int CreateJWMRCFile(JWM *jwm);
 int CreateJWMAutoStart(JWM *jwm, cfg_t *cfg);
 int CreateJWMBinds(JWM *jwm, cfg_t *cfg);
-int CreateJWMTray(JWM *jwm, BTreeNode *entries, HashMap *icons);
-int CreateJWMRootMenu(JWM *jwm, BTreeNode *entries, HashMap *icons, const char *xdg_menu_path);
+int CreateJWMTray(JWM *jwm, EntryStore *entries, HashMap *icons);
+int CreateJWMRootMenu(JWM *jwm, EntryStore *entries, HashMap *icons, const char *xdg_menu_path);
 int CreateJWMStyles(JWM *jwm);
 int LoadJWMConfig(JWM **jwm, cfg_t **cfg);
+// Reports the invalid values and leaves them out, returns how many there were
+int ReadAutostartScheduling(cfg_t *section, AutostartScheduling *scheduling);
+// A list of CPUs like taskset -c takes, "0-3,6". Func gets every range unless it is NULL, -1 for an invalid list
+int ParseCPUList(const char *list, void (*Func)(int first, int last, void *args), void *args);
 
 
 #endif
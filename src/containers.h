@@ -0,0 +1,333 @@
+#ifndef CONTAINERS_H
+#define CONTAINERS_H
+
+// Containers generated for one element type. Unlike DArray and HashMap2 the elements are stored by value,
+// and the compare and hash functions are plain functions the compiler can inline instead of callbacks.
+// The containers never own what their elements point to, freeing that is up to the caller.
+//
+// VEC_DEFINE(Name, Type)
+//     Name with data, size and capacity, plus NameInit, NamePush, NameRemove and NameDestroy
+//
+// VEC_DEFINE_SEARCH(Name, Type, KeyType, KeyCmp)
+//     NameIndexOf, a linear search. KeyCmp(const Type*, KeyType) returns 0 on a match
+//
+// VEC_DEFINE_SORTED(Name, Type, KeyType, Cmp, KeyCmp)
+//     NameSort (stable), NameFind (binary search), NameInsert and NameDedupe. Cmp(const Type*, const Type*)
+//     orders two elements and KeyCmp(const Type*, KeyType) orders an element against a key
+//
+// MAP_DEFINE(Name, KeyType, ValueType, Hash, Equals)
+//     Open addressing with linear probing, NameInit, NameInsert, NameGet and NameDestroy.
+//     Hash(KeyType) returns a uint32_t and Equals(KeyType, KeyType) a bool. NameInit returns -1 and
+//     NameInsert NULL when they run out of memory
+//
+// Needs <stddef.h>, <stdlib.h>, <stdbool.h>, <stdint.h> and <string.h>
+
+#define VEC_NOT_FOUND ((size_t)-1)
+
+#define VEC_DEFINE(Name, Type)                                                              \
+typedef struct                                                                              \
+{                                                                                           \
+    Type *data;                                                                             \
+    size_t size;                                                                            \
+    size_t capacity;                                                                        \
+} Name;                                                                                     \
+                                                                                            \
+static inline void Name##Init(Name *vec, size_t capacity)                                   \
+{                                                                                           \
+    vec->data = capacity ? malloc(sizeof(Type) * capacity) : NULL;                          \
+    vec->size = 0;                                                                          \
+    vec->capacity = vec->data != NULL ? capacity : 0;                                       \
+}                                                                                           \
+                                                                                            \
+static inline int Name##Push(Name *vec, Type value)                                         \
+{                                                                                           \
+    if (vec->size == vec->capacity)                                                         \
+    {                                                                                       \
+        size_t capacity = vec->capacity ? vec->capacity * 2 : 8;                            \
+        Type *data = realloc(vec->data, sizeof(Type) * capacity);                           \
+        if (data == NULL)                                                                   \
+            return -1;                                                                      \
+                                                                                            \
+        vec->data = data;                                                                   \
+        vec->capacity = capacity;                                                           \
+    }                                                                                       \
+                                                                                            \
+    vec->data[vec->size++] = value;                                                         \
+    return 0;                                                                               \
+}                                                                                           \
+                                                                                            \
+static inline void Name##Remove(Name *vec, size_t index)                                    \
+{                                                                                           \
+    if (index >= vec->size)                                                                 \
+        return;                                                                             \
+                                                                                            \
+    memmove(&vec->data[index], &vec->data[index + 1], (vec->size - index - 1) * sizeof(Type)); \
+    vec->size--;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline void Name##Destroy(Name *vec)                                                 \
+{                                                                                           \
+    free(vec->data);                                                                        \
+    vec->data = NULL;                                                                       \
+    vec->size = 0;                                                                          \
+    vec->capacity = 0;                                                                      \
+}
+
+#define VEC_DEFINE_SEARCH(Name, Type, KeyType, KeyCmp)                                      \
+static inline size_t Name##IndexOf(const Name *vec, KeyType key)                            \
+{                                                                                           \
+    for (size_t i = 0; i < vec->size; i++)                                                  \
+    {                                                                                       \
+        if (KeyCmp(&vec->data[i], key) == 0)                                                \
+            return i;                                                                       \
+    }                                                                                       \
+                                                                                            \
+    return VEC_NOT_FOUND;                                                                   \
+}
+
+// Bottom up merge sort, it keeps equal elements in the order they were added which qsort doesn't
+#define VEC_DEFINE_SORTED(Name, Type, KeyType, Cmp, KeyCmp)                                 \
+static inline int Name##Sort(Name *vec)                                                     \
+{                                                                                           \
+    if (vec->size < 2)                                                                      \
+        return 0;                                                                           \
+                                                                                            \
+    Type *buffer = malloc(sizeof(Type) * vec->size);                                        \
+    if (buffer == NULL)                                                                     \
+        return -1;                                                                          \
+                                                                                            \
+    Type *src = vec->data;                                                                  \
+    Type *dst = buffer;                                                                     \
+                                                                                            \
+    for (size_t width = 1; width < vec->size; width *= 2)                                   \
+    {                                                                                       \
+        for (size_t left = 0; left < vec->size; left += width * 2)                          \
+        {                                                                                   \
+            size_t mid = left + width < vec->size ? left + width : vec->size;               \
+            size_t right = mid + width < vec->size ? mid + width : vec->size;               \
+            size_t i = left;                                                                \
+            size_t j = mid;                                                                 \
+            size_t k = left;                                                                \
+                                                                                            \
+            while (i < mid && j < right)                                                    \
+                dst[k++] = Cmp(&src[j], &src[i]) < 0 ? src[j++] : src[i++];                 \
+            while (i < mid)                                                                 \
+                dst[k++] = src[i++];                                                        \
+            while (j < right)                                                               \
+                dst[k++] = src[j++];                                                        \
+        }                                                                                   \
+                                                                                            \
+        Type *swap = src;                                                                   \
+        src = dst;                                                                          \
+        dst = swap;                                                                         \
+    }                                                                                       \
+                                                                                            \
+    if (src != vec->data)                                                                   \
+        memcpy(vec->data, src, sizeof(Type) * vec->size);                                   \
+                                                                                            \
+    free(buffer);                                                                           \
+    return 0;                                                                               \
+}                                                                                           \
+                                                                                            \
+/* Only valid after NameSort */                                                             \
+static inline Type *Name##Find(const Name *vec, KeyType key)                                \
+{                                                                                           \
+    size_t left = 0;                                                                        \
+    size_t right = vec->size;                                                               \
+                                                                                            \
+    while (left < right)                                                                    \
+    {                                                                                       \
+        size_t mid = left + (right - left) / 2;                                             \
+        int cmp = KeyCmp(&vec->data[mid], key);                                             \
+                                                                                            \
+        if (cmp == 0)                                                                       \
+            return &vec->data[mid];                                                         \
+        else if (cmp < 0)                                                                   \
+            left = mid + 1;                                                                 \
+        else                                                                                \
+            right = mid;                                                                    \
+    }                                                                                       \
+                                                                                            \
+    return NULL;                                                                            \
+}                                                                                           \
+                                                                                            \
+/* Only valid after NameSort, value goes after the elements equal to it */                  \
+static inline int Name##Insert(Name *vec, Type value)                                       \
+{                                                                                           \
+    size_t left = 0;                                                                        \
+    size_t right = vec->size;                                                               \
+                                                                                            \
+    while (left < right)                                                                    \
+    {                                                                                       \
+        size_t mid = left + (right - left) / 2;                                             \
+        if (Cmp(&vec->data[mid], &value) <= 0)                                              \
+            left = mid + 1;                                                                 \
+        else                                                                                \
+            right = mid;                                                                    \
+    }                                                                                       \
+                                                                                            \
+    if (Name##Push(vec, value) != 0)                                                        \
+        return -1;                                                                          \
+                                                                                            \
+    memmove(&vec->data[left + 1], &vec->data[left], (vec->size - left - 1) * sizeof(Type)); \
+    vec->data[left] = value;                                                                \
+    return 0;                                                                               \
+}                                                                                           \
+                                                                                            \
+/* Keeps the first of each run of equal elements in a sorted vector and hands the rest to Destroy */ \
+static inline void Name##Dedupe(Name *vec, void (*Destroy)(Type*))                          \
+{                                                                                           \
+    if (vec->size < 2)                                                                      \
+        return;                                                                             \
+                                                                                            \
+    size_t j = 0;                                                                           \
+    for (size_t i = 1; i < vec->size; i++)                                                  \
+    {                                                                                       \
+        if (Cmp(&vec->data[j], &vec->data[i]) != 0)                                         \
+            vec->data[++j] = vec->data[i];                                                  \
+        else if (Destroy != NULL)                                                           \
+            Destroy(&vec->data[i]);                                                         \
+    }                                                                                       \
+                                                                                            \
+    vec->size = j + 1;                                                                      \
+}
+
+// Slot hashes of 0 mark empty slots, a real hash of 0 gets stored as 1
+#define MAP_DEFINE(Name, KeyType, ValueType, Hash, Equals)                                  \
+typedef struct                                                                              \
+{                                                                                           \
+    uint32_t *hashes;                                                                       \
+    KeyType *keys;                                                                          \
+    ValueType *values;                                                                      \
+    size_t size;                                                                            \
+    size_t capacity;                                                                        \
+} Name;                                                                                     \
+                                                                                            \
+static inline void Name##Destroy(Name *map)                                                 \
+{                                                                                           \
+    free(map->hashes);                                                                      \
+    free(map->keys);                                                                        \
+    free(map->values);                                                                      \
+    map->hashes = NULL;                                                                     \
+    map->keys = NULL;                                                                       \
+    map->values = NULL;                                                                     \
+    map->size = 0;                                                                          \
+    map->capacity = 0;                                                                      \
+}                                                                                           \
+                                                                                            \
+/* The capacity gets rounded up to a power of two of at least 8 */                          \
+static inline int Name##Init(Name *map, size_t capacity)                                    \
+{                                                                                           \
+    size_t rounded = 8;                                                                     \
+    while (rounded < capacity)                                                              \
+        rounded *= 2;                                                                       \
+                                                                                            \
+    map->hashes = calloc(rounded, sizeof(uint32_t));                                        \
+    map->keys = malloc(sizeof(KeyType) * rounded);                                          \
+    map->values = malloc(sizeof(ValueType) * rounded);                                      \
+    map->size = 0;                                                                          \
+    map->capacity = rounded;                                                                \
+                                                                                            \
+    if (map->hashes == NULL || map->keys == NULL || map->values == NULL)                    \
+    {                                                                                       \
+        Name##Destroy(map);                                                                 \
+        return -1;                                                                          \
+    }                                                                                       \
+                                                                                            \
+    return 0;                                                                               \
+}                                                                                           \
+                                                                                            \
+static inline uint32_t Name##SlotHash(KeyType key)                                          \
+{                                                                                           \
+    uint32_t hash = Hash(key);                                                              \
+    return hash ? hash : 1;                                                                 \
+}                                                                                           \
+                                                                                            \
+/* Returns the slot of key or the empty slot it would go into */                            \
+static inline size_t Name##Slot(const Name *map, KeyType key, uint32_t hash, size_t *probes) \
+{                                                                                           \
+    size_t mask = map->capacity - 1;                                                        \
+    size_t index = hash & mask;                                                             \
+                                                                                            \
+    *probes = 1;                                                                            \
+    while (map->hashes[index] != 0)                                                         \
+    {                                                                                       \
+        if (map->hashes[index] == hash && Equals(map->keys[index], key))                    \
+            break;                                                                          \
+                                                                                            \
+        index = (index + 1) & mask;                                                         \
+        (*probes)++;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    return index;                                                                           \
+}                                                                                           \
+                                                                                            \
+static inline int Name##Grow(Name *map)                                                     \
+{                                                                                           \
+    Name grown;                                                                             \
+    if (Name##Init(&grown, map->capacity * 2) != 0)                                         \
+        return -1;                                                                          \
+                                                                                            \
+    for (size_t i = 0; i < map->capacity; i++)                                              \
+    {                                                                                       \
+        if (map->hashes[i] == 0)                                                            \
+            continue;                                                                       \
+                                                                                            \
+        size_t index = map->hashes[i] & (grown.capacity - 1);                               \
+        while (grown.hashes[index] != 0)                                                    \
+            index = (index + 1) & (grown.capacity - 1);                                     \
+                                                                                            \
+        grown.hashes[index] = map->hashes[i];                                               \
+        grown.keys[index] = map->keys[i];                                                   \
+        grown.values[index] = map->values[i];                                               \
+    }                                                                                       \
+                                                                                            \
+    grown.size = map->size;                                                                 \
+    Name##Destroy(map);                                                                     \
+    *map = grown;                                                                           \
+    return 0;                                                                               \
+}                                                                                           \
+                                                                                            \
+/* Returns the value slot of key, *found tells if it held a value already */                \
+static inline ValueType *Name##Insert(Name *map, KeyType key, bool *found)                  \
+{                                                                                           \
+    if ((map->size + 1) * 4 > map->capacity * 3 && Name##Grow(map) != 0)                    \
+        return NULL;                                                                        \
+                                                                                            \
+    size_t probes;                                                                          \
+    uint32_t hash = Name##SlotHash(key);                                                    \
+    size_t index = Name##Slot(map, key, hash, &probes);                                     \
+                                                                                            \
+    *found = map->hashes[index] != 0;                                                       \
+    if (!*found)                                                                            \
+    {                                                                                       \
+        map->hashes[index] = hash;                                                          \
+        map->size++;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    map->keys[index] = key;                                                                 \
+    return &map->values[index];                                                             \
+}                                                                                           \
+                                                                                            \
+static inline ValueType *Name##Get(const Name *map, KeyType key, size_t *probes)            \
+{                                                                                           \
+    if (map->capacity == 0)                                                                 \
+    {                                                                                       \
+        *probes = 0;                                                                        \
+        return NULL;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    size_t index = Name##Slot(map, key, Name##SlotHash(key), probes);                       \
+    return map->hashes[index] != 0 ? &map->values[index] : NULL;                            \
+}
+
+// Strings are common enough to have their vector defined here
+static inline int StrKeyCmp(char *const *str, const char *key)
+{
+    return strcmp(*str, key);
+}
+
+VEC_DEFINE(StrVec, char*)
+VEC_DEFINE_SEARCH(StrVec, char*, const char*, StrKeyCmp)
+
+#endif
@@ -0,0 +1,414 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <bsd/string.h>
+
+#include "darray.h"
+#include "helper_status.h"
+#include "helper.h"
+#include "daemon.h"
+#include "trace.h"
+
+// The time a client gets for all of its requests, the others wait for no longer than this
+#define CLIENT_TIMEOUT_SEC 5
+#define REQUEST_MAX 1024
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void OnStopSignal(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+void DaemonSocketPath(char *path, size_t size)
+{
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+
+    if (runtime_dir != NULL && runtime_dir[0] != '\0')
+        snprintf(path, size, "%s/jwm-helper.sock", runtime_dir);
+    else
+        snprintf(path, size, "/tmp/jwm-helper-%u.sock", (unsigned int)getuid());
+}
+
+static int OpenSocket(const char *path, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    if (strlcpy(addr->sun_path, path, sizeof(addr->sun_path)) >= sizeof(addr->sun_path))
+    {
+        printf("Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        printf("Failed to create a socket: %s\n", strerror(errno));
+
+    return fd;
+}
+
+static int ConnectSocket(const char *path)
+{
+    struct sockaddr_un addr;
+
+    int fd = OpenSocket(path, &addr);
+    if (fd < 0)
+        return -1;
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int ListenSocket(const char *path)
+{
+    // A socket nobody answers on is left over from a daemon that didn't get to clean up
+    int running = ConnectSocket(path);
+    if (running >= 0)
+    {
+        close(running);
+        printf("A daemon is already listening on %s\n", path);
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+
+    int fd = OpenSocket(path, &addr);
+    if (fd < 0)
+        return -1;
+
+    unlink(path);
+
+    // Only the user can connect
+    mode_t mask = umask(077);
+    int ret = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    umask(mask);
+
+    if (ret != 0 || listen(fd, 16) != 0)
+    {
+        printf("Failed to listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void Generate(Helper *helper, const char *file, FILE *out)
+{
+    if (file == NULL || strcmp(file, "all") == 0 || strcmp(file, "force") == 0)
+    {
+        HelperStatus status = HelperGenerateAll(helper, file != NULL && strcmp(file, "force") == 0);
+        if (status == HelperFailed)
+            fprintf(out, "ERR generating failed\n");
+        else
+            fprintf(out, "OK %d\n", status);
+
+        return;
+    }
+
+    GeneratorType type = HelperFindGenerator(file);
+    if (type == NumGenerators)
+    {
+        fprintf(out, "ERR unknown file %s\n", file);
+        return;
+    }
+
+    if (HelperSnapshotOutputs(helper) != 0 || HelperGenerate(helper, HELPER_OUTPUT(type)) != 0)
+    {
+        // Drops the snapshot for the next request
+        HelperReportChanges(helper);
+        fprintf(out, "ERR generating %s failed\n", file);
+        return;
+    }
+
+    fprintf(out, "OK %d\n", HelperReportChanges(helper));
+}
+
+static void LookupIcon(Helper *helper, const char *name, const char *size_str, FILE *out)
+{
+    if (name == NULL)
+    {
+        fprintf(out, "ERR missing icon name\n");
+        return;
+    }
+
+    int size = 0;
+    if (size_str != NULL)
+    {
+        char *end;
+        size = strtol(size_str, &end, 10);
+        if (*end != '\0' || size <= 0)
+        {
+            fprintf(out, "ERR invalid size %s\n", size_str);
+            return;
+        }
+    }
+
+    const char *path = HelperLookupIcon(helper, name, size);
+    if (path == NULL)
+        fprintf(out, "ERR icon %s not found\n", name);
+    else
+        fprintf(out, "OK %s\n", path);
+}
+
+static void WriteEntry(const char *name, const char *exec, const char *icon, void *fp)
+{
+    fprintf(fp, "%s\t%s\t%s\n", name, exec, icon);
+}
+
+// The count goes first, so the entries are collected before anything is sent
+static void ListCategory(Helper *helper, const char *category, FILE *out)
+{
+    if (category == NULL)
+    {
+        fprintf(out, "ERR missing category\n");
+        return;
+    }
+
+    char *buffer = NULL;
+    size_t buffer_size = 0;
+    FILE *fp = open_memstream(&buffer, &buffer_size);
+    if (fp == NULL)
+    {
+        fprintf(out, "ERR out of memory\n");
+        return;
+    }
+
+    int count = HelperListCategory(helper, category, WriteEntry, fp);
+    fclose(fp);
+
+    if (count < 0)
+        fprintf(out, "ERR loading the entries failed\n");
+    else
+        fprintf(out, "OK %d\n%s", count, buffer);
+
+    free(buffer);
+}
+
+static void HandleRequest(Helper *helper, char *line, FILE *out)
+{
+    TRACE_SCOPE("request");
+
+    line[strcspn(line, "\r\n")] = '\0';
+
+    char *reserved;
+    char *command = strtok_r(line, " ", &reserved);
+    char *arg = strtok_r(NULL, " ", &reserved);
+    char *arg2 = strtok_r(NULL, " ", &reserved);
+
+    if (command == NULL)
+    {
+        fprintf(out, "ERR empty request\n");
+        return;
+    }
+
+    if (strcmp(command, "STOP") == 0)
+    {
+        stop_requested = 1;
+        fprintf(out, "OK\n");
+        return;
+    }
+
+    HelperRefresh(helper);
+
+    if (strcmp(command, "GENERATE") == 0)
+        Generate(helper, arg, out);
+    else if (strcmp(command, "ICON") == 0)
+        LookupIcon(helper, arg, arg2, out);
+    else if (strcmp(command, "LIST") == 0)
+        ListCategory(helper, arg, out);
+    else
+        fprintf(out, "ERR unknown request %s\n", command);
+}
+
+static long long NowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Waits for more of the request until the deadline, 0 once the client is done and -1 when out of time
+static ssize_t ReadMore(int client, char *buffer, size_t size, size_t *len, long long deadline)
+{
+    long long left = deadline - NowMs();
+    if (left <= 0)
+        return -1;
+
+    struct pollfd fd = { .fd = client, .events = POLLIN };
+    if (poll(&fd, 1, (int)left) <= 0)
+        return -1;
+
+    ssize_t got = read(client, buffer + *len, size - *len);
+    if (got > 0)
+        *len += got;
+
+    return got;
+}
+
+static void ServeClient(Helper *helper, int client)
+{
+    // The deadline covers the whole connection, a client trickling in lines can't keep the others waiting either
+    long long deadline = NowMs() + CLIENT_TIMEOUT_SEC * 1000;
+
+    struct timeval timeout = { .tv_sec = CLIENT_TIMEOUT_SEC };
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    int client_out = dup(client);
+    FILE *out = client_out >= 0 ? fdopen(client_out, "w") : NULL;
+
+    if (out == NULL)
+    {
+        printf("Failed to open the client connection: %s\n", strerror(errno));
+
+        if (client_out >= 0)
+            close(client_out);
+
+        close(client);
+        return;
+    }
+
+    char buffer[REQUEST_MAX + 1];
+    size_t len = 0;
+
+    while (!stop_requested)
+    {
+        char *end = memchr(buffer, '\n', len);
+        if (end == NULL)
+        {
+            if (len == REQUEST_MAX)
+            {
+                fprintf(out, "ERR request too long\n");
+                break;
+            }
+
+            ssize_t got = ReadMore(client, buffer, REQUEST_MAX, &len, deadline);
+            if (got > 0)
+                continue;
+
+            // The last request doesn't need its newline, one cut off by the deadline isn't answered
+            if (got < 0 || len == 0)
+                break;
+
+            end = buffer + len;
+            len++;
+        }
+
+        *end = '\0';
+        HandleRequest(helper, buffer, out);
+        fflush(out);
+
+        size_t used = end + 1 - buffer;
+        memmove(buffer, buffer + used, len - used);
+        len -= used;
+    }
+
+    fclose(out);
+    close(client);
+}
+
+int DaemonRun(Helper *helper, const char *socket_path)
+{
+    int fd = ListenSocket(socket_path);
+    if (fd < 0)
+        return -1;
+
+    // No SA_RESTART, so a blocked accept returns
+    struct sigaction action = { .sa_handler = OnStopSignal };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    // A client that went away is noticed by the failed write
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Listening on %s\n", socket_path);
+
+    // Everything gets loaded up front, the first request is answered as fast as the ones after it
+    HelperRefresh(helper);
+    if (HelperResolveIcons(helper) != 0)
+        printf("Failed to load the entries and icons, trying again with the first request\n");
+
+    while (!stop_requested)
+    {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            printf("Failed to accept a connection: %s\n", strerror(errno));
+            break;
+        }
+
+        ServeClient(helper, client);
+    }
+
+    close(fd);
+    unlink(socket_path);
+    return stop_requested ? 0 : -1;
+}
+
+int DaemonRequest(const char *socket_path, const char *request)
+{
+    int fd = ConnectSocket(socket_path);
+    if (fd < 0)
+    {
+        printf("No daemon is listening on %s\n", socket_path);
+        return -1;
+    }
+
+    FILE *fp = fdopen(fd, "r+");
+    if (fp == NULL)
+    {
+        close(fd);
+        return -1;
+    }
+
+    fprintf(fp, "%s\n", request);
+    fflush(fp);
+    shutdown(fd, SHUT_WR);
+
+    // Only the first line says how it went, the rest is copied as it is
+    char *line = NULL;
+    size_t line_size = 0;
+    int ret = -1;
+
+    if (getline(&line, &line_size, fp) > 0)
+    {
+        ret = strncmp(line, "OK", 2) == 0 ? 0 : -1;
+        fputs(line, stdout);
+
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+            fwrite(buffer, 1, read, stdout);
+    }
+    else
+    {
+        printf("The daemon closed the connection without answering\n");
+    }
+
+    free(line);
+    fclose(fp);
+    return ret;
+}
@@ -0,0 +1,25 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+// jwm-helper --daemon keeps a Helper loaded and answers requests on a Unix socket, one line each:
+//
+//   GENERATE [all|force|FILE]  regenerates everything like --all (--force), or the one output FILE (menu,
+//                              tray, .jwmrc, ...), and answers OK with the status of --report-changes
+//   ICON NAME [SIZE]           answers OK with the path of the icon
+//   LIST CATEGORY              answers OK with the number of entries in the main category, followed by a
+//                              "name<TAB>exec<TAB>icon" line for each of them
+//   STOP                       answers OK and shuts the daemon down
+//
+// A request that fails is answered with ERR and the reason. Before every request the daemon checks the
+// inputs and drops what changed on disk, so a warm request costs a few stat calls and a hash lookup.
+//
+// Needs helper.h
+
+// $XDG_RUNTIME_DIR/jwm-helper.sock, or /tmp/jwm-helper-UID.sock without it
+void DaemonSocketPath(char *path, size_t size);
+// Serves requests until STOP, SIGINT or SIGTERM
+int DaemonRun(Helper *helper, const char *socket_path);
+// Sends one request and prints the answer, -1 if the daemon couldn't be reached or answered with ERR
+int DaemonRequest(const char *socket_path, const char *request);
+
+#endif
@@ -48,9 +48,13 @@ void **DArrayResize(DArray *darray, size_t capacity)
 
 void DArrayDestroy(DArray *darray)
 {
-    for (size_t i = 0; i < darray->size; i++)
+    // Arrays that don't own their elements have no destroy callback
+    if (darray->DestroyCallback != NULL)
     {
-        darray->DestroyCallback(darray->data[i]);
+        for (size_t i = 0; i < darray->size; i++)
+        {
+            darray->DestroyCallback(darray->data[i]);
+        }
     }
 
     free(darray->data);
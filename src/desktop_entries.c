@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
 #include <libgen.h>
@@ -11,11 +12,15 @@
 #include <bsd/string.h>
 
 #include "common.h"
-#include "bstree.h"
+#include "containers.h"
+#include "arena.h"
+#include "hashing.h"
+#include "intern.h"
 #include "darray.h"
 #include "list.h"
 
 #include "desktop_entries.h"
+#include "trace.h"
 
 static const Pair xdg_keys[] =
 {
@@ -108,39 +113,47 @@ static int CategoryCmp(const void *a, const void *b)
 }
 */
 
-static XDGDesktopEntry *CreateEmptyEntry(void)
+// One chunk holds the strings and categories of a few hundred entries
+#define ENTRY_ARENA_CHUNK_SIZE (64 * 1024)
+
+static XDGDesktopEntry *CreateEmptyEntry(Arena *arena)
 {
-    XDGDesktopEntry *entry = malloc(sizeof(*entry));
+    XDGDesktopEntry *entry = ArenaAlloc(arena, sizeof(*entry));
 
     if (entry == NULL)
         return NULL;
 
-    entry->categories = ListCreate();
-    //entry->categories = DArrayCreate(8, free, CategoryCmp, NULL);
-    //entry->category = Invalid;
+    entry->categories = ArenaAlloc(arena, sizeof(*entry->categories));
+    if (entry->categories == NULL)
+        return NULL;
+
+    entry->categories->head = NULL;
+    entry->categories->size = 0;
     entry->extra_category = IgnoredOrInvalid;
-    //entry->category_name = NULL;
     entry->extra_category_name = NULL;
     entry->name = NULL;
     entry->exec = NULL;
+    entry->exec_name = NULL;
     entry->try_exec = NULL;
     entry->icon = NULL;
+    entry->path = NULL;
     entry->terminal_required = false;
+    entry->shadows = false;
     return entry;
 }
 
-static void DestroyEntry(void *entry)
-{
-    XDGDesktopEntry *uentry = (XDGDesktopEntry*)entry;
-    //free(uentry->category_name);
-    free(uentry->extra_category_name);
-    free(uentry->name);
-    free(uentry->exec);
-    free(uentry->try_exec);
-    free(uentry->icon);
-    ListDestroy(uentry->categories);
-    //DArrayDestroy(uentry->categories);
-    free(entry);
+// Same as ListAdd, with the node in the arena. The names are interned, so they can be compared by pointer
+static void CategoryAdd(List *categories, Arena *arena, const char *category)
+{
+    const HashKey *interned = Intern(category);
+    Node *node = ArenaAlloc(arena, sizeof(*node));
+    if (interned == NULL || node == NULL)
+        return;
+
+    node->data = (char*)interned->str;
+    node->next = categories->head;
+    categories->head = node;
+    categories->size++;
 }
 
 static void CategoryPrint(void *ptr)
@@ -170,102 +183,155 @@ static int ExecCmp(const void *a, const void *b)
     return strcmp(entry_a->exec, exec);
 }
 
-static int NameCmp(const void *a, const void *b)
+static inline int NameCmp(XDGDesktopEntry *const *a, XDGDesktopEntry *const *b)
 {
-    const XDGDesktopEntry *entry_a = a;
-    const XDGDesktopEntry *entry_b = b;
-    return strcasecmp(entry_a->name, entry_b->name);
+    return strcasecmp((*a)->name, (*b)->name);
 }
 
-static int NameCmp2(const void *a, const void *b)
+static inline int NameKeyCmp(XDGDesktopEntry *const *entry, const char *name)
 {
-    const XDGDesktopEntry *entry_a = a;
-    const char *name = b;
-    return strcasecmp(entry_a->name, name);
+    return strcasecmp((*entry)->name, name);
 }
 
-void EntriesPrint(BTreeNode *entries)
-{
-    BSTInOrderTraverse(entries, EntryPrint, NULL);
-}
+VEC_DEFINE_SORTED(EntryVec, XDGDesktopEntry*, const char*, NameCmp, NameKeyCmp)
 
-void EntryRemove(BTreeNode *entries, const char *key)
+EntryStore *EntriesCreate(void)
 {
-    BSTDestroyNode(entries, key, NameCmp2, DestroyEntry);
+    EntryStore *store = malloc(sizeof(*store));
+    EntryVecInit(&store->entries, 256);
+    ArenaInit(&store->arena, ENTRY_ARENA_CHUNK_SIZE);
+    store->loaded_size = 0;
+    return store;
 }
 
-static bool FoundExecExact(XDGDesktopEntry *entry, const char *exec)
+// Entries are appended while the directories get read, this puts them in name order.
+// The first entry with a name wins, like it did when they were inserted into a tree.
+// The duplicates stay in the arena until the store is destroyed.
+void EntriesSort(EntryStore *store)
 {
-    char exec_basename[128];
-    strlcpy(exec_basename, entry->exec, sizeof(exec_basename));
+    TRACE_SCOPE("sort entries");
 
-    return strcmp(basename(exec_basename), exec) == 0;
+    if (EntryVecSort(&store->entries) != 0)
+    {
+        fprintf(stderr, "Failed to sort the desktop entries\n");
+        return;
+    }
+
+    // The sort is stable, the first of a run of equal names is the one that stays
+    for (size_t i = 1; i < store->entries.size; i++)
+    {
+        if (NameCmp(&store->entries.data[i - 1], &store->entries.data[i]) == 0)
+            store->entries.data[i - 1]->shadows = true;
+    }
+
+    EntryVecDedupe(&store->entries, NULL);
+    store->loaded_size = store->arena.used;
 }
 
-static bool FoundExecNaive(XDGDesktopEntry *entry, const char *exec)
+void EntriesForEach(EntryStore *store, void (*Func)(void*, void*), void *args)
 {
-    char exec_basename[128];
-    strlcpy(exec_basename, entry->exec, sizeof(exec_basename));
-
-    return strstr(basename(exec_basename), exec) != NULL;
+    for (size_t i = 0; i < store->entries.size; i++)
+    {
+        Func(store->entries.data[i], args);
+    }
 }
 
-XDGDesktopEntry *EntriesSearch(BTreeNode *entries, const char *key)
+void EntriesPrint(EntryStore *store)
 {
-    BTreeNode *node = BSTSearchNode(entries, key, NameCmp2);
-    return node != NULL ? node->data : NULL;
+    EntriesForEach(store, EntryPrint, NULL);
 }
 
-void EntriesDestroy(BTreeNode *entries)
+void EntryRemove(EntryStore *store, const char *key)
 {
-    BSTDestroy(&entries, DestroyEntry);
+    XDGDesktopEntry **entry = EntryVecFind(&store->entries, key);
+    if (entry == NULL)
+        return;
+
+    EntryVecRemove(&store->entries, entry - store->entries.data);
 }
 
-static XDGDesktopEntry *InorderTraverseProgramSearch(BTreeNode *node, XDGAdditionalCategories extra_category, const char *name, XDGDesktopEntry **fallback)
+// Like EntriesSort, the entry that was there first wins
+int EntryInsert(EntryStore *store, XDGDesktopEntry *entry)
 {
-    if (node == NULL)
-    {
-        return NULL;
-    }
+    if (EntryVecFind(&store->entries, entry->name) != NULL)
+        return 1;
 
-    XDGDesktopEntry *result = InorderTraverseProgramSearch(node->left, extra_category, name, fallback);
-    if (result != NULL)
-    {
-        return result;
-    }
+    return EntryVecInsert(&store->entries, entry);
+}
 
-    XDGDesktopEntry *entry = node->data;
-    if (entry->extra_category == extra_category)
+// The entry stays in the arena until the store is destroyed, NULL when no entry came from path
+XDGDesktopEntry *EntryRemovePath(EntryStore *store, const char *path)
+{
+    for (size_t i = 0; i < store->entries.size; i++)
     {
-        if (FoundExecExact(entry, name))
+        XDGDesktopEntry *entry = store->entries.data[i];
+        if (strcmp(entry->path, path) == 0)
         {
+            EntryVecRemove(&store->entries, i);
             return entry;
         }
+    }
 
-        if (FoundExecNaive(entry, name))
-        {
-            return entry;
-        }
+    return NULL;
+}
 
-        DEBUG_LOG("Setting %s as an fallback since %s does not match %s\n", entry->exec, entry->exec, name);
-        *fallback = entry;
-    }
+// exec has to be interned
+static bool FoundExecExact(XDGDesktopEntry *entry, const char *exec)
+{
+    return entry->exec_name == exec;
+}
 
-    return InorderTraverseProgramSearch(node->right, extra_category, name, fallback);
+static bool FoundExecNaive(XDGDesktopEntry *entry, const char *exec)
+{
+    return strstr(entry->exec_name, exec) != NULL;
+}
+
+XDGDesktopEntry *EntriesSearch(EntryStore *store, const char *key)
+{
+    XDGDesktopEntry **entry = EntryVecFind(&store->entries, key);
+    return entry != NULL ? *entry : NULL;
+}
+
+// One free per arena chunk instead of one per string
+void EntriesDestroy(EntryStore *store)
+{
+    EntryVecDestroy(&store->entries);
+    ArenaDestroy(&store->arena);
+    free(store);
 }
 
-XDGDesktopEntry *GetCoreProgram(BTreeNode *root, XDGAdditionalCategories extra_category, const char *name)
+XDGDesktopEntry *GetCoreProgram(EntryStore *store, XDGAdditionalCategories extra_category, const char *name)
 {
     XDGDesktopEntry *fallback = NULL;
+    XDGDesktopEntry *result = NULL;
+    const HashKey *interned = Intern(name);
+    if (interned == NULL)
+        return NULL;
 
-    XDGDesktopEntry *result = InorderTraverseProgramSearch(root, extra_category, name, &fallback);
+    const char *exec_name = interned->str;
+
+    for (size_t i = 0; i < store->entries.size; i++)
+    {
+        XDGDesktopEntry *entry = store->entries.data[i];
+        if (entry->extra_category != extra_category)
+            continue;
+
+        if (FoundExecExact(entry, exec_name) || FoundExecNaive(entry, name))
+        {
+            result = entry;
+            break;
+        }
+
+        DEBUG_LOG("Setting %s as an fallback since %s does not match %s\n", entry->exec, entry->exec, name);
+        fallback = entry;
+    }
     
     if (result == NULL)
     {
         if (fallback == NULL)
         {
-            printf("Couldn't find %s, And no fallback available! Quitting program...\n", name);
-            exit(1);
+            printf("Couldn't find %s, And no fallback available!\n", name);
+            return NULL;
         }
 
         printf("Couldn't find %s. Using %s as a fallback\n", name, fallback->exec);
@@ -274,54 +340,55 @@ XDGDesktopEntry *GetCoreProgram(BTreeNode *root, XDGAdditionalCategories extra_c
     return result ? result : fallback;
 }
 
-// DRY principle violated here, should find a better way of searching programs
-static XDGDesktopEntry *InorderTraverseProgramSearch2(BTreeNode *node, const char *name)
+XDGDesktopEntry *GetProgram(EntryStore *store, const char *name)
 {
-    if (node == NULL)
-    {
+    const HashKey *interned = Intern(name);
+    if (interned == NULL)
         return NULL;
-    }
 
-    XDGDesktopEntry *result = InorderTraverseProgramSearch2(node->left, name);
-    if (result != NULL)
-    {
-        return result;
-    }
+    const char *exec_name = interned->str;
 
-    XDGDesktopEntry *entry = node->data;
-
-    if (FoundExecExact(entry, name))
+    for (size_t i = 0; i < store->entries.size; i++)
     {
-        return entry;
+        if (FoundExecExact(store->entries.data[i], exec_name))
+            return store->entries.data[i];
     }
 
-    return InorderTraverseProgramSearch2(node->right, name);
+    printf("Couldn't find program %s!\n", name);
+    return NULL;
 }
 
-XDGDesktopEntry *GetProgram(BTreeNode *root, const char *name)
+// The program name is interned once here instead of being cut out of exec on every search
+static bool SetExec(XDGDesktopEntry *entry, Arena *arena, const char *exec)
 {
-    XDGDesktopEntry *result = InorderTraverseProgramSearch2(root, name);
-    
-    if (result == NULL)
-    {
-        printf("Couldn't find program %s!\n", name);
-    }
+    char exec_basename[128];
+    strlcpy(exec_basename, exec, sizeof(exec_basename));
+
+    const HashKey *interned = Intern(basename(exec_basename));
+    if (interned == NULL)
+        return false;
 
-    return result ? result : NULL;
+    entry->exec = ArenaStrdup(arena, exec);
+    entry->exec_name = interned->str;
+    return entry->exec != NULL;
 }
 
-static void ParseExec(XDGDesktopEntry *entry, const char *exec)
+// False if exec is too long to parse, cutting it would leave a different command, or out of memory
+static bool ParseExec(XDGDesktopEntry *entry, Arena *arena, const char *exec)
 {
     char final[1024] = {"\0"};
 
     char *save_ptr;
-    char *str_copy = strdup(exec);
+    char str_copy[1024];
+    if (strlcpy(str_copy, exec, sizeof(str_copy)) >= sizeof(str_copy))
+    {
+        fprintf(stderr, "Exec too long, skipping it: %s\n", exec);
+        return false;
+    }
 
     if (entry->try_exec != NULL && strchr(str_copy, '%') != NULL)
     {
-        entry->exec = strdup(entry->try_exec);
-        free(str_copy);
-        return;
+        return SetExec(entry, arena, entry->try_exec);
     }
 
     char *token = strtok_r(str_copy, " ", &save_ptr);
@@ -364,11 +431,10 @@ static void ParseExec(XDGDesktopEntry *entry, const char *exec)
     }
 
     StripTrailingWSpace(final);
-    entry->exec = strdup(final);
-    free(str_copy);
+    return SetExec(entry, arena, final);
 }
 
-static void ParseCategories(XDGDesktopEntry *entry, char *categories, XDGMainCategories *main_category)
+static void ParseCategories(XDGDesktopEntry *entry, Arena *arena, char *categories, XDGMainCategories *main_category)
 {
     DEBUG_LOG("Listed categories: %s\n", categories);
     *main_category = Invalid;
@@ -383,7 +449,7 @@ static void ParseCategories(XDGDesktopEntry *entry, char *categories, XDGMainCat
         if (main != Invalid)
         {
             *main_category = main; 
-            ListAdd(entry->categories, token, strlen(token) + 1);
+            CategoryAdd(entry->categories, arena, token);
             //DArrayAdd(entry->categories, strdup(token));
             /*
             if (entry->category_name == NULL)
@@ -396,15 +462,19 @@ static void ParseCategories(XDGDesktopEntry *entry, char *categories, XDGMainCat
 
         if (extra != IgnoredOrInvalid && entry->extra_category_name == NULL)
         {
-            entry->extra_category_name = strdup(token);
-            entry->extra_category = extra;
+            const HashKey *interned = Intern(token);
+            if (interned != NULL)
+            {
+                entry->extra_category_name = interned->str;
+                entry->extra_category = extra;
+            }
         }
 
         token = strtok_r(NULL, ";", &reserved);
     }
 }
 
-static void ParseDesktopEntry(XDGDesktopEntry *entry, int key_type, char *key, char *value, ParsedInfo *info)
+static void ParseDesktopEntry(XDGDesktopEntry *entry, Arena *arena, int key_type, char *key, char *value, ParsedInfo *info)
 {
     switch (key_type)
     {
@@ -427,7 +497,7 @@ static void ParseDesktopEntry(XDGDesktopEntry *entry, int key_type, char *key, c
             {
                 printf("Name already set! %s -> %s\n", entry->name, value);
             }
-            entry->name = strdup(value);
+            entry->name = ArenaStrdup(arena, value);
             break;
         }
 
@@ -450,7 +520,7 @@ static void ParseDesktopEntry(XDGDesktopEntry *entry, int key_type, char *key, c
                 printf("Icon already set! %s -> %s\n", entry->icon, value);
             }
             info->icon_exists = true;
-            entry->icon = strdup(value);
+            entry->icon = ArenaStrdup(arena, value);
             break;
         }
         case Hidden:
@@ -461,14 +531,13 @@ static void ParseDesktopEntry(XDGDesktopEntry *entry, int key_type, char *key, c
         case TryExec:
         {
             DEBUG_LOG("Found TryExec: %s\n", value);
-            entry->try_exec = strdup(value);
+            entry->try_exec = ArenaStrdup(arena, value);
             break;
         }
         case Exec:
         {
             DEBUG_LOG("Found Exec: %s\n", value);
-            ParseExec(entry, value);
-            info->has_exec = true;
+            info->has_exec = ParseExec(entry, arena, value);
             break;
         }
         case Path:
@@ -488,7 +557,7 @@ static void ParseDesktopEntry(XDGDesktopEntry *entry, int key_type, char *key, c
         }
         case Categories:
         {
-            ParseCategories(entry, value, &info->main_category);
+            ParseCategories(entry, arena, value, &info->main_category);
             break;
         }
         case Keywords:
@@ -504,7 +573,8 @@ static void ParseDesktopEntry(XDGDesktopEntry *entry, int key_type, char *key, c
     }
 }
 
-static XDGDesktopEntry *ReadDesktopEntry(const char *path)
+// The entry is allocated from arena, a rejected one stays there too until the arena is destroyed
+XDGDesktopEntry *ReadDesktopEntry(const char *path, Arena *arena)
 {
     FILE *fp = fopen(path, "r");
 
@@ -520,7 +590,14 @@ static XDGDesktopEntry *ReadDesktopEntry(const char *path)
 
     ParsedInfo info = { false };
 
-    XDGDesktopEntry *entry = CreateEmptyEntry();
+    XDGDesktopEntry *entry = CreateEmptyEntry(arena);
+    if (entry == NULL)
+    {
+        fprintf(stderr, "Out of memory reading '%s'\n", path);
+        fclose(fp);
+        return NULL;
+    }
+
     bool is_desktop_entry = false;
     // Read line by line
     while ((read = getline(&line, &len, fp)) != -1)
@@ -559,7 +636,7 @@ static XDGDesktopEntry *ReadDesktopEntry(const char *path)
             {
                 if (strcmp(key, xdg_keys[i].key) == 0)
                 {
-                    ParseDesktopEntry(entry, i, key, value, &info);
+                    ParseDesktopEntry(entry, arena, i, key, value, &info);
                     break;
                 }
             }
@@ -575,15 +652,19 @@ static XDGDesktopEntry *ReadDesktopEntry(const char *path)
         // Kinda hacky, should be redone using the full xdg menu spec in the future
         //xdg_main_category_tracker[info.main_category]++;
 
+        entry->path = ArenaStrdup(arena, path);
         return entry;
     }
 
-    DestroyEntry(entry);
     return NULL;
 }
 
-int LoadDesktopEntries(BTreeNode **entries, const char *path)
+// Func, if not NULL, gets called with every entry added while the directory is still being read.
+// The entries are only in order after EntriesSort.
+int LoadDesktopEntries(EntryStore *store, const char *path, void (*Func)(void*, void*), void *args)
 {
+    TRACE_SCOPE_FMT("scan %s", path);
+
     char buffer[512];
 
     DIR *dentry_dir = opendir(path);
@@ -604,13 +685,18 @@ int LoadDesktopEntries(BTreeNode **entries, const char *path)
             strlcat(buffer, dirp->d_name, sizeof(buffer));
 
             DEBUG_LOG("\nReading %s\n", buffer);
-            XDGDesktopEntry *entry = ReadDesktopEntry(buffer);
+            XDGDesktopEntry *entry = ReadDesktopEntry(buffer, &store->arena);
 
             if (entry != NULL)
             {
-                *entries = BSTInsertNode(*entries, entry, NameCmp);
+                if (EntryVecPush(&store->entries, entry) != 0)
+                    continue;
                 count++;
-                DEBUG_LOG("Adding entry \"%s\" from %s to the tree\n", entry->name, buffer);
+
+                if (Func != NULL)
+                    Func(entry, args);
+
+                DEBUG_LOG("Adding entry \"%s\" from %s\n", entry->name, buffer);
             }
             else
             {
@@ -75,23 +75,50 @@ typedef struct
     //XDGMainCategories category;
     XDGAdditionalCategories extra_category;
     //char *category_name;
-    char *extra_category_name;
+    // Interned, like the categories
+    const char *extra_category_name;
     char *name;
     char *exec;
+    // Interned file name of the program
+    const char *exec_name;
     char *try_exec;
     char *icon;
     bool terminal_required;
+    // The desktop file it was read from
+    char *path;
+    // Won over entries of the same name from other files, one of them takes its place once it is gone
+    bool shadows;
 } XDGDesktopEntry;
 
-extern XDGDesktopEntry *g_terminal;
+VEC_DEFINE(EntryVec, XDGDesktopEntry*)
 
-void EntriesPrint(BTreeNode *entries);
-void EntryRemove(BTreeNode *entries, const char *key);
-void EntriesDestroy(BTreeNode *entries);
-XDGDesktopEntry *EntriesSearch(BTreeNode *entries, const char *key);
-XDGDesktopEntry *GetCoreProgram(BTreeNode *entries, XDGAdditionalCategories extra_category, const char *name);
-XDGDesktopEntry *GetProgram(BTreeNode *root, const char *name);
-int LoadDesktopEntries(BTreeNode **entries, const char *path);
+typedef struct
+{
+    // Sorted by name once EntriesSort was called
+    EntryVec entries;
+    // The entries and everything they point to, freed all at once
+    Arena arena;
+    // Arena bytes once the entries were loaded. Updates only add to the arena, whatever they removed,
+    // replaced or rejected stays in it
+    size_t loaded_size;
+} EntryStore;
+
+EntryStore *EntriesCreate(void);
+void EntriesSort(EntryStore *entries);
+void EntriesForEach(EntryStore *entries, void (*Func)(void*, void*), void *args);
+void EntriesPrint(EntryStore *entries);
+void EntryRemove(EntryStore *entries, const char *key);
+// Puts an entry read after EntriesSort in its place, 1 if an entry with that name is already there
+int EntryInsert(EntryStore *entries, XDGDesktopEntry *entry);
+// Removes the entry read from path, false if there was none
+XDGDesktopEntry *EntryRemovePath(EntryStore *entries, const char *path);
+void EntriesDestroy(EntryStore *entries);
+XDGDesktopEntry *EntriesSearch(EntryStore *entries, const char *key);
+XDGDesktopEntry *GetCoreProgram(EntryStore *entries, XDGAdditionalCategories extra_category, const char *name);
+XDGDesktopEntry *GetProgram(EntryStore *entries, const char *name);
+int LoadDesktopEntries(EntryStore *entries, const char *path, void (*Func)(void*, void*), void *args);
+// Returns NULL if the entry should not be shown in the menu
+XDGDesktopEntry *ReadDesktopEntry(const char *path, Arena *arena);
 
 
 #endif
@@ -0,0 +1,190 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/syslog.h>
+#include <sys/timerfd.h>
+#include <sys/inotify.h>
+
+#include <bsd/string.h>
+
+#include "event_loop.h"
+
+#define MAX_EVENTS 16
+
+int EventLoopInit(EventLoop *loop)
+{
+    loop->running = false;
+    loop->removed = NULL;
+    loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+
+    if (loop->epoll < 0)
+    {
+        syslog(LOG_ERR, "JWMS: Failed to create the event loop: %s", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+EventSource *EventLoopAdd(EventLoop *loop, int fd, EventCallback callback, void *data)
+{
+    EventSource *source = malloc(sizeof(EventSource));
+    if (source == NULL)
+        return NULL;
+
+    source->fd = fd;
+    source->callback = callback;
+    source->data = data;
+    source->next_removed = NULL;
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = source };
+    if (epoll_ctl(loop->epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        syslog(LOG_ERR, "JWMS: Failed to watch descriptor %d: %s", fd, strerror(errno));
+        free(source);
+        return NULL;
+    }
+
+    return source;
+}
+
+void EventLoopRemove(EventLoop *loop, EventSource *source)
+{
+    if (source == NULL)
+        return;
+
+    epoll_ctl(loop->epoll, EPOLL_CTL_DEL, source->fd, NULL);
+
+    // Events for it may still be waiting in the current batch
+    source->callback = NULL;
+    source->next_removed = loop->removed;
+    loop->removed = source;
+}
+
+static void FreeRemoved(EventLoop *loop)
+{
+    while (loop->removed != NULL)
+    {
+        EventSource *next = loop->removed->next_removed;
+        free(loop->removed);
+        loop->removed = next;
+    }
+}
+
+int EventLoopRun(EventLoop *loop)
+{
+    struct epoll_event events[MAX_EVENTS];
+
+    loop->running = true;
+
+    while (loop->running)
+    {
+        int n = epoll_wait(loop->epoll, events, MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            syslog(LOG_ERR, "JWMS: Failed to wait for events: %s", strerror(errno));
+            return -1;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            EventSource *source = events[i].data.ptr;
+            if (source->callback != NULL)
+                source->callback(events[i].events, source->data);
+        }
+
+        FreeRemoved(loop);
+    }
+
+    return 0;
+}
+
+void EventLoopStop(EventLoop *loop)
+{
+    loop->running = false;
+}
+
+void EventLoopDestroy(EventLoop *loop)
+{
+    FreeRemoved(loop);
+
+    if (loop->epoll >= 0)
+        close(loop->epoll);
+
+    loop->epoll = -1;
+}
+
+long long NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int TimerCreate(void)
+{
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer < 0)
+        syslog(LOG_ERR, "JWMS: Failed to create a timer: %s", strerror(errno));
+
+    return timer;
+}
+
+void TimerSetDeadline(int timer, long long deadline_ms)
+{
+    struct itimerspec spec = { 0 };
+
+    // A zero it_value disarms, a deadline that already passed still has to fire
+    if (deadline_ms >= 0)
+    {
+        spec.it_value.tv_sec = deadline_ms / 1000;
+        spec.it_value.tv_nsec = (deadline_ms % 1000) * 1000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+            spec.it_value.tv_nsec = 1;
+    }
+
+    timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+void TimerClear(int timer)
+{
+    uint64_t expirations;
+    while (read(timer, &expirations, sizeof(expirations)) < 0 && errno == EINTR);
+}
+
+void WatchClosestDir(int inotify, const char *path, uint32_t mask)
+{
+    char dir[PATH_MAX];
+
+    if (strlcpy(dir, path, sizeof(dir)) >= sizeof(dir))
+        return;
+
+    // Directories can be given with a trailing slash
+    size_t len = strlen(dir);
+    if (len > 1 && dir[len - 1] == '/')
+        dir[len - 1] = '\0';
+
+    for (;;)
+    {
+        char *slash = strrchr(dir, '/');
+        if (slash == NULL)
+            return;
+
+        bool top = slash == dir;
+        slash[top ? 1 : 0] = '\0';
+
+        if (inotify_add_watch(inotify, dir, mask) >= 0 || top)
+            return;
+    }
+}
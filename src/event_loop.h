@@ -0,0 +1,47 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+// epoll with one callback per descriptor, everything jwms waits for goes through here.
+// Timeouts are timerfds added like any other descriptor, so the loop itself never wakes up on its own.
+// Sources removed while a batch of events is handled are only freed after it, a callback can remove
+// any source, its own included.
+
+typedef void (*EventCallback)(uint32_t events, void *data);
+
+typedef struct EventSource
+{
+    int fd;
+    EventCallback callback;
+    void *data;
+    struct EventSource *next_removed;
+} EventSource;
+
+typedef struct
+{
+    int epoll;
+    bool running;
+    EventSource *removed;
+} EventLoop;
+
+int EventLoopInit(EventLoop *loop);
+EventSource *EventLoopAdd(EventLoop *loop, int fd, EventCallback callback, void *data);
+void EventLoopRemove(EventLoop *loop, EventSource *source);
+// Returns after EventLoopStop or when epoll fails
+int EventLoopRun(EventLoop *loop);
+void EventLoopStop(EventLoop *loop);
+void EventLoopDestroy(EventLoop *loop);
+
+// CLOCK_MONOTONIC in milliseconds, the clock every deadline in jwms is given in
+long long NowMs(void);
+// A non-blocking CLOCK_MONOTONIC timerfd
+int TimerCreate(void);
+// Arms a timerfd to an absolute deadline, -1 disarms it
+void TimerSetDeadline(int timer, long long deadline_ms);
+// Reads the expirations off a timerfd that fired, it stays readable otherwise
+void TimerClear(int timer);
+
+// Adds an inotify watch with mask on the closest directory above path that exists, so the missing ones
+// being created show up there
+void WatchClosestDir(int inotify, const char *path, uint32_t mask);
+
+#endif
@@ -0,0 +1,205 @@
+// statx() is only exposed with _GNU_SOURCE
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "darray.h"
+#include "fingerprint.h"
+
+static void FingerprintEntryDestroy(void *ptr)
+{
+    FingerprintEntry *entry = ptr;
+    free(entry->path);
+    free(entry);
+}
+
+// Only the mtime and size are requested, so the kernel can skip filling in everything else
+static void StatPath(const char *path, long long *mtime_sec, long *mtime_nsec, long long *size)
+{
+    struct statx stx;
+
+    if (statx(AT_FDCWD, path, AT_NO_AUTOMOUNT, STATX_MTIME | STATX_SIZE, &stx) != 0)
+    {
+        *mtime_sec = 0;
+        *mtime_nsec = 0;
+        *size = -1;
+        return;
+    }
+
+    *mtime_sec = stx.stx_mtime.tv_sec;
+    *mtime_nsec = stx.stx_mtime.tv_nsec;
+    *size = stx.stx_size;
+}
+
+Fingerprint *FingerprintCreate(void)
+{
+    Fingerprint *fingerprint = malloc(sizeof(*fingerprint));
+    if (fingerprint == NULL)
+        return NULL;
+
+    fingerprint->entries = DArrayCreate(64, FingerprintEntryDestroy, NULL, NULL);
+    fingerprint->incomplete = fingerprint->entries == NULL;
+    return fingerprint;
+}
+
+void FingerprintAddPath(Fingerprint *fingerprint, const char *path)
+{
+    if (fingerprint == NULL || fingerprint->incomplete)
+        return;
+
+    FingerprintEntry *entry = malloc(sizeof(*entry));
+    char *entry_path = strdup(path);
+    if (entry == NULL || entry_path == NULL)
+    {
+        free(entry);
+        free(entry_path);
+        fingerprint->incomplete = true;
+        return;
+    }
+
+    entry->path = entry_path;
+    StatPath(path, &entry->mtime_sec, &entry->mtime_nsec, &entry->size);
+
+    DArrayAdd(fingerprint->entries, entry);
+}
+
+// Written next to path and renamed over it, an interrupted write leaves no fingerprint that could match.
+// The last line has the number of entries, so a file that got cut off anyway doesn't match either.
+int FingerprintWrite(Fingerprint *fingerprint, const char *path, const char *version)
+{
+    if (fingerprint == NULL || fingerprint->incomplete)
+        return -1;
+
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *fp = fopen(tmp_path, "w");
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening '%s': %s\n", tmp_path, strerror(errno));
+        return -1;
+    }
+
+    fprintf(fp, "jwm-helper %s\n", version);
+
+    for (size_t i = 0; i < fingerprint->entries->size; i++)
+    {
+        FingerprintEntry *entry = fingerprint->entries->data[i];
+        fprintf(fp, "%lld %ld %lld %s\n", entry->mtime_sec, entry->mtime_nsec, entry->size, entry->path);
+    }
+
+    fprintf(fp, "end %zu\n", fingerprint->entries->size);
+
+    bool failed = ferror(fp) != 0;
+    if (fclose(fp) != 0)
+        failed = true;
+
+    if (failed || rename(tmp_path, path) != 0)
+    {
+        fprintf(stderr, "Error writing '%s'\n", path);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Re-stats every path recorded by the last successful run.
+// Any difference, including a file that appeared or disappeared, counts as a change.
+bool FingerprintMatches(const char *path, const char *version)
+{
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL)
+        return false;
+
+    char expected_header[1024];
+    snprintf(expected_header, sizeof(expected_header), "jwm-helper %s\n", version);
+
+    int read = 0;
+    size_t len = 0;
+    char *line = NULL;
+    bool matches = false;
+    size_t count = 0;
+    size_t total;
+
+    if (getline(&line, &len, fp) == -1 || strcmp(line, expected_header) != 0)
+        goto done;
+
+    while ((read = getline(&line, &len, fp)) != -1)
+    {
+        long long mtime_sec;
+        long mtime_nsec;
+        long long size;
+        int path_offset = 0;
+
+        line[strcspn(line, "\n")] = '\0';
+
+        // Nothing may follow the count, and every entry before it has to be there
+        if (sscanf(line, "end %zu", &total) == 1)
+        {
+            matches = count > 0 && count == total && getline(&line, &len, fp) == -1;
+            goto done;
+        }
+
+        if (sscanf(line, "%lld %ld %lld %n", &mtime_sec, &mtime_nsec, &size, &path_offset) != 3 || path_offset == 0)
+            goto done;
+
+        long long curr_mtime_sec;
+        long curr_mtime_nsec;
+        long long curr_size;
+        StatPath(line + path_offset, &curr_mtime_sec, &curr_mtime_nsec, &curr_size);
+
+        if (curr_mtime_sec != mtime_sec || curr_mtime_nsec != mtime_nsec || curr_size != size)
+            goto done;
+
+        count++;
+    }
+
+done:
+    free(line);
+    fclose(fp);
+    return matches;
+}
+
+// Same as FingerprintMatches for a fingerprint that was never written out
+bool FingerprintUnchanged(Fingerprint *fingerprint)
+{
+    if (fingerprint == NULL || fingerprint->incomplete)
+        return false;
+
+    for (size_t i = 0; i < fingerprint->entries->size; i++)
+    {
+        FingerprintEntry *entry = fingerprint->entries->data[i];
+
+        long long mtime_sec;
+        long mtime_nsec;
+        long long size;
+        StatPath(entry->path, &mtime_sec, &mtime_nsec, &size);
+
+        if (mtime_sec != entry->mtime_sec || mtime_nsec != entry->mtime_nsec || size != entry->size)
+            return false;
+    }
+
+    return true;
+}
+
+void FingerprintDestroy(Fingerprint *fingerprint)
+{
+    if (fingerprint == NULL)
+        return;
+
+    if (fingerprint->entries != NULL)
+        DArrayDestroy(fingerprint->entries);
+    free(fingerprint);
+}
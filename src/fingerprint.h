@@ -0,0 +1,34 @@
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <stdbool.h>
+
+#include "darray.h"
+
+// Snapshot of a single input or output file of jwm-helper
+typedef struct
+{
+    char *path;
+    long long mtime_sec;
+    long mtime_nsec;
+    // -1 if the path did not exist when the snapshot was taken
+    long long size;
+} FingerprintEntry;
+
+typedef struct
+{
+    DArray *entries;
+    // A path couldn't be added, so it can't vouch for anything
+    bool incomplete;
+} Fingerprint;
+
+// NULL from FingerprintCreate works like an incomplete fingerprint with every function below
+
+Fingerprint *FingerprintCreate(void);
+void FingerprintAddPath(Fingerprint *fingerprint, const char *path);
+int FingerprintWrite(Fingerprint *fingerprint, const char *path, const char *version);
+bool FingerprintMatches(const char *path, const char *version);
+bool FingerprintUnchanged(Fingerprint *fingerprint);
+void FingerprintDestroy(Fingerprint *fingerprint);
+
+#endif
@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <errno.h>
 #include <sys/stat.h>
 
@@ -10,15 +12,51 @@
 #include <confuse.h>
 
 #include "common.h"
-#include "bstree.h"
+#include "containers.h"
 #include "list.h"
+#include "arena.h"
 #include "hashing.h"
 #include "darray.h"
-#include "icons.h"
 #include "desktop_entries.h"
+#include "icons.h"
 #include "config.h"
 
-static void WriteAutostartProgram(FILE *fp, int sleep_time, bool kill, bool fork, const char *program, const char *args)
+// The nice, ionice, taskset and chrt commands the program runs under, ending in a space when there are any
+static void GetSchedulingWrappers(const AutostartScheduling *scheduling, char *wrappers, size_t size)
+{
+    char wrapper[64];
+    wrappers[0] = '\0';
+
+    if (scheduling->nice != 0)
+    {
+        snprintf(wrapper, sizeof(wrapper), "nice -n %d ", scheduling->nice);
+        strlcat(wrappers, wrapper, size);
+    }
+
+    if (scheduling->io_class == AUTOSTART_IO_IDLE)
+    {
+        strlcat(wrappers, "ionice -c 3 ", size);
+    }
+    else if (scheduling->io_class == AUTOSTART_IO_BEST_EFFORT)
+    {
+        snprintf(wrapper, sizeof(wrapper), "ionice -c 2 -n %d ", scheduling->io_level);
+        strlcat(wrappers, wrapper, size);
+    }
+
+    // ParseCPUList only lets digits, dashes and commas through, quoted all the same
+    if (scheduling->cpu_affinity != NULL)
+    {
+        strlcat(wrappers, "taskset -c '", size);
+        strlcat(wrappers, scheduling->cpu_affinity, size);
+        strlcat(wrappers, "' ", size);
+    }
+
+    if (scheduling->sched_idle)
+        strlcat(wrappers, "chrt -i 0 ", size);
+}
+
+static void WriteAutostartProgram(FILE *fp, int sleep_time, bool kill, bool fork, const char *wrappers,
+                                  const char *program, const char *args)
 {
     DEBUG_LOG("program: %s\n", program);
     if (kill)
@@ -28,38 +66,38 @@ static void WriteAutostartProgram(FILE *fp, int sleep_time, bool kill, bool fork
     {
         if (fork && sleep_time > 0)
         {
-            WRITE_CFG("sleep %d && %s %s &\n", sleep_time, program, args);
+            WRITE_CFG("sleep %d && %s%s %s &\n", sleep_time, wrappers, program, args);
         }
         else if (sleep_time > 0)
         {
-            WRITE_CFG("sleep %d && %s %s\n", sleep_time, program, args);
+            WRITE_CFG("sleep %d && %s%s %s\n", sleep_time, wrappers, program, args);
         }
         else if (fork)
         {
-            WRITE_CFG("%s %s &\n", program, args);
+            WRITE_CFG("%s%s %s &\n", wrappers, program, args);
         }
         else
         {
-            WRITE_CFG("%s %s\n", program, args);
+            WRITE_CFG("%s%s %s\n", wrappers, program, args);
         }
     }
     else
     {
         if (fork && sleep_time > 0)
         {
-            WRITE_CFG("sleep %d && %s &\n", sleep_time, program);
+            WRITE_CFG("sleep %d && %s%s &\n", sleep_time, wrappers, program);
         }
         else if (sleep_time > 0)
         {
-            WRITE_CFG("sleep %d && %s\n", sleep_time, program);
+            WRITE_CFG("sleep %d && %s%s\n", sleep_time, wrappers, program);
         }
         else if (fork)
         {
-            WRITE_CFG("%s &\n", program);
+            WRITE_CFG("%s%s &\n", wrappers, program);
         }
         else
         {
-            WRITE_CFG("%s\n", program);
+            WRITE_CFG("%s%s\n", wrappers, program);
         }
     }
 }
@@ -74,7 +112,7 @@ int CreateJWMAutoStart(JWM *jwm, cfg_t *cfg)
 
     printf("Generating autostart script!\n");
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -106,15 +144,20 @@ int CreateJWMAutoStart(JWM *jwm, cfg_t *cfg)
         if (program == NULL)
         {
             printf("Program name was NULL for autostart %s !\n", title);
-            fclose(fp);
+            OutputAbort(fp, path);
             return -1;
         }
         
-        WriteAutostartProgram(fp, sleep_time, kill, fork, program, args);
+        AutostartScheduling scheduling;
+        ReadAutostartScheduling(autostart, &scheduling);
+
+        char wrappers[256];
+        GetSchedulingWrappers(&scheduling, wrappers, sizeof(wrappers));
+
+        WriteAutostartProgram(fp, sleep_time, kill, fork, wrappers, program, args);
 	}
 
-    chmod(path, 0755);
+    fchmod(fileno(fp), 0755);
 
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
@@ -2,18 +2,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <errno.h>
 
 #include <bsd/string.h>
 #include <confuse.h>
 
 #include "common.h"
-#include "bstree.h"
+#include "containers.h"
 #include "list.h"
+#include "arena.h"
 #include "hashing.h"
 #include "darray.h"
-#include "icons.h"
 #include "desktop_entries.h"
+#include "icons.h"
 #include "config.h"
 
 static const struct
@@ -52,7 +54,7 @@ int CreateJWMBinds(JWM *jwm, cfg_t *cfg)
 
     printf("Generating JWM bindings!\n");
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -101,7 +103,7 @@ int CreateJWMBinds(JWM *jwm, cfg_t *cfg)
 
             if (out_keymod == NULL)
             {
-                fclose(fp);
+                OutputAbort(fp, path);
                 return -1;
             }
 
@@ -123,6 +125,5 @@ int CreateJWMBinds(JWM *jwm, cfg_t *cfg)
 
     WRITE_CFG("</JWM>\n");
 
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
@@ -3,7 +3,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <errno.h>
+#include <limits.h>
 #include <sys/stat.h>
 
 #include <bsd/string.h>
@@ -11,23 +13,144 @@
 #include <unistd.h>
 
 #include "common.h"
-#include "bstree.h"
+#include "containers.h"
 #include "list.h"
+#include "arena.h"
 #include "hashing.h"
 #include "darray.h"
-#include "icons.h"
 #include "desktop_entries.h"
+#include "icons.h"
 #include "config.h"
 
+// Outputs are written to a temporary file next to the real one, which replaces it once complete.
+// A JWM that is already running never reads half a file, and files that come out the same are left alone,
+// so their inode tells whether a run changed them.
+// Symlinks are followed, so dotfile managers keep their links.
+static void GetOutputPaths(const char *path, char *target, char *tmp_path)
+{
+    if (realpath(path, target) == NULL)
+        strlcpy(target, path, PATH_MAX);
+
+    snprintf(tmp_path, PATH_MAX + 8, "%s.tmp", target);
+}
+
+FILE *OutputOpen(const char *path)
+{
+    char target[PATH_MAX];
+    char tmp_path[PATH_MAX + 8];
+    GetOutputPaths(path, target, tmp_path);
+
+    FILE *fp = fopen(tmp_path, "w");
+    if (fp == NULL)
+        return NULL;
+
+    // The replacement keeps the permissions of the file it replaces, a 0600 ~/.jwmrc stays private
+    struct stat st;
+    if (stat(target, &st) == 0)
+        fchmod(fileno(fp), st.st_mode & 07777);
+
+    return fp;
+}
+
+void OutputAbort(FILE *fp, const char *path)
+{
+    char target[PATH_MAX];
+    char tmp_path[PATH_MAX + 8];
+    GetOutputPaths(path, target, tmp_path);
+
+    fclose(fp);
+    unlink(tmp_path);
+}
+
+static bool FilesEqual(const char *path_a, const char *path_b)
+{
+    FILE *fp_a = fopen(path_a, "r");
+    if (fp_a == NULL)
+        return false;
+
+    FILE *fp_b = fopen(path_b, "r");
+    if (fp_b == NULL)
+    {
+        fclose(fp_a);
+        return false;
+    }
+
+    char buffer_a[BUFSIZ];
+    char buffer_b[BUFSIZ];
+    bool equal = true;
+
+    while (equal)
+    {
+        size_t read_a = fread(buffer_a, 1, sizeof(buffer_a), fp_a);
+        size_t read_b = fread(buffer_b, 1, sizeof(buffer_b), fp_b);
+
+        if (read_a != read_b || memcmp(buffer_a, buffer_b, read_a) != 0)
+            equal = false;
+
+        if (read_a < sizeof(buffer_a))
+            break;
+    }
+
+    fclose(fp_a);
+    fclose(fp_b);
+    return equal;
+}
+
+int OutputClose(FILE *fp, const char *path)
+{
+    char target[PATH_MAX];
+    char tmp_path[PATH_MAX + 8];
+    GetOutputPaths(path, target, tmp_path);
+
+    bool failed = ferror(fp) != 0;
+    if (fclose(fp) != 0)
+        failed = true;
+
+    if (failed)
+    {
+        fprintf(stderr, "Error writing to '%s'\n", tmp_path);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    if (FilesEqual(tmp_path, target))
+    {
+        unlink(tmp_path);
+        return 0;
+    }
+
+    if (rename(tmp_path, target) != 0)
+    {
+        fprintf(stderr, "Error replacing '%s': %s\n", target, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
 
-int CreateJWMFolder(JWM *jwm)
+// output_dir replaces both ~/.config/jwm/ and the home directory the .jwmrc goes to, pass NULL for the defaults
+int CreateJWMFolder(JWM *jwm, const char *output_dir)
 {
     char path[512];
+    char rc_path[512];
     const char *home = getenv("HOME");
     const char *dir = "/.config/jwm/";
 
-    strlcpy(path, home, sizeof(path));
-    strlcat(path, dir, sizeof(path));
+    if (output_dir != NULL)
+    {
+        strlcpy(path, output_dir, sizeof(path));
+        strlcat(path, "/", sizeof(path));
+        strlcpy(rc_path, path, sizeof(rc_path));
+    }
+    else
+    {
+        strlcpy(path, home, sizeof(path));
+        strlcat(path, dir, sizeof(path));
+        strlcpy(rc_path, home, sizeof(rc_path));
+        strlcat(rc_path, "/", sizeof(rc_path));
+    }
+    strlcat(rc_path, ".jwmrc", sizeof(rc_path));
 
     // Check if directory exists
     if (access(path, F_OK) != 0)
@@ -42,6 +165,7 @@ int CreateJWMFolder(JWM *jwm)
     }
 
     jwm->autogen_config_path = strdup(path);
+    jwm->jwmrc_path = strdup(rc_path);
 
     return 0;
 }
@@ -54,7 +178,7 @@ int CreateJWMStartup(JWM *jwm)
     strlcpy(path, jwm->autogen_config_path, sizeof(path));
     strlcat(path, fname, sizeof(path));
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -67,12 +191,12 @@ int CreateJWMStartup(JWM *jwm)
     // Start of the startup xml file
     WRITE_CFG("<?xml version=\"1.0\"?>\n");
     WRITE_CFG("<JWM>\n");
-    WRITE_CFG("   <StartupCommand>~/.config/jwm/autostart</StartupCommand>\n");
+    if (!jwm->global_native_autostart)
+        WRITE_CFG("   <StartupCommand>~/.config/jwm/autostart</StartupCommand>\n");
     //WRITE_CFG("   <RestartCommand>~/.config/jwm/autostart</RestartCommand>\n");
     WRITE_CFG("</JWM>\n");
 
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
 
 int CreateJWMIcons(JWM *jwm)
@@ -83,7 +207,7 @@ int CreateJWMIcons(JWM *jwm)
     strlcpy(path, jwm->autogen_config_path, sizeof(path));
     strlcat(path, fname, sizeof(path));
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -100,8 +224,7 @@ int CreateJWMIcons(JWM *jwm)
     WRITE_CFG("   <IconPath>/usr/share/pixmaps/</IconPath>\n");
     WRITE_CFG("</JWM>");
 
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
 
 int CreateJWMGroup(JWM *jwm)
@@ -114,7 +237,7 @@ int CreateJWMGroup(JWM *jwm)
 
     printf("Generating JWM groups!\n");
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -134,8 +257,7 @@ int CreateJWMGroup(JWM *jwm)
     WRITE_CFG("    </Group>\n");
     WRITE_CFG("</JWM>\n");
 
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
 
 int CreateJWMPreferences(JWM *jwm)
@@ -146,7 +268,7 @@ int CreateJWMPreferences(JWM *jwm)
     strlcpy(path, jwm->autogen_config_path, sizeof(path));
     strlcat(path, fname, sizeof(path));
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -177,8 +299,7 @@ int CreateJWMPreferences(JWM *jwm)
     WRITE_CFG("   <ResizeMode>%s</ResizeMode>\n", jwm->window_resize_mode);
     WRITE_CFG("</JWM>\n");
 
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
 
 // There will only be one backup of the .jwmrc file
@@ -230,22 +351,17 @@ int CreateJWMRCFile(JWM *jwm)
 {
     char path[512];
     char path_bak[512];
-    const char *home = getenv("HOME");
-    const char *fname = ".jwmrc";
-    const char *fnamebak = ".jwmrc.BAK";
 
-    strlcpy(path, home, sizeof(path));
-    strlcat(path, "/", sizeof(path));
+    strlcpy(path, jwm->jwmrc_path, sizeof(path));
     strlcpy(path_bak, path, sizeof(path_bak));
-    strlcat(path, fname, sizeof(path));
-    strlcat(path_bak, fnamebak, sizeof(path_bak));
+    strlcat(path_bak, ".BAK", sizeof(path_bak));
 
     if (CreateJWMRCBackup(path, path_bak) == 0)
     {
-        DEBUG_LOG("Succesfully created backup of %s in %s\n", fname, path_bak);
+        DEBUG_LOG("Succesfully created backup of %s in %s\n", path, path_bak);
     }
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -268,6 +384,5 @@ int CreateJWMRCFile(JWM *jwm)
     WRITE_CFG("    <Include>$HOME/.config/jwm/binds</Include>\n");
     WRITE_CFG("</JWM>\n");
 
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
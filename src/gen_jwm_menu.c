@@ -2,18 +2,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <errno.h>
 
 #include <bsd/string.h>
 #include <confuse.h>
 
 #include "common.h"
-#include "bstree.h"
+#include "containers.h"
 #include "list.h"
+#include "arena.h"
 #include "hashing.h"
+#include "intern.h"
 #include "darray.h"
-#include "icons.h"
 #include "desktop_entries.h"
+#include "icons.h"
 #include "config.h"
 
 static const char *category_icons[] =
@@ -61,7 +64,8 @@ static int CategoryCmp(const void *a, const void *b)
 
 typedef struct
 {
-    char *real_name;
+    // Interned before the entries are searched
+    const char *real_name;
     char *menu_name;
     int value;
 } MenuCategory;
@@ -71,13 +75,13 @@ typedef struct
     HashMap *icons;
     FILE *fp;
     MenuCategory *category;
+    XDGDesktopEntry *terminal;
 } CategoryArgs;
 
+// Both names are interned
 static int CategoryCmp(const void *a, const void *b)
 {
-    const char *name1 = a;
-    const char *name2 = b;
-    return strcmp(name1, name2) == 0;
+    return a == b;
 }
 
 static void WriteMenuCategory(void *entry_ptr, void *args_ptr)
@@ -103,12 +107,12 @@ static void WriteMenuCategory(void *entry_ptr, void *args_ptr)
         else
         {
             WRITE_CFG("            <Program icon=\"%s\" label=\"%s\">%s -e %s</Program>\n",
-                        icon, entry->name, g_terminal->exec, entry->exec);
+                        icon, entry->name, args->terminal->exec, entry->exec);
         }
     }
 }
 
-static void WriteJWMRootMenuCategoryList(BTreeNode *entries, HashMap *icons, FILE *fp, MenuCategory *category, bool use_symbolic)
+static void WriteJWMRootMenuCategoryList(EntryStore *entries, HashMap *icons, XDGDesktopEntry *terminal, FILE *fp, MenuCategory *category, bool use_symbolic)
 {
     const char *icon_name = use_symbolic ? category_icons_symbolic[category->value] : category_icons[category->value];
 
@@ -119,11 +123,12 @@ static void WriteJWMRootMenuCategoryList(BTreeNode *entries, HashMap *icons, FIL
     {
         .icons = icons,
         .fp = fp,
-        .category = category,     
+        .category = category,
+        .terminal = terminal,
     };
 
-    // Recursively traverse the BST in-order and write each entry to the file
-    BSTInOrderTraverse(entries, WriteMenuCategory, &args);
+    // The entries are sorted by name, so are the menu items
+    EntriesForEach(entries, WriteMenuCategory, &args);
 
     WRITE_CFG("       </Menu>\n");
 }
@@ -150,12 +155,12 @@ static void CountCategories(void *ptr, void *args_ptr)
 }
 
 // Stubbed out
-int CreateJWMRootMenuWithXDGMenu(JWM *jwm, BTreeNode *entries, HashMap *icons, FILE *fp, const char *xdg_menu_path)
+int CreateJWMRootMenuWithXDGMenu(JWM *jwm, EntryStore *entries, HashMap *icons, FILE *fp, const char *xdg_menu_path)
 {
     return 0;
 }
 
-int CreateJWMRootMenu(JWM *jwm, BTreeNode *entries, HashMap *icons, const char *xdg_menu_path)
+int CreateJWMRootMenu(JWM *jwm, EntryStore *entries, HashMap *icons, const char *xdg_menu_path)
 {
     char path[512];
     const char *fname = "menu";
@@ -163,11 +168,15 @@ int CreateJWMRootMenu(JWM *jwm, BTreeNode *entries, HashMap *icons, const char *
     strlcpy(path, jwm->autogen_config_path, sizeof(path));
     strlcat(path, fname, sizeof(path));
 
-    // This is ugly, this should not be called here. g_terminal should be set after all desktop entries are loaded.
-    if (g_terminal == NULL)
-        g_terminal = GetCoreProgram(entries, TerminalEmulator, jwm->terminal_name);
+    // Resolved here instead of being cached globally, so the menu can be generated alongside the other files
+    XDGDesktopEntry *terminal = GetCoreProgram(entries, TerminalEmulator, jwm->terminal_name);
+    if (terminal == NULL)
+    {
+        fprintf(stderr, "No terminal emulator available for terminal programs!\n");
+        return -1;
+    }
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -177,7 +186,9 @@ int CreateJWMRootMenu(JWM *jwm, BTreeNode *entries, HashMap *icons, const char *
 
     if (xdg_menu_path != NULL)
     {
-        return CreateJWMRootMenuWithXDGMenu(jwm, entries, icons, fp, xdg_menu_path);
+        int ret = CreateJWMRootMenuWithXDGMenu(jwm, entries, icons, fp, xdg_menu_path);
+        OutputAbort(fp, path);
+        return ret;
     }
 
     printf("Writing to %s\n", path);
@@ -210,18 +221,27 @@ int CreateJWMRootMenu(JWM *jwm, BTreeNode *entries, HashMap *icons, const char *
 
     for (int i = 0; i < num_categories; i++)
     {
+        const HashKey *interned = Intern(categories[i].real_name);
+        if (interned == NULL)
+        {
+            fprintf(stderr, "Out of memory writing '%s'\n", path);
+            OutputAbort(fp, path);
+            return -1;
+        }
+
         args[i].category = categories[i];
+        args[i].category.real_name = interned->str;
         args[i].found = false;
     }
 
-    BSTInOrderTraverse(entries, CountCategories, args);
+    EntriesForEach(entries, CountCategories, args);
 
     bool use_symbolic = HashMapGet(icons, "applications-multimedia-symbolic") != NULL;
     for (int i = 0; i < num_categories; i++)
     {
         if (args[i].found)
         {
-            WriteJWMRootMenuCategoryList(entries, icons, fp, &args[i].category, use_symbolic);
+            WriteJWMRootMenuCategoryList(entries, icons, terminal, fp, &args[i].category, use_symbolic);
         }
     }
 
@@ -248,6 +268,5 @@ int CreateJWMRootMenu(JWM *jwm, BTreeNode *entries, HashMap *icons, const char *
     WRITE_CFG("    </RootMenu>\n");
     WRITE_CFG("</JWM>");
 
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
@@ -3,18 +3,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <errno.h>
 
 #include <bsd/string.h>
 #include <confuse.h>
 
 #include "common.h"
-#include "bstree.h"
+#include "containers.h"
 #include "list.h"
+#include "arena.h"
 #include "hashing.h"
 #include "darray.h"
-#include "icons.h"
 #include "desktop_entries.h"
+#include "icons.h"
 #include "config.h"
 
 
@@ -178,7 +180,7 @@ int CreateJWMStyles(JWM *jwm)
     strlcpy(path, jwm->autogen_config_path, sizeof(path));
     strlcat(path, fname, sizeof(path));
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -202,6 +204,5 @@ int CreateJWMStyles(JWM *jwm)
 
     WRITE_CFG("</JWM>\n");
 
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
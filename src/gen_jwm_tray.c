@@ -3,22 +3,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <errno.h>
 
 #include <bsd/string.h>
 #include <confuse.h>
 
-#include "bstree.h"
+#include "containers.h"
 #include "list.h"
+#include "arena.h"
 #include "hashing.h"
 #include "darray.h"
-#include "icons.h"
 #include "desktop_entries.h"
+#include "icons.h"
 #include "config.h"
 
-// Ugly global, should be removed
-XDGDesktopEntry *g_terminal = NULL;
-
 static void AddTraySpacing(FILE *fp, Tray *tray)
 {
     if (tray->position < Left)
@@ -31,7 +30,7 @@ static void AddTraySpacing(FILE *fp, Tray *tray)
     }
 }
 
-static void AddProgramToTray(BTreeNode *entries, FILE *fp, HashMap *icons, Tray *tray, const char *exec)
+static void AddProgramToTray(EntryStore *entries, FILE *fp, HashMap *icons, Tray *tray, const char *exec)
 {
     //XDGDesktopEntry *program = EntriesSearch(entries, exec);
     XDGDesktopEntry *program = GetProgram(entries, exec);
@@ -52,7 +51,7 @@ static void AddProgramToTray(BTreeNode *entries, FILE *fp, HashMap *icons, Tray
     }
 }
 
-int CreateJWMTray(JWM *jwm, BTreeNode *entries, HashMap *icons)
+int CreateJWMTray(JWM *jwm, EntryStore *entries, HashMap *icons)
 {
     char path[512];
     const char *fname = "tray";
@@ -60,7 +59,7 @@ int CreateJWMTray(JWM *jwm, BTreeNode *entries, HashMap *icons)
     strlcpy(path, jwm->autogen_config_path, sizeof(path));
     strlcat(path, fname, sizeof(path));
 
-    FILE *fp = fopen(path, "w");
+    FILE *fp = OutputOpen(path);
 
     if (fp == NULL)
     {
@@ -169,6 +168,5 @@ int CreateJWMTray(JWM *jwm, BTreeNode *entries, HashMap *icons)
     }
 
     WRITE_CFG("</JWM>\n");
-    fclose(fp);
-    return 0;
+    return OutputClose(fp, path);
 }
@@ -3,201 +3,641 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
+#include "arena.h"
 #include "hashing.h"
+#include "stats.h"
 
+#ifdef ENABLE_HASH_GROUPS
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+// Groups stay short even when the table is fuller
+#define LOAD_FACTOR 0.875
+#else
 #define LOAD_FACTOR 0.75
+#endif
+
 #define CAPACITY_START 32
+#define ARENA_CHUNK_SIZE 4096
+#define NOT_FOUND SIZE_MAX
+
+// wyhash style: reads the key 8 bytes at a time and mixes with 64x64->128 bit multiplies.
+// Keys shorter than 16 bytes are read with overlapping 4 byte loads, so nothing past the end is touched.
+#define HASH_SEED 0xA0761D6478BD642Full
+#define HASH_P0 0xE7037ED1A0B428DBull
+#define HASH_P1 0x8EBC6AF09C88C6E3ull
 
-// 64 bit and 32 bit fnv1-a
-static size_t Hash(const char *key)
+static inline void Multiply(uint64_t *a, uint64_t *b)
 {
-#if defined (__x86_64__) || defined (__aarch64__) || defined(__riscv) && (__riscv_xlen == 64)
-    const size_t fnv_prime = 1099511628211;
-    size_t hash = 14695981039346656037u; // FNV offset basis
+#ifdef __SIZEOF_INT128__
+    __uint128_t product = (__uint128_t)*a * *b;
+    *a = (uint64_t)product;
+    *b = (uint64_t)(product >> 64);
 #else
-    const size_t fnv_prime = 16777619;
-    size_t hash = 2166136261u; // FNV offset basis
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
 #endif
+}
+
+static inline uint64_t Mix(uint64_t a, uint64_t b)
+{
+    Multiply(&a, &b);
+    return a ^ b;
+}
 
-    for (size_t i = 0; key[i] != '\0'; i++)
+static inline uint64_t Read8(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t Read4(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint64_t HashBytes(const void *key, size_t len)
+{
+    const uint8_t *p = key;
+    uint64_t seed = HASH_SEED ^ Mix(HASH_SEED ^ HASH_P0, HASH_P1);
+    uint64_t a;
+    uint64_t b;
+
+    if (len <= 16)
     {
-        hash ^= (unsigned char)key[i];
-        hash *= fnv_prime;
+        if (len >= 4)
+        {
+            // Two overlapping pairs of 4 byte reads cover anything from 4 to 16 bytes
+            size_t offset = (len >> 3) << 2;
+            a = (Read4(p) << 32) | Read4(p + offset);
+            b = (Read4(p + len - 4) << 32) | Read4(p + len - 4 - offset);
+        }
+        else if (len > 0)
+        {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
     }
+    else
+    {
+        size_t remaining = len;
+        while (remaining > 16)
+        {
+            seed = Mix(Read8(p) ^ HASH_P1, Read8(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
 
-    return hash;
+        // The last 16 bytes, overlapping with the ones already mixed in
+        a = Read8(p + remaining - 16);
+        b = Read8(p + remaining - 8);
+    }
+
+    a ^= HASH_P1;
+    b ^= seed;
+    Multiply(&a, &b);
+    return Mix(a ^ HASH_P0 ^ len, b ^ HASH_P1);
 }
 
-HashMap *HashMapCreate(void)
+// Folds the hash into the 32 bits stored per slot, keeping clear of the empty and tombstone markers
+static uint32_t SlotHash(const char *key, size_t len)
 {
-    HashMap *map = malloc(sizeof(*map));
-    map->entries = malloc(sizeof(Key *) * CAPACITY_START);
-    for (size_t i = 0; i < CAPACITY_START; i++)
+    uint64_t hash = HashBytes(key, len);
+    uint32_t folded = (uint32_t)(hash ^ (hash >> 32));
+
+    return folded <= HASH_TOMBSTONE ? folded + 2 : folded;
+}
+
+// The key is len bytes long and the stored one has to end right there
+static inline bool KeyEquals(const char *stored, const char *key, size_t len)
+{
+    return memcmp(stored, key, len) == 0 && stored[len] == '\0';
+}
+
+HashKey HashKeyInitN(const char *str, size_t len)
+{
+    HashKey key = { .str = str, .len = len, .hash = SlotHash(str, len) };
+    return key;
+}
+
+HashKey HashKeyInit(const char *str)
+{
+    return HashKeyInitN(str, strlen(str));
+}
+
+static void TableRehash(HashTable *table, size_t new_capacity);
+
+// Tombstones count towards the load, when they make up most of it the table is rehashed at the same size
+static void TableReserve(HashTable *table)
+{
+    if ((double)(table->size + table->tombstones) / table->capacity <= LOAD_FACTOR)
+        return;
+
+    if (table->tombstones > table->size)
+        TableRehash(table, table->capacity);
+    else
+        TableRehash(table, table->capacity * 2);
+}
+
+#ifdef ENABLE_HASH_GROUPS
+
+// Swiss table style groups: every slot has a control byte holding the low 7 bits of its hash, so one SIMD
+// compare finds the candidates among 16 slots. The groups are probed in triangular steps, which visits
+// every group when their number is a power of two.
+
+#define GROUP_SIZE 16
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xFE
+
+// NEON has no movemask, its masks have 4 bits per slot and only the top one is kept
+#if !defined(__SSE2__) && defined(__ARM_NEON)
+#define GROUP_MASK_SHIFT 2
+#else
+#define GROUP_MASK_SHIFT 0
+#endif
+
+typedef uint64_t GroupMask;
+
+static inline GroupMask GroupMatch(const uint8_t *ctrl, uint8_t byte)
+{
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+#elif defined(__ARM_NEON)
+    uint8x16_t matches = vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(byte));
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ull;
+#else
+    GroupMask mask = 0;
+    for (int i = 0; i < GROUP_SIZE; i++)
     {
-        map->entries[i] = NULL;
+        if (ctrl[i] == byte)
+            mask |= (GroupMask)1 << i;
     }
-    map->size = 0;
-    map->capacity = CAPACITY_START;
+    return mask;
+#endif
+}
 
-    return map;
+// Empty and deleted are the only control bytes with the top bit set
+static inline GroupMask GroupMatchFree(const uint8_t *ctrl)
+{
+#if defined(__SSE2__)
+    return (uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#elif defined(__ARM_NEON)
+    uint8x16_t free_slots = vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(ctrl)), vdupq_n_s8(0));
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(free_slots), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ull;
+#else
+    GroupMask mask = 0;
+    for (int i = 0; i < GROUP_SIZE; i++)
+    {
+        if (ctrl[i] & 0x80)
+            mask |= (GroupMask)1 << i;
+    }
+    return mask;
+#endif
 }
 
-HashMap2 *HashMapCreate2(void (*DestroyCallback)(void*), void (*PrintCallback)(void*))
+static inline size_t GroupFirst(GroupMask mask)
 {
-    HashMap2 *map = malloc(sizeof(*map));
-    map->entries = malloc(sizeof(Key2*) * CAPACITY_START);
+    return __builtin_ctzll(mask) >> GROUP_MASK_SHIFT;
+}
+
+static inline size_t HomeGroup(uint32_t hash, size_t capacity)
+{
+    return (hash >> 7) & (capacity / GROUP_SIZE - 1);
+}
+
+static bool SlotUsed(const HashTable *table, size_t index)
+{
+    return table->ctrl[index] < CTRL_EMPTY;
+}
+
+static void TableInit(HashTable *table, size_t capacity, bool has_values)
+{
+    table->ctrl = malloc(capacity);
+    if (table->ctrl)
+        memset(table->ctrl, CTRL_EMPTY, capacity);
+    table->hashes = malloc(sizeof(*table->hashes) * capacity);
+    table->keys = malloc(sizeof(*table->keys) * capacity);
+    table->values = has_values ? malloc(sizeof(*table->values) * capacity) : NULL;
+    table->size = 0;
+    table->tombstones = 0;
+    table->capacity = capacity;
+    ArenaInit(&table->arena, ARENA_CHUNK_SIZE);
+}
+
+static void TableDestroy(HashTable *table)
+{
+    free(table->ctrl);
+    free(table->hashes);
+    free(table->keys);
+    free(table->values);
+    ArenaDestroy(&table->arena);
+}
 
-    for (size_t i = 0; i < CAPACITY_START; i++)
+// First empty or deleted slot on the probe sequence of hash
+static size_t FindFreeSlot(const uint8_t *ctrl, size_t capacity, uint32_t hash)
+{
+    size_t group_mask = capacity / GROUP_SIZE - 1;
+    size_t group = HomeGroup(hash, capacity);
+
+    for (size_t step = 1; ; step++)
     {
-        map->entries[i] = NULL;
-    }
-    map->size = 0;
-    map->capacity = CAPACITY_START;
-    map->DestroyCallback = DestroyCallback;
-    map->PrintCallback = PrintCallback;
+        GroupMask mask = GroupMatchFree(&ctrl[group * GROUP_SIZE]);
+        if (mask)
+            return group * GROUP_SIZE + GroupFirst(mask);
 
-    return map;
+        group = (group + step) & group_mask;
+    }
 }
 
-void HashMapResize(HashMap *map)
+static void TableRehash(HashTable *table, size_t new_capacity)
 {
-    size_t new_capacity = map->capacity * 2;
-    Key **new_entries = malloc(sizeof(Key *) * new_capacity);
+    uint8_t *new_ctrl = malloc(new_capacity);
+    uint32_t *new_hashes = malloc(sizeof(*new_hashes) * new_capacity);
+    char **new_keys = malloc(sizeof(*new_keys) * new_capacity);
+    void **new_values = table->values ? malloc(sizeof(*new_values) * new_capacity) : NULL;
+
+    memset(new_ctrl, CTRL_EMPTY, new_capacity);
 
-    for (size_t i = 0; i < new_capacity; i++)
+    for (size_t i = 0; i < table->capacity; i++)
     {
-        new_entries[i] = NULL;
+        if (!SlotUsed(table, i))
+            continue;
+
+        uint32_t hash = table->hashes[i];
+        size_t index = FindFreeSlot(new_ctrl, new_capacity, hash);
+
+        new_ctrl[index] = table->ctrl[i];
+        new_hashes[index] = hash;
+        new_keys[index] = table->keys[i];
+        if (new_values)
+            new_values[index] = table->values[i];
     }
 
-    size_t mask = new_capacity - 1;
-    
-    for (size_t i = 0; i < map->capacity; i++)
+    free(table->ctrl);
+    free(table->hashes);
+    free(table->keys);
+    free(table->values);
+    table->ctrl = new_ctrl;
+    table->hashes = new_hashes;
+    table->keys = new_keys;
+    table->values = new_values;
+    table->capacity = new_capacity;
+    table->tombstones = 0;
+}
+
+// Probes are counted in groups
+static size_t TableFind(const HashTable *table, const char *key, size_t len, uint32_t hash, size_t *probes)
+{
+    size_t group_mask = table->capacity / GROUP_SIZE - 1;
+    size_t group = HomeGroup(hash, table->capacity);
+    uint8_t h2 = hash & 0x7F;
+
+    *probes = 1;
+
+    for (size_t step = 1; ; step++)
     {
-        Key *entry = map->entries[i];
-        if (entry != NULL)
+        const uint8_t *ctrl = &table->ctrl[group * GROUP_SIZE];
+
+        for (GroupMask mask = GroupMatch(ctrl, h2); mask; mask &= mask - 1)
         {
-            size_t index = entry->hash & mask;
+            size_t index = group * GROUP_SIZE + GroupFirst(mask);
+            if (table->hashes[index] == hash && KeyEquals(table->keys[index], key, len))
+                return index;
+        }
 
-            while (new_entries[index] != NULL)
-            {
-                index = (index + 1) & mask;
-            }
+        // A key is never placed past a group with an empty slot
+        if (GroupMatch(ctrl, CTRL_EMPTY))
+            return NOT_FOUND;
 
-            new_entries[index] = entry;
-        }
+        group = (group + step) & group_mask;
+        (*probes)++;
     }
+}
+
+static size_t TableInsert(HashTable *table, const char *key, size_t len, uint32_t hash, bool *found)
+{
+    TableReserve(table);
+
+    size_t probes;
+    size_t index = TableFind(table, key, len, hash, &probes);
 
-    free(map->entries);
-    map->entries = new_entries;
-    map->capacity = new_capacity;
+    if (index != NOT_FOUND)
+    {
+        *found = true;
+        return index;
+    }
+
+    index = FindFreeSlot(table->ctrl, table->capacity, hash);
+    if (table->ctrl[index] == CTRL_DELETED)
+        table->tombstones--;
+
+    table->ctrl[index] = hash & 0x7F;
+    table->hashes[index] = hash;
+    table->keys[index] = ArenaStrndup(&table->arena, key, len);
+    table->size++;
+
+    *found = false;
+    return index;
 }
 
-void HashMapResize2(HashMap2 *map)
+static size_t TableRemove(HashTable *table, const char *key, size_t len)
 {
-    size_t new_capacity = map->capacity * 2;
-    Key2 **new_entries = malloc(sizeof(Key2*) * new_capacity);
+    size_t probes;
+    size_t index = TableFind(table, key, len, SlotHash(key, len), &probes);
+
+    if (index == NOT_FOUND)
+        return NOT_FOUND;
 
-    for (size_t i = 0; i < new_capacity; i++)
+    // Lookups stop at a group with an empty slot, so the slot can be emptied if its group already has one
+    if (GroupMatch(&table->ctrl[index & ~(size_t)(GROUP_SIZE - 1)], CTRL_EMPTY))
+    {
+        table->ctrl[index] = CTRL_EMPTY;
+    }
+    else
     {
-        new_entries[i] = NULL;
+        table->ctrl[index] = CTRL_DELETED;
+        table->tombstones++;
     }
 
-    size_t new_mask = new_capacity - 1;
+    table->size--;
+    return index;
+}
+
+// Fills probes with the number of groups a lookup of each key walks, returns the number of keys
+size_t HashTableProbeLengths(const HashTable *table, size_t *probes)
+{
+    size_t count = 0;
+    size_t group_mask = table->capacity / GROUP_SIZE - 1;
 
-    for (size_t i = 0; i < map->capacity; i++)
+    for (size_t i = 0; i < table->capacity; i++)
     {
-        Key2 *entry = map->entries[i];
-        if (entry != NULL)
-        {
-            size_t index = entry->hash & new_mask;
+        if (!SlotUsed(table, i))
+            continue;
 
-            while (new_entries[index] != NULL)
-            {
-                index = (index + 1) & new_mask;
-            }
+        size_t group = HomeGroup(table->hashes[i], table->capacity);
+        size_t length = 1;
 
-            new_entries[index] = entry;
+        for (size_t step = 1; group != i / GROUP_SIZE; step++)
+        {
+            group = (group + step) & group_mask;
+            length++;
         }
+
+        probes[count++] = length;
     }
 
-    free(map->entries);
-    map->entries = new_entries;
-    map->capacity = new_capacity;
+    return count;
 }
 
-void HashMapInsert(HashMap *map, const char *key, const char *value)
+#else
+
+static bool SlotUsed(const HashTable *table, size_t index)
 {
-    if ((double)map->size / map->capacity > LOAD_FACTOR)
+    return table->hashes[index] > HASH_TOMBSTONE;
+}
+
+static void TableInit(HashTable *table, size_t capacity, bool has_values)
+{
+    table->hashes = calloc(capacity, sizeof(*table->hashes));
+    table->keys = malloc(sizeof(*table->keys) * capacity);
+    table->values = has_values ? malloc(sizeof(*table->values) * capacity) : NULL;
+    table->size = 0;
+    table->tombstones = 0;
+    table->capacity = capacity;
+    ArenaInit(&table->arena, ARENA_CHUNK_SIZE);
+}
+
+static void TableDestroy(HashTable *table)
+{
+    free(table->hashes);
+    free(table->keys);
+    free(table->values);
+    ArenaDestroy(&table->arena);
+}
+
+static void TableRehash(HashTable *table, size_t new_capacity)
+{
+    uint32_t *new_hashes = calloc(new_capacity, sizeof(*new_hashes));
+    char **new_keys = malloc(sizeof(*new_keys) * new_capacity);
+    void **new_values = table->values ? malloc(sizeof(*new_values) * new_capacity) : NULL;
+
+    size_t mask = new_capacity - 1;
+
+    for (size_t i = 0; i < table->capacity; i++)
     {
-        HashMapResize(map);
+        uint32_t hash = table->hashes[i];
+        if (!SlotUsed(table, i))
+            continue;
+
+        size_t index = hash & mask;
+
+        while (new_hashes[index] != HASH_EMPTY)
+        {
+            index = (index + 1) & mask;
+        }
+
+        new_hashes[index] = hash;
+        new_keys[index] = table->keys[i];
+        if (new_values)
+            new_values[index] = table->values[i];
     }
 
-    size_t hash = Hash(key);
-    size_t mask = map->capacity - 1;
+    free(table->hashes);
+    free(table->keys);
+    free(table->values);
+    table->hashes = new_hashes;
+    table->keys = new_keys;
+    table->values = new_values;
+    table->capacity = new_capacity;
+    table->tombstones = 0;
+}
+
+static size_t TableFind(const HashTable *table, const char *key, size_t len, uint32_t hash, size_t *probes)
+{
+    size_t mask = table->capacity - 1;
     size_t index = hash & mask;
+    uint32_t slot_hash;
+
+    *probes = 1;
+
+    while ((slot_hash = table->hashes[index]) != HASH_EMPTY)
+    {
+        // Only the keys with a matching hash get compared
+        if (slot_hash == hash && KeyEquals(table->keys[index], key, len))
+            return index;
+
+        // Handle collision using open addressing
+        index = (index + 1) & mask;
+        (*probes)++;
+    }
 
-    char *temp_value = strdup(value);
+    return NOT_FOUND;
+}
+
+// Returns the slot of key, a new one is claimed and given a copy of the key if the key isn't in the table yet
+static size_t TableInsert(HashTable *table, const char *key, size_t len, uint32_t hash, bool *found)
+{
+    TableReserve(table);
 
-    while (map->entries[index] != NULL)
+    size_t mask = table->capacity - 1;
+    size_t index = hash & mask;
+    size_t tombstone = NOT_FOUND;
+    uint32_t slot_hash;
+
+    while ((slot_hash = table->hashes[index]) != HASH_EMPTY)
     {
-        // Compare precomputed hash and compare keys
-        // The compiler (GCC) will optimize this into a nested if statement
-        // It will first check the hash and only compare the keys if the hash matches
-        if (map->entries[index]->hash == hash && strcmp(map->entries[index]->key, key) == 0)
+        if (slot_hash == hash && KeyEquals(table->keys[index], key, len))
         {
-            // Dupe found, update value and finish
-            free(map->entries[index]->value);
-            map->entries[index]->value = temp_value;
-            return;
+            *found = true;
+            return index;
         }
-        // Handle collision using Open Addressing (Linear Probing)
+
+        // The key could still be further down, so the first removed slot is only reused once that is ruled out
+        if (slot_hash == HASH_TOMBSTONE && tombstone == NOT_FOUND)
+            tombstone = index;
+
         index = (index + 1) & mask;
     }
 
-    Key *new_entry = malloc(sizeof(Key));
-    new_entry->key = strdup(key);
-    new_entry->value = temp_value;
-    new_entry->hash = hash;
+    if (tombstone != NOT_FOUND)
+    {
+        index = tombstone;
+        table->tombstones--;
+    }
+
+    table->hashes[index] = hash;
+    table->keys[index] = ArenaStrndup(&table->arena, key, len);
+    table->size++;
 
-    map->entries[index] = new_entry;
-    map->size++;
+    *found = false;
+    return index;
 }
 
-void HashMapInsert2(HashMap2 *map, const char *key, void *value)
+static size_t TableRemove(HashTable *table, const char *key, size_t len)
 {
-    if ((double)map->size / map->capacity > LOAD_FACTOR)
+    size_t probes;
+    size_t index = TableFind(table, key, len, SlotHash(key, len), &probes);
+
+    if (index == NOT_FOUND)
+        return NOT_FOUND;
+
+    // No probe sequence goes through a slot that is followed by an empty one, so it can be emptied right away
+    size_t next = (index + 1) & (table->capacity - 1);
+    if (table->hashes[next] == HASH_EMPTY)
+    {
+        table->hashes[index] = HASH_EMPTY;
+    }
+    else
     {
-        HashMapResize2(map);
+        table->hashes[index] = HASH_TOMBSTONE;
+        table->tombstones++;
     }
 
-    size_t hash = Hash(key);
-    size_t mask = map->capacity - 1;
-    size_t index = hash & mask;
+    table->size--;
+    return index;
+}
+
+// Fills probes with the number of slots a lookup of each key walks, returns the number of keys
+size_t HashTableProbeLengths(const HashTable *table, size_t *probes)
+{
+    size_t count = 0;
+    size_t mask = table->capacity - 1;
 
-    while (map->entries[index] != NULL)
+    for (size_t i = 0; i < table->capacity; i++)
     {
-        // Compare precomputed hash and compare keys
-        // The compiler (GCC) will optimize this into a nested if statement
-        // It will first check the hash and only compare the keys if the hash matches
-        if (map->entries[index]->hash == hash && strcmp(map->entries[index]->key, key) == 0)
-        {
-            // Dupe found, update value and finish
-            map->DestroyCallback(map->entries[index]->value);
-            free(map->entries[index]->value);
-            return;
-        }
-        // Handle collision using open addressing
-        index = (index + 1) & mask;
+        if (SlotUsed(table, i))
+            probes[count++] = ((i - (table->hashes[i] & mask)) & mask) + 1;
     }
 
-    Key2 *new_entry = malloc(sizeof(Key2));
-    new_entry->key = strdup(key);
-    new_entry->value = value;
-    new_entry->hash = hash;
+    return count;
+}
 
-    map->entries[index] = new_entry;
-    map->size++;
+#endif
+
+HashMap *HashMapCreate(void)
+{
+    HashMap *map = malloc(sizeof(*map));
+    TableInit(&map->table, CAPACITY_START, true);
+    map->stats_group = OtherMapStats;
+
+    return map;
+}
+
+HashMap2 *HashMapCreate2(void (*DestroyCallback)(void*), void (*PrintCallback)(void*))
+{
+    HashMap2 *map = malloc(sizeof(*map));
+    TableInit(&map->table, CAPACITY_START, true);
+    map->DestroyCallback = DestroyCallback;
+    map->PrintCallback = PrintCallback;
+    map->stats_group = OtherMapStats;
+
+    return map;
+}
+
+void HashMapResize(HashMap *map)
+{
+    TableRehash(&map->table, map->table.capacity * 2);
+}
+
+void HashMapResize2(HashMap2 *map)
+{
+    TableRehash(&map->table, map->table.capacity * 2);
+}
+
+// For callers that already know the lengths, like the directory indexing
+void HashMapInsertN(HashMap *map, const char *key, size_t key_len, const char *value, size_t value_len)
+{
+    bool found;
+    size_t index = TableInsert(&map->table, key, key_len, SlotHash(key, key_len), &found);
+
+    // A replaced value stays in the arena until the map is destroyed
+    map->table.values[index] = ArenaStrndup(&map->table.arena, value, value_len);
+}
+
+void HashMapInsert(HashMap *map, const char *key, const char *value)
+{
+    HashMapInsertN(map, key, strlen(key), value, strlen(value));
+}
+
+void HashMapInsertHashed(HashMap *map, const HashKey *key, const char *value, size_t value_len)
+{
+    bool found;
+    size_t index = TableInsert(&map->table, key->str, key->len, key->hash, &found);
+
+    map->table.values[index] = ArenaStrndup(&map->table.arena, value, value_len);
+}
+
+void HashMapInsert2(HashMap2 *map, const char *key, void *value)
+{
+    bool found;
+    size_t len = strlen(key);
+    size_t index = TableInsert(&map->table, key, len, SlotHash(key, len), &found);
+
+    // Dupe found, destroy the old value
+    if (found && map->table.values[index] != value && map->DestroyCallback)
+        map->DestroyCallback(map->table.values[index]);
+
+    map->table.values[index] = value;
 }
 
 void HashMapInsertWithSection(HashMap *map, const char *section, const char *key, const char *value)
@@ -207,54 +647,67 @@ void HashMapInsertWithSection(HashMap *map, const char *section, const char *key
     HashMapInsert(map, combined_key, value);
 }
 
+const char *HashMapGetN(HashMap *map, const char *key, size_t key_len)
+{
+    size_t probes;
+    size_t index = TableFind(&map->table, key, key_len, SlotHash(key, key_len), &probes);
+
+    StatsRecordProbe(map->stats_group, probes);
+    return index != NOT_FOUND ? map->table.values[index] : NULL;
+}
+
 const char *HashMapGet(HashMap *map, const char *key)
 {
-    size_t hash = Hash(key);
-    size_t mask = map->capacity - 1;
-    size_t index = hash & mask;
+    return HashMapGetN(map, key, strlen(key));
+}
 
-    while (map->entries[index] != NULL)
-    {
-        if (map->entries[index]->hash == hash && strcmp(map->entries[index]->key, key) == 0)
-        {
-            return map->entries[index]->value;
-        }
-        // Handle collision using open addressing
-        index = (index + 1) & mask;
-    }
+const char *HashMapGetHashed(HashMap *map, const HashKey *key)
+{
+    size_t probes;
+    size_t index = TableFind(&map->table, key->str, key->len, key->hash, &probes);
 
-    return NULL;
+    StatsRecordProbe(map->stats_group, probes);
+    return index != NOT_FOUND ? map->table.values[index] : NULL;
 }
 
 void *HashMapGet2(HashMap2 *map, const char *key)
 {
-    size_t hash = Hash(key);
-    size_t mask = map->capacity - 1;
-    size_t index = hash & mask;
+    size_t len = strlen(key);
+    size_t probes;
+    size_t index = TableFind(&map->table, key, len, SlotHash(key, len), &probes);
 
-    while (map->entries[index] != NULL)
-    {
-        if (map->entries[index]->hash == hash && strcmp(map->entries[index]->key, key) == 0)
-        {
-            return map->entries[index]->value;
-        }
-        // Handle collision using open addressing
-        index = (index + 1) & mask;
-    }
+    StatsRecordProbe(map->stats_group, probes);
+    return index != NOT_FOUND ? map->table.values[index] : NULL;
+}
+
+bool HashMapRemove(HashMap *map, const char *key)
+{
+    return TableRemove(&map->table, key, strlen(key)) != NOT_FOUND;
+}
+
+bool HashMapRemove2(HashMap2 *map, const char *key)
+{
+    size_t index = TableRemove(&map->table, key, strlen(key));
 
-    return NULL;
+    if (index == NOT_FOUND)
+        return false;
+
+    if (map->DestroyCallback)
+        map->DestroyCallback(map->table.values[index]);
+
+    return true;
 }
 
 void HashMapPrint(HashMap *map)
 {
     printf("\n");
-    for (size_t i = 0; i < map->capacity; i++)
+    for (size_t i = 0; i < map->table.capacity; i++)
     {
-        if (map->entries[i] != NULL)
+        if (SlotUsed(&map->table, i))
         {
-            printf("Key      : %s\n", map->entries[i]->key);
-            printf("Key Hash : 0x%08zX\n", map->entries[i]->hash);
-            printf("Value    : %s\n\n", map->entries[i]->value);
+            printf("Key      : %s\n", map->table.keys[i]);
+            printf("Key Hash : 0x%08X\n", map->table.hashes[i]);
+            printf("Value    : %s\n\n", (char*)map->table.values[i]);
         }
     }
 
@@ -264,49 +717,46 @@ void HashMapPrint(HashMap *map)
 void HashMapPrint2(HashMap2 *map)
 {
     printf("\n");
-    for (size_t i = 0; i < map->capacity; i++)
+    for (size_t i = 0; i < map->table.capacity; i++)
     {
-        if (map->entries[i] != NULL)
+        if (SlotUsed(&map->table, i))
         {
-            printf("Key      : %s\n", map->entries[i]->key);
-            printf("Key Hash : 0x%08zX\n", map->entries[i]->hash);
-            //printf("Value    : %s\n\n", map->entries[i]->value);
-            map->PrintCallback(map->entries[i]->value);
+            printf("Key      : %s\n", map->table.keys[i]);
+            printf("Key Hash : 0x%08X\n", map->table.hashes[i]);
+            map->PrintCallback(map->table.values[i]);
         }
     }
 
     printf("\n");
 }
 
-void HashMapDestroy(HashMap *map)
+void HashMapForEach(HashMap *map, void (*Func)(const char*, const char*, void*), void *args)
 {
-    for (size_t i = 0; i < map->capacity; i++)
+    for (size_t i = 0; i < map->table.capacity; i++)
     {
-        if (map->entries[i] != NULL)
-        {
-            free(map->entries[i]->key);
-            free(map->entries[i]->value);
-            free(map->entries[i]);
-        }
+        if (SlotUsed(&map->table, i))
+            Func(map->table.keys[i], map->table.values[i], args);
     }
+}
 
-    free(map->entries);
+void HashMapDestroy(HashMap *map)
+{
+    TableDestroy(&map->table);
     free(map);
 }
 
 void HashMapDestroy2(HashMap2 *map)
 {
-    for (size_t i = 0; i < map->capacity; i++)
+    if (map->DestroyCallback)
     {
-        if (map->entries[i] != NULL)
+        for (size_t i = 0; i < map->table.capacity; i++)
         {
-            free(map->entries[i]->key);
-            map->DestroyCallback(map->entries[i]->value);
-            free(map->entries[i]);
+            if (SlotUsed(&map->table, i))
+                map->DestroyCallback(map->table.values[i]);
         }
     }
 
-    free(map->entries);
+    TableDestroy(&map->table);
     free(map);
 }
 
@@ -318,12 +768,17 @@ HashSet *HashSetCreate(size_t capacity)
         return NULL;
     }
 
-    set->capacity = capacity;
-    set->size = 0;
+    // The capacity has to be a power of two for the mask
+    size_t table_capacity = CAPACITY_START;
+    while (table_capacity < capacity)
+    {
+        table_capacity *= 2;
+    }
 
-    set->entries = calloc(capacity, sizeof(NodeSet *));
-    if (!set->entries)
+    TableInit(&set->table, table_capacity, false);
+    if (!set->table.hashes || !set->table.keys)
     {
+        TableDestroy(&set->table);
         free(set);
         return NULL;
     }
@@ -338,83 +793,30 @@ void HashSetDestroy(HashSet *set)
         return;
     }
 
-    for (size_t i = 0; i < set->capacity; i++)
-    {
-        NodeSet *current = set->entries[i];
-        while (current != NULL)
-        {
-            NodeSet *next = current->next;
-            free(current->key);
-            free(current);
-            current = next;
-        }
-    }
-
-    free(set->entries);
+    TableDestroy(&set->table);
     free(set);
 }
 
 bool HashSetContains(HashSet *set, const char *key)
 {
-    size_t hash = Hash(key) % set->capacity;
-    NodeSet *current = set->entries[hash];
-    while (current != NULL)
-    {
-        if (strcmp(current->key, key) == 0)
-        {
-            return true;
-        }
-        current = current->next;
-    }
-    return false;
+    size_t probes;
+    size_t len = strlen(key);
+    return TableFind(&set->table, key, len, SlotHash(key, len), &probes) != NOT_FOUND;
 }
 
 void HashSetResize(HashSet *set)
 {
-    // Resize the hashset
-    size_t new_capacity = set->capacity * 2;
-    NodeSet **new_entries = calloc(new_capacity, sizeof(NodeSet *));
-
-    // Rehash existing elements
-    for (size_t i = 0; i < set->capacity; i++)
-    {
-        NodeSet *current = set->entries[i];
-        while (current != NULL)
-        {
-            NodeSet *next = current->next;
-            size_t new_index = Hash(current->key) % new_capacity;
-            current->next = new_entries[new_index];
-            new_entries[new_index] = current;
-            current = next;
-        }
-    }
-
-    // Free the old buckets array
-    free(set->entries);
-
-    // Update the capacity and buckets array
-    set->capacity = new_capacity;
-    set->entries = new_entries;
+    TableRehash(&set->table, set->table.capacity * 2);
 }
 
 void HashSetInsert(HashSet *set, const char *key)
 {
-    if (HashSetContains(set, key))
-    {
-        return;
-    }
-
-    if ((double)set->size / set->capacity >= LOAD_FACTOR)
-    {
-        // Resize the hashset
-        HashSetResize(set);
-    }
+    bool found;
+    size_t len = strlen(key);
+    TableInsert(&set->table, key, len, SlotHash(key, len), &found);
+}
 
-    // Insert the new key into the hashset
-    size_t index = Hash(key) % set->capacity;
-    NodeSet *new_node = malloc(sizeof(NodeSet));
-    new_node->key = strdup(key);
-    new_node->next = set->entries[index];
-    set->entries[index] = new_node;
-    set->size++;
+bool HashSetRemove(HashSet *set, const char *key)
+{
+    return TableRemove(&set->table, key, strlen(key)) != NOT_FOUND;
 }
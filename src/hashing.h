@@ -1,62 +1,91 @@
 #ifndef HASHING_H
 #define HASHING_H
 
-typedef struct
-{
-    char *key;
-    char *value;
-    size_t hash;
-} Key;
-
-typedef struct NodeSet
-{
-    // value is the key
-    char *key;
-    struct NodeSet *next;
-} NodeSet;
+// Slot hashes below 2 are reserved, real hashes get moved out of the way
+#define HASH_EMPTY 0
+#define HASH_TOMBSTONE 1
 
+// Open addressing with linear probing. The slots are split into parallel arrays, so a probe only walks
+// the 32 bit hashes and a key is only looked at when its hash matches.
+// Keys, and the values of a HashMap, are copied into the table's arena and freed all at once with it.
+// "make HASH_GROUPS=1" probes groups of 16 slots through a control byte per slot instead.
 typedef struct
 {
-    char *key;
-    void *value;
-    size_t hash;
-} Key2;
+#ifdef ENABLE_HASH_GROUPS
+    // Low 7 bits of each slot's hash, or the empty and deleted markers
+    uint8_t *ctrl;
+#endif
+    uint32_t *hashes;
+    char **keys;
+    // NULL in sets
+    void **values;
+    size_t size;
+    // Removed slots, they keep probe sequences going until the next rehash
+    size_t tombstones;
+    size_t capacity;
+    Arena arena;
+} HashTable;
 
 typedef struct
 {
-    Key **entries;
-    size_t size;
-    size_t capacity;
+    HashTable table;
+    // MapStatsGroup the lookups are counted under
+    int stats_group;
 } HashMap;
 
 typedef struct
 {
-    Key2 **entries;
-    size_t size;
-    size_t capacity;
+    HashTable table;
     void (*DestroyCallback)(void*);
     void (*PrintCallback)(void*);
+    int stats_group;
 } HashMap2;
 
-typedef struct {
-    size_t size;
-    size_t capacity;
-    NodeSet **entries;
+typedef struct
+{
+    HashTable table;
 } HashSet;
 
+// A key that is hashed once and then looked up in any number of tables, like an icon name in every icon dir
+typedef struct
+{
+    const char *str;
+    size_t len;
+    uint32_t hash;
+} HashKey;
+
+uint64_t HashBytes(const void *key, size_t len);
+HashKey HashKeyInit(const char *str);
+HashKey HashKeyInitN(const char *str, size_t len);
+size_t HashTableProbeLengths(const HashTable *table, size_t *probes);
+
 void HashMapResize(HashMap *map);
 void HashMapInsert(HashMap *map, const char *key, const char *value);
+void HashMapInsertN(HashMap *map, const char *key, size_t key_len, const char *value, size_t value_len);
+void HashMapInsertHashed(HashMap *map, const HashKey *key, const char *value, size_t value_len);
 void HashMapInsertWithSection(HashMap *map, const char *section, const char *key, const char *value);
 const char *HashMapGet(HashMap *map, const char *key);
+const char *HashMapGetN(HashMap *map, const char *key, size_t key_len);
+const char *HashMapGetHashed(HashMap *map, const HashKey *key);
+bool HashMapRemove(HashMap *map, const char *key);
 HashMap *HashMapCreate(void);
 void HashMapPrint(HashMap *map);
+void HashMapForEach(HashMap *map, void (*Func)(const char *key, const char *value, void *args), void *args);
 void HashMapDestroy(HashMap *map);
 
 HashMap2 *HashMapCreate2(void (*DestroyCallback)(void*), void (*PrintCallback)(void*));
 void HashMapResize2(HashMap2 *map);
 void HashMapInsert2(HashMap2 *map, const char *key, void *value);
 void *HashMapGet2(HashMap2 *map, const char *key);
+bool HashMapRemove2(HashMap2 *map, const char *key);
 void HashMapPrint2(HashMap2 *map);
 void HashMapDestroy2(HashMap2 *map);
 
+HashSet *HashSetCreate(size_t capacity);
+void HashSetResize(HashSet *set);
+void HashSetInsert(HashSet *set, const char *key);
+bool HashSetContains(HashSet *set, const char *key);
+bool HashSetRemove(HashSet *set, const char *key);
+void HashSetDestroy(HashSet *set);
+
 #endif
@@ -0,0 +1,1210 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include <bsd/string.h>
+#include <confuse.h>
+
+#include "common.h"
+#include "darray.h"
+#include "list.h"
+#include "arena.h"
+#include "hashing.h"
+#include "intern.h"
+#include "containers.h"
+#include "desktop_entries.h"
+#include "icons.h"
+#include "config.h"
+#include "fingerprint.h"
+#include "readahead.h"
+#include "helper_status.h"
+#include "helper.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "stats.h"
+
+// Can be changed with --app-dir/--icon-dir or the JWMS_APP_DIR/JWMS_ICON_DIR environment variables
+static char default_app_dir[512] = "/usr/share/applications/";
+static const char *user_app_dir = "~/.local/share/applications/";
+
+// Files written by each generator, relative to the autogen config path (except for the .jwmrc)
+static const char *generator_names[] =
+{
+    "startup",
+    "group",
+    "tray",
+    "menu",
+    "styles",
+    "prefs",
+    "icons",
+    "binds",
+    "autostart",
+    ".jwmrc"
+};
+
+typedef struct
+{
+    GeneratorType type;
+    JWM *jwm;
+    cfg_t *cfg;
+    EntryStore *entries;
+    HashMap *icons;
+    int result;
+} GeneratorTask;
+
+// Shared between the thread parsing the desktop entries and the one loading the icon themes
+typedef struct
+{
+    int size;
+    HashMap *icons;
+    // Icon names of the parsed entries, in the order they were parsed
+    DArray *icon_names;
+    size_t next_icon;
+    bool entries_done;
+    int result;
+
+    pthread_mutex_t lock;
+    pthread_cond_t icons_queued;
+} IconPipeline;
+
+typedef struct
+{
+    dev_t dev;
+    ino_t ino;
+    bool exists;
+} OutputId;
+
+struct Helper
+{
+    JWM *jwm;
+    cfg_t *cfg;
+    EntryStore *entries;
+    HashMap *icons;
+    // Every entry of the current entries has its icon resolved, or failed to
+    bool icons_current;
+    // The GTK icon theme the icons were resolved in and the directories of the loaded themes at the time
+    char icon_theme[256];
+    Fingerprint *icon_dirs;
+    // Icons the daemon looked up that the entries don't have, by "size/name"
+    HashMap *sized_icons;
+    // Lookups that found nothing, by "size/name", so asking again does not search every theme again
+    HashMap *missing_icons;
+    // The inputs as the config and the entries were loaded from them
+    Fingerprint *config_inputs;
+    Fingerprint *app_dirs;
+    // The last --all wrote every output from what is loaded now
+    bool all_generated;
+
+    int jobs;
+    const char *output_dir;
+    // Set by jwms, which starts the autostart programs itself when the config asks for it
+    bool native_autostart;
+
+    OutputId outputs[NumGenerators];
+    bool outputs_snapshot;
+};
+
+int HelperSetAppDir(const char *path)
+{
+    if (path[0] == '\0')
+        return 0;
+
+    // Entry paths are built by appending the file name, which needs the slash to fit as well
+    size_t len = strlen(path);
+    if (len + (path[len - 1] != '/') >= sizeof(default_app_dir))
+    {
+        printf("Application directory too long: %s\n", path);
+        return -1;
+    }
+
+    strlcpy(default_app_dir, path, sizeof(default_app_dir));
+    if (default_app_dir[len - 1] != '/')
+        strlcat(default_app_dir, "/", sizeof(default_app_dir));
+
+    return 0;
+}
+
+int HelperReadEnvironment(void)
+{
+    int ret = 0;
+
+    const char *env_dir = getenv("JWMS_APP_DIR");
+    if (env_dir != NULL && HelperSetAppDir(env_dir) != 0)
+        ret = -1;
+
+    env_dir = getenv("JWMS_ICON_DIR");
+    if (env_dir != NULL && SetIconBaseDir(env_dir) != 0)
+        ret = -1;
+
+    return ret;
+}
+
+// The entries still have to be put in order with EntriesSort
+static int LoadAllDesktopEntries(EntryStore **entries, void (*Func)(void*, void*), void *args)
+{
+    if (*entries == NULL)
+        *entries = EntriesCreate();
+
+    int success = LoadDesktopEntries(*entries, default_app_dir, Func, args);
+
+    if (success != 0)
+    {
+        printf("Failed to load desktop entries from the default path %s!\n", default_app_dir);
+        return -1;
+    }
+
+    char user_app_dir_buffer[512];
+    ExpandPath(user_app_dir_buffer, user_app_dir, sizeof(user_app_dir_buffer));
+    success = LoadDesktopEntries(*entries, user_app_dir_buffer, Func, args);
+
+    if (success != 0)
+    {
+        printf("Failed to load desktop entries from the user %s! Skipping...\n", user_app_dir_buffer);
+    }
+
+    return 0;
+}
+
+static void GetFingerprintPath(char *path, size_t size)
+{
+    ExpandPath(path, "~/.config/jwm/.fingerprint", size);
+}
+
+// Pointing jwm-helper at different roots has to invalidate the last run as well, and so does switching
+// between jwm-helper and jwms, which write a different startup file
+static void GetFingerprintKey(const Helper *helper, char *key, size_t size)
+{
+    snprintf(key, size, "%s apps=%s icons=%s native_autostart=%d", HELPER_VERSION, default_app_dir, GetIconBaseDir(),
+             helper->native_autostart);
+}
+
+static void AddFingerprintPath(const char *path, void *fingerprint)
+{
+    FingerprintAddPath(fingerprint, path);
+}
+
+static void AddExpandedFingerprintPath(Fingerprint *fingerprint, const char *path)
+{
+    char expanded_path[512];
+    if (ExpandPath(expanded_path, path, sizeof(expanded_path)) == 0)
+    {
+        FingerprintAddPath(fingerprint, expanded_path);
+    }
+}
+
+static Fingerprint *FingerprintConfigInputs(Fingerprint *fingerprint)
+{
+    AddExpandedFingerprintPath(fingerprint, JWMS_USER_CONFIG_DIR JWMS_CONFIG_NAME);
+    AddExpandedFingerprintPath(fingerprint, JWMS_SYSTEM_CONFIG_DIR JWMS_CONFIG_NAME);
+    AddExpandedFingerprintPath(fingerprint, "~/.gtkrc-2.0");
+    return fingerprint;
+}
+
+static Fingerprint *FingerprintAppDirs(Fingerprint *fingerprint)
+{
+    AddExpandedFingerprintPath(fingerprint, default_app_dir);
+    AddExpandedFingerprintPath(fingerprint, user_app_dir);
+    return fingerprint;
+}
+
+// Snapshot everything --all reads before it is loaded, so edits made during the run are not missed
+static Fingerprint *FingerprintInputs(void)
+{
+    return FingerprintAppDirs(FingerprintConfigInputs(FingerprintCreate()));
+}
+
+static void GetOutputPath(JWM *jwm, GeneratorType type, char *path, size_t size)
+{
+    if (type == RCFileGenerator)
+    {
+        strlcpy(path, jwm->jwmrc_path, size);
+        return;
+    }
+
+    strlcpy(path, jwm->autogen_config_path, size);
+    strlcat(path, generator_names[type], size);
+}
+
+// The icon themes are only known once they are loaded and the outputs once they are written
+static void SaveFingerprint(Helper *helper, Fingerprint *fingerprint)
+{
+    char path[512];
+
+    IconThemesForEachPath(AddFingerprintPath, fingerprint);
+
+    for (int i = 0; i < NumGenerators; i++)
+    {
+        GetOutputPath(helper->jwm, i, path, sizeof(path));
+        FingerprintAddPath(fingerprint, path);
+    }
+
+    GetFingerprintPath(path, sizeof(path));
+    char key[1024];
+    GetFingerprintKey(helper, key, sizeof(key));
+
+    // The one from before must not vouch for the outputs that were just written
+    if (FingerprintWrite(fingerprint, path, key) != 0)
+        unlink(path);
+}
+
+static void AddInput(const char *path, void *inputs)
+{
+    DArrayAdd(inputs, strdup(path));
+}
+
+static void AddExpandedInput(DArray *inputs, const char *path)
+{
+    char expanded_path[512];
+    if (ExpandPath(expanded_path, path, sizeof(expanded_path)) == 0)
+    {
+        AddInput(expanded_path, inputs);
+    }
+}
+
+static void AddDesktopFileInputs(DArray *inputs, const char *dir_path)
+{
+    char path[1024];
+
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL)
+        return;
+
+    struct dirent *dirp;
+    while ((dirp = readdir(dir)) != NULL)
+    {
+        char *ext = strrchr(dirp->d_name, '.');
+        if (ext && strcmp(ext, ".desktop") == 0)
+        {
+            snprintf(path, sizeof(path), "%s%s", dir_path, dirp->d_name);
+            AddInput(path, inputs);
+        }
+    }
+
+    closedir(dir);
+}
+
+void HelperAddInputs(DArray *inputs)
+{
+    AddExpandedInput(inputs, JWMS_USER_CONFIG_DIR JWMS_CONFIG_NAME);
+    AddExpandedInput(inputs, JWMS_SYSTEM_CONFIG_DIR JWMS_CONFIG_NAME);
+    AddExpandedInput(inputs, "~/.gtkrc-2.0");
+
+    char user_app_dir_buffer[512];
+    AddDesktopFileInputs(inputs, default_app_dir);
+    if (ExpandPath(user_app_dir_buffer, user_app_dir, sizeof(user_app_dir_buffer)) == 0)
+        AddDesktopFileInputs(inputs, user_app_dir_buffer);
+}
+
+static void AddIconInput(const char *name, const char *path, void *inputs)
+{
+    (void)name;
+    AddInput(path, inputs);
+}
+
+// The file execvp would run for the first word of program
+static void AddProgramInput(DArray *inputs, const char *program)
+{
+    char name[256];
+    strlcpy(name, program, sizeof(name));
+    name[strcspn(name, " \t")] = '\0';
+
+    if (name[0] == '\0')
+        return;
+
+    if (strchr(name, '/') != NULL)
+    {
+        AddExpandedInput(inputs, name);
+        return;
+    }
+
+    const char *dirs = getenv("PATH");
+    char path[1024];
+
+    while (dirs != NULL && *dirs != '\0')
+    {
+        size_t len = strcspn(dirs, ":");
+        snprintf(path, sizeof(path), "%.*s/%s", (int)len, dirs, name);
+
+        if (len > 0 && access(path, X_OK) == 0)
+        {
+            AddInput(path, inputs);
+            return;
+        }
+
+        dirs += len;
+        if (*dirs == ':')
+            dirs++;
+    }
+}
+
+// What the next login reads, jwms reads it ahead while the session starts
+static void SaveReadaheadList(JWM *jwm, cfg_t *cfg, HashMap *icons)
+{
+    char path[512];
+    DArray *inputs = DArrayCreate(256, free, NULL, NULL);
+
+    HelperAddInputs(inputs);
+    IconThemesForEachPath(AddInput, inputs);
+
+    if (icons != NULL)
+        HashMapForEach(icons, AddIconInput, inputs);
+
+    for (int i = 0; i < NumGenerators; i++)
+    {
+        GetOutputPath(jwm, i, path, sizeof(path));
+        AddInput(path, inputs);
+    }
+
+    AddProgramInput(inputs, "jwm");
+    AddProgramInput(inputs, "jwm-helper");
+
+    for (unsigned int i = 0; i < cfg_size(cfg, "autostart"); i++)
+    {
+        const char *program = cfg_getstr(cfg_getnsec(cfg, "autostart", i), "program");
+        if (program != NULL)
+            AddProgramInput(inputs, program);
+    }
+
+    if (ExpandPath(path, READAHEAD_LIST_PATH, sizeof(path)) == 0)
+        ReadaheadWrite(path, (char**)inputs->data, inputs->size);
+
+    DArrayDestroy(inputs);
+}
+
+static int LoadIcons(JWM *jwm, EntryStore *entries, HashMap **icons)
+{
+    TRACE_SCOPE("load icons");
+
+    printf("Loading icons...\n");
+
+    *icons = FindAllIcons(entries, jwm->global_preferred_icon_size, 1);
+    if (*icons == NULL)
+    {
+        printf("Failed to load icons!\n");
+        return -1;
+    }
+
+    printf("Finished loading icons\n");
+    //HashMapPrint(*icons);
+    return 0;
+}
+
+static void QueueEntryIcon(void *entry_ptr, void *pipeline_ptr)
+{
+    XDGDesktopEntry *entry = entry_ptr;
+    IconPipeline *pipeline = pipeline_ptr;
+
+    pthread_mutex_lock(&pipeline->lock);
+    DArrayAdd(pipeline->icon_names, entry->icon);
+    pthread_cond_signal(&pipeline->icons_queued);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+// Loads and indexes the icon themes, then resolves the queued icon names as the entries get parsed
+static void *IconPipelineThread(void *ptr)
+{
+    IconPipeline *pipeline = ptr;
+
+    TRACE_SCOPE("icon pipeline");
+
+    if (LoadCurrentIconThemes() != 0)
+    {
+        pipeline->result = -1;
+        return NULL;
+    }
+
+    IndexIconThemes(pipeline->size, 1);
+
+    pthread_mutex_lock(&pipeline->lock);
+
+    while (true)
+    {
+        while (pipeline->next_icon == pipeline->icon_names->size && !pipeline->entries_done)
+        {
+            pthread_cond_wait(&pipeline->icons_queued, &pipeline->lock);
+        }
+
+        if (pipeline->next_icon == pipeline->icon_names->size)
+            break;
+
+        const char *icon = pipeline->icon_names->data[pipeline->next_icon++];
+
+        pthread_mutex_unlock(&pipeline->lock);
+
+        // Several entries can share the same icon
+        if (HashMapGet(pipeline->icons, icon) == NULL)
+            ResolveIcon(pipeline->icons, icon, pipeline->size, 1);
+
+        pthread_mutex_lock(&pipeline->lock);
+    }
+
+    pthread_mutex_unlock(&pipeline->lock);
+
+    ResolveExtraIcons(pipeline->icons, pipeline->size, 1);
+    pipeline->result = 0;
+    return NULL;
+}
+
+// Theme loading and indexing don't depend on the desktop entries, so they run while the entries get parsed
+static int LoadEntriesAndIconsPipelined(JWM *jwm, EntryStore **entries, HashMap **icons)
+{
+    TRACE_SCOPE("load entries and icons");
+
+    IconPipeline pipeline =
+    {
+        .size = jwm->global_preferred_icon_size,
+        .icons = HashMapCreate(),
+        .icon_names = DArrayCreate(256, NULL, NULL, NULL),
+        .next_icon = 0,
+        .entries_done = false,
+        .result = -1,
+    };
+
+    pipeline.icons->stats_group = ResolvedIconsMapStats;
+
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.icons_queued, NULL);
+
+    printf("Loading icons...\n");
+
+    pthread_t icon_thread;
+    if (pthread_create(&icon_thread, NULL, IconPipelineThread, &pipeline) != 0)
+    {
+        fprintf(stderr, "Failed to create the icon loading thread\n");
+        pthread_mutex_destroy(&pipeline.lock);
+        pthread_cond_destroy(&pipeline.icons_queued);
+        DArrayDestroy(pipeline.icon_names);
+        HashMapDestroy(pipeline.icons);
+        return -1;
+    }
+
+    int entries_result = LoadAllDesktopEntries(entries, QueueEntryIcon, &pipeline);
+
+    pthread_mutex_lock(&pipeline.lock);
+    pipeline.entries_done = true;
+    pthread_cond_signal(&pipeline.icons_queued);
+    pthread_mutex_unlock(&pipeline.lock);
+
+    pthread_join(icon_thread, NULL);
+
+    pthread_mutex_destroy(&pipeline.lock);
+    pthread_cond_destroy(&pipeline.icons_queued);
+    DArrayDestroy(pipeline.icon_names);
+
+    // The generators want the entries in name order
+    EntriesSort(*entries);
+
+    if (pipeline.result != 0)
+    {
+        printf("Failed to load icons!\n");
+        HashMapDestroy(pipeline.icons);
+        return -1;
+    }
+
+    // The icon themes are loaded either way and get destroyed along with the icons
+    *icons = pipeline.icons;
+
+    if (entries_result != 0)
+    {
+        return -1;
+    }
+
+    printf("Finished loading icons\n");
+    return 0;
+}
+
+int HelperLoadEntries(Helper *helper)
+{
+    if (helper->entries != NULL)
+        return 0;
+
+    TRACE_SCOPE("load entries");
+
+    helper->icons_current = false;
+
+    if (LoadAllDesktopEntries(&helper->entries, NULL, NULL) != 0)
+        return -1;
+
+    EntriesSort(helper->entries);
+    return 0;
+}
+
+// Entries added since the icons were resolved, after a reload, only get their own icons looked up
+static void ResolveEntryIcon(void *entry_ptr, void *helper_ptr)
+{
+    XDGDesktopEntry *entry = entry_ptr;
+    Helper *helper = helper_ptr;
+
+    if (HashMapGet(helper->icons, entry->icon) == NULL)
+        ResolveIcon(helper->icons, entry->icon, helper->jwm->global_preferred_icon_size, 1);
+}
+
+static void RememberIconThemes(Helper *helper)
+{
+    helper->icon_theme[0] = '\0';
+    GetCurrentGTKIconThemeName(helper->icon_theme);
+
+    FingerprintDestroy(helper->icon_dirs);
+    helper->icon_dirs = FingerprintCreate();
+    IconThemesForEachPath(AddFingerprintPath, helper->icon_dirs);
+}
+
+static int LoadEntriesAndIcons(Helper *helper)
+{
+    if (helper->entries == NULL && helper->icons == NULL)
+    {
+        if (LoadEntriesAndIconsPipelined(helper->jwm, &helper->entries, &helper->icons) != 0)
+            return -1;
+    }
+    else if (HelperLoadEntries(helper) != 0)
+    {
+        return -1;
+    }
+    else if (helper->icons == NULL)
+    {
+        if (LoadIcons(helper->jwm, helper->entries, &helper->icons) != 0)
+            return -1;
+    }
+    else if (!helper->icons_current)
+    {
+        TRACE_SCOPE("resolve new icons");
+
+        EntriesForEach(helper->entries, ResolveEntryIcon, helper);
+        helper->icons_current = true;
+        return 0;
+    }
+    else
+    {
+        return 0;
+    }
+
+    helper->icons_current = true;
+    RememberIconThemes(helper);
+    return 0;
+}
+
+static int RunGenerator(GeneratorType type, JWM *jwm, cfg_t *cfg, EntryStore *entries, HashMap *icons)
+{
+    TRACE_SCOPE_FMT("generate %s", generator_names[type]);
+
+    switch (type)
+    {
+        case StartupGenerator:
+            return CreateJWMStartup(jwm);
+        case GroupGenerator:
+            return CreateJWMGroup(jwm);
+        case TrayGenerator:
+            return CreateJWMTray(jwm, entries, icons);
+        case RootMenuGenerator:
+            return CreateJWMRootMenu(jwm, entries, icons, NULL);
+        case StylesGenerator:
+            return CreateJWMStyles(jwm);
+        case PreferencesGenerator:
+            return CreateJWMPreferences(jwm);
+        case IconsGenerator:
+            return CreateJWMIcons(jwm);
+        case BindsGenerator:
+            return CreateJWMBinds(jwm, cfg);
+        case AutoStartGenerator:
+            return CreateJWMAutoStart(jwm, cfg);
+        case RCFileGenerator:
+            return CreateJWMRCFile(jwm);
+        default:
+            return -1;
+    }
+}
+
+static bool GeneratorNeedsEntries(GeneratorType type)
+{
+    return type == TrayGenerator || type == RootMenuGenerator;
+}
+
+static bool OutputsNeedEntries(unsigned int outputs)
+{
+    return (outputs & (HELPER_OUTPUT(TrayGenerator) | HELPER_OUTPUT(RootMenuGenerator))) != 0;
+}
+
+static int GenerateSequential(Helper *helper, unsigned int outputs)
+{
+    if (OutputsNeedEntries(outputs) && LoadEntriesAndIcons(helper) != 0)
+        return -1;
+
+    for (int i = 0; i < NumGenerators; i++)
+    {
+        if ((outputs & HELPER_OUTPUT(i)) == 0)
+            continue;
+
+        if (RunGenerator(i, helper->jwm, helper->cfg, helper->entries, helper->icons) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static void RunGeneratorTask(void *ptr)
+{
+    GeneratorTask *task = ptr;
+    task->result = RunGenerator(task->type, task->jwm, task->cfg, task->entries, task->icons);
+}
+
+// The generators that only need the config start right away and overlap with loading the entries and icons.
+// Once loaded, entries and icons are only read by the tray and menu generators, with one exception:
+// the tray resolves a few extra icons through the icon themes, which it is the only generator to touch.
+static int GenerateParallel(Helper *helper, unsigned int outputs)
+{
+    ThreadPool *pool = ThreadPoolCreate(helper->jobs);
+    if (pool == NULL)
+    {
+        return -1;
+    }
+
+    GeneratorTask tasks[NumGenerators];
+
+    for (int i = 0; i < NumGenerators; i++)
+    {
+        tasks[i].type = i;
+        tasks[i].jwm = helper->jwm;
+        tasks[i].cfg = helper->cfg;
+        tasks[i].entries = NULL;
+        tasks[i].icons = NULL;
+        // Generators that weren't asked for count as done
+        tasks[i].result = (outputs & HELPER_OUTPUT(i)) != 0 ? -1 : 0;
+
+        if ((outputs & HELPER_OUTPUT(i)) != 0 && !GeneratorNeedsEntries(i))
+            ThreadPoolSubmit(pool, RunGeneratorTask, &tasks[i]);
+    }
+
+    int ret = 0;
+
+    if (OutputsNeedEntries(outputs) && LoadEntriesAndIcons(helper) != 0)
+    {
+        ret = -1;
+    }
+    else
+    {
+        for (int i = 0; i < NumGenerators; i++)
+        {
+            if ((outputs & HELPER_OUTPUT(i)) == 0 || !GeneratorNeedsEntries(i))
+                continue;
+
+            tasks[i].entries = helper->entries;
+            tasks[i].icons = helper->icons;
+            ThreadPoolSubmit(pool, RunGeneratorTask, &tasks[i]);
+        }
+    }
+
+    ThreadPoolWait(pool);
+    ThreadPoolDestroy(pool);
+
+    if (ret != 0)
+        return ret;
+
+    // Report failures in the same order as the sequential mode would run into them
+    for (int i = 0; i < NumGenerators; i++)
+    {
+        if (tasks[i].result != 0)
+        {
+            printf("Failed to generate %s!\n", generator_names[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void SnapshotOutputs(JWM *jwm, OutputId outputs[NumGenerators])
+{
+    char path[512];
+    struct stat st;
+
+    for (int i = 0; i < NumGenerators; i++)
+    {
+        GetOutputPath(jwm, i, path, sizeof(path));
+        outputs[i].exists = stat(path, &st) == 0;
+        outputs[i].dev = outputs[i].exists ? st.st_dev : 0;
+        outputs[i].ino = outputs[i].exists ? st.st_ino : 0;
+    }
+}
+
+// Outputs are only replaced when their contents change, so a new inode means new contents
+static HelperStatus ReportChanges(JWM *jwm, const OutputId before[NumGenerators])
+{
+    OutputId after[NumGenerators];
+    HelperStatus status = HelperUnchanged;
+
+    SnapshotOutputs(jwm, after);
+
+    for (int i = 0; i < NumGenerators; i++)
+    {
+        if (before[i].exists == after[i].exists && before[i].dev == after[i].dev && before[i].ino == after[i].ino)
+            continue;
+
+        printf("Changed: %s\n", generator_names[i]);
+
+        // The autostart script only runs when JWM starts, a restart would not run it again
+        if (i == AutoStartGenerator)
+            continue;
+
+        if (i == RootMenuGenerator)
+            status = MAX(status, HelperReloadMenu);
+        else
+            status = HelperRestart;
+    }
+
+    return status;
+}
+
+static void UnloadConfig(Helper *helper)
+{
+    if (helper->jwm != NULL)
+    {
+        free(helper->jwm->autogen_config_path);
+        free(helper->jwm->jwmrc_path);
+        free(helper->jwm);
+        helper->jwm = NULL;
+    }
+
+    if (helper->cfg != NULL)
+    {
+        cfg_free(helper->cfg);
+        helper->cfg = NULL;
+    }
+}
+
+static void UnloadEntries(Helper *helper)
+{
+    if (helper->entries != NULL)
+    {
+        EntriesDestroy(helper->entries);
+        helper->entries = NULL;
+    }
+
+    helper->icons_current = false;
+}
+
+// The icon themes get loaded along with the icons, a failed load can leave them behind without any icons
+static void UnloadIcons(Helper *helper)
+{
+    DestroyIconThemes();
+
+    if (helper->icons != NULL)
+    {
+        HashMapDestroy(helper->icons);
+        helper->icons = NULL;
+    }
+
+    if (helper->sized_icons != NULL)
+    {
+        HashMapDestroy(helper->sized_icons);
+        helper->sized_icons = NULL;
+    }
+
+    if (helper->missing_icons != NULL)
+    {
+        HashMapDestroy(helper->missing_icons);
+        helper->missing_icons = NULL;
+    }
+
+    FingerprintDestroy(helper->icon_dirs);
+    helper->icon_dirs = NULL;
+    helper->icons_current = false;
+}
+
+// A different GTK theme, or an icon added to or removed from one of the loaded themes, means resolving
+// every icon again
+static void CheckIconThemes(Helper *helper)
+{
+    if (helper->icons == NULL)
+        return;
+
+    char theme[256] = "\0";
+    if (GetCurrentGTKIconThemeName(theme) != 0 || strcmp(theme, helper->icon_theme) != 0 ||
+        !FingerprintUnchanged(helper->icon_dirs))
+    {
+        UnloadIcons(helper);
+    }
+}
+
+// Something changed since the last run, only the icon themes can be trusted to still be the same
+static void ReloadInputs(Helper *helper)
+{
+    UnloadConfig(helper);
+    UnloadEntries(helper);
+    CheckIconThemes(helper);
+    helper->all_generated = false;
+
+    FingerprintDestroy(helper->config_inputs);
+    FingerprintDestroy(helper->app_dirs);
+    helper->config_inputs = FingerprintConfigInputs(FingerprintCreate());
+    helper->app_dirs = FingerprintAppDirs(FingerprintCreate());
+}
+
+Helper *HelperCreate(int jobs, const char *output_dir)
+{
+    Helper *helper = calloc(1, sizeof(*helper));
+    if (helper == NULL)
+        return NULL;
+
+    helper->jobs = jobs;
+    helper->output_dir = output_dir;
+    return helper;
+}
+
+void HelperSetNativeAutostart(Helper *helper, bool native_autostart)
+{
+    helper->native_autostart = native_autostart;
+}
+
+int HelperLoadConfig(Helper *helper)
+{
+    if (helper->cfg != NULL && helper->jwm != NULL)
+    {
+        return 0;
+    }
+
+    TRACE_SCOPE("config load");
+
+    UnloadConfig(helper);
+
+    if (LoadJWMConfig(&helper->jwm, &helper->cfg) != 0)
+    {
+        printf("Failed to properly load the jwms.conf file! Aborting!\n");
+        return -1;
+    }
+
+    // Without jwms nobody but JWM starts the autostart programs
+    if (!helper->native_autostart)
+        helper->jwm->global_native_autostart = false;
+
+    if (CreateJWMFolder(helper->jwm, helper->output_dir) != 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Loading the entries and the icon themes overlap when neither is loaded yet
+int HelperResolveIcons(Helper *helper)
+{
+    if (HelperLoadConfig(helper) != 0)
+        return -1;
+
+    return LoadEntriesAndIcons(helper);
+}
+
+int HelperGenerate(Helper *helper, unsigned int outputs)
+{
+    if (HelperLoadConfig(helper) != 0)
+        return -1;
+
+    if (helper->jobs > 1)
+        return GenerateParallel(helper, outputs);
+
+    return GenerateSequential(helper, outputs);
+}
+
+int HelperSnapshotOutputs(Helper *helper)
+{
+    if (HelperLoadConfig(helper) != 0)
+        return -1;
+
+    SnapshotOutputs(helper->jwm, helper->outputs);
+    helper->outputs_snapshot = true;
+    return 0;
+}
+
+HelperStatus HelperReportChanges(Helper *helper)
+{
+    if (!helper->outputs_snapshot || helper->jwm == NULL)
+        return HelperUnchanged;
+
+    // The next run compares against what it finds then
+    helper->outputs_snapshot = false;
+    return ReportChanges(helper->jwm, helper->outputs);
+}
+
+HelperStatus HelperGenerateAll(Helper *helper, bool force)
+{
+    char fingerprint_path[512];
+    char fingerprint_key[1024];
+
+    long long check_start = TRACE_NOW();
+    GetFingerprintPath(fingerprint_path, sizeof(fingerprint_path));
+    GetFingerprintKey(helper, fingerprint_key, sizeof(fingerprint_key));
+    bool unchanged = !force && FingerprintMatches(fingerprint_path, fingerprint_key);
+    TRACE_EVENT("fingerprint check", check_start, TRACE_NOW());
+
+    if (unchanged)
+    {
+        printf("No changes since the last run, nothing to generate\n");
+        helper->outputs_snapshot = false;
+        return HelperUnchanged;
+    }
+
+    Fingerprint *fingerprint = FingerprintInputs();
+    ReloadInputs(helper);
+
+    if ((!helper->outputs_snapshot && HelperSnapshotOutputs(helper) != 0) ||
+        HelperGenerate(helper, HELPER_ALL_OUTPUTS) != 0)
+    {
+        // Whatever was written so far no longer matches the last fingerprint
+        unlink(fingerprint_path);
+        FingerprintDestroy(fingerprint);
+        helper->outputs_snapshot = false;
+        return HelperFailed;
+    }
+
+    SaveFingerprint(helper, fingerprint);
+    SaveReadaheadList(helper->jwm, helper->cfg, helper->icons);
+    FingerprintDestroy(fingerprint);
+    helper->all_generated = true;
+
+    return HelperReportChanges(helper);
+}
+
+GeneratorType HelperFindGenerator(const char *name)
+{
+    for (int i = 0; i < NumGenerators; i++)
+    {
+        // .jwmrc can be asked for without the dot
+        const char *file_name = generator_names[i];
+        if (strcmp(name, file_name) == 0 || (file_name[0] == '.' && strcmp(name, file_name + 1) == 0))
+            return i;
+    }
+
+    return NumGenerators;
+}
+
+void HelperRefresh(Helper *helper)
+{
+    if (helper->config_inputs == NULL || !FingerprintUnchanged(helper->config_inputs) ||
+        !FingerprintUnchanged(helper->app_dirs))
+    {
+        ReloadInputs(helper);
+    }
+    else
+    {
+        // The icons are looked up without the entries changing, a changed theme has to be noticed too
+        CheckIconThemes(helper);
+    }
+}
+
+void HelperForEachAppDir(void (*Func)(const char *path, void *args), void *args)
+{
+    Func(default_app_dir, args);
+
+    // The same path LoadAllDesktopEntries reads
+    char user_app_dir_buffer[512];
+    ExpandPath(user_app_dir_buffer, user_app_dir, sizeof(user_app_dir_buffer));
+    Func(user_app_dir_buffer, args);
+}
+
+// Only the menu and the tray are made from the entries, every other output stays as the last --all wrote it
+HelperStatus HelperUpdateEntries(Helper *helper, char **paths, size_t num_paths)
+{
+    TRACE_SCOPE("update entries");
+
+    // Taken before the files are read, like --all does
+    Fingerprint *fingerprint = FingerprintInputs();
+
+    // The config or the GTK theme changing as well needs a full run, and so does a session that hasn't
+    // loaded anything yet. Once the updates took up as much of the arena as the load did, reading
+    // everything again gives back the space of the entries they left behind.
+    if (!helper->all_generated || helper->entries == NULL || helper->icons == NULL ||
+        helper->entries->arena.used - helper->entries->loaded_size > helper->entries->loaded_size ||
+        !FingerprintUnchanged(helper->config_inputs))
+    {
+        FingerprintDestroy(fingerprint);
+        return HelperGenerateAll(helper, true);
+    }
+
+    int preferred_size = helper->jwm->global_preferred_icon_size;
+
+    // Icons that came with the new desktop files are only found in a fresh index
+    DropChangedIconDirs();
+
+    for (size_t i = 0; i < num_paths; i++)
+    {
+        XDGDesktopEntry *removed = EntryRemovePath(helper->entries, paths[i]);
+
+        XDGDesktopEntry *entry = NULL;
+        if (access(paths[i], F_OK) == 0)
+            entry = ReadDesktopEntry(paths[i], &helper->entries->arena);
+
+        int inserted = entry != NULL ? EntryInsert(helper->entries, entry) : -1;
+
+        // Which of the files with the same name wins is up to the order of the directories, only a full
+        // run gets that right
+        bool same_name = inserted == 0 && removed != NULL && strcmp(removed->name, entry->name) == 0;
+        if (inserted == 1 || (removed != NULL && removed->shadows && !same_name))
+        {
+            FingerprintDestroy(fingerprint);
+            return HelperGenerateAll(helper, true);
+        }
+
+        if (inserted == 0)
+        {
+            entry->shadows = same_name && removed->shadows;
+            printf("%s %s\n", removed != NULL ? "Updated" : "Added", entry->name);
+
+            if (HashMapGet(helper->icons, entry->icon) == NULL)
+                ResolveIcon(helper->icons, entry->icon, preferred_size, 1);
+        }
+        else if (removed != NULL)
+        {
+            printf("Removed %s\n", paths[i]);
+        }
+    }
+
+    FingerprintDestroy(helper->app_dirs);
+    helper->app_dirs = FingerprintAppDirs(FingerprintCreate());
+    RememberIconThemes(helper);
+
+    unsigned int outputs = HELPER_OUTPUT(RootMenuGenerator) | HELPER_OUTPUT(TrayGenerator);
+    if (HelperSnapshotOutputs(helper) != 0 || HelperGenerate(helper, outputs) != 0)
+    {
+        // The next update starts over with --all
+        helper->all_generated = false;
+        HelperReportChanges(helper);
+        FingerprintDestroy(fingerprint);
+        return HelperFailed;
+    }
+
+    // The next login can still skip the generators
+    SaveFingerprint(helper, fingerprint);
+    SaveReadaheadList(helper->jwm, helper->cfg, helper->icons);
+    FingerprintDestroy(fingerprint);
+
+    return HelperReportChanges(helper);
+}
+
+// A client can ask for any number of names, the caches start over once they hold this many
+#define LOOKUP_CACHE_MAX 4096
+
+static void CacheLookup(HashMap **cache, const char *key, const char *path)
+{
+    if (*cache != NULL && (*cache)->table.size >= LOOKUP_CACHE_MAX)
+    {
+        HashMapDestroy(*cache);
+        *cache = NULL;
+    }
+
+    if (*cache == NULL)
+    {
+        *cache = HashMapCreate();
+        (*cache)->stats_group = ResolvedIconsMapStats;
+    }
+
+    HashMapInsert(*cache, key, path);
+}
+
+const char *HelperLookupIcon(Helper *helper, const char *name, int size)
+{
+    if (HelperResolveIcons(helper) != 0)
+        return NULL;
+
+    int preferred_size = helper->jwm->global_preferred_icon_size;
+    if (size <= 0)
+        size = preferred_size;
+
+    // The icons of the entries and the menu were resolved up front
+    if (size == preferred_size)
+    {
+        const char *path = HashMapGet(helper->icons, name);
+        if (path != NULL)
+            return path;
+    }
+
+    // A cut off key could answer for another name
+    char key[512];
+    if (snprintf(key, sizeof(key), "%d/%s", size, name) >= (int)sizeof(key))
+        return NULL;
+
+    if (helper->missing_icons != NULL && HashMapGet(helper->missing_icons, key) != NULL)
+        return NULL;
+
+    const char *path = helper->sized_icons != NULL ? HashMapGet(helper->sized_icons, key) : NULL;
+    if (path != NULL)
+        return path;
+
+    char *filename = SearchIconInThemes(name, size, 1, 3);
+    if (filename == NULL)
+    {
+        CacheLookup(&helper->missing_icons, key, "");
+        return NULL;
+    }
+
+    CacheLookup(&helper->sized_icons, key, filename);
+    free(filename);
+    return HashMapGet(helper->sized_icons, key);
+}
+
+typedef struct
+{
+    HashMap *icons;
+    const char *category;
+    void (*Func)(const char *name, const char *exec, const char *icon, void *args);
+    void *args;
+    int count;
+} ListArgs;
+
+static void ListEntry(void *entry_ptr, void *args_ptr)
+{
+    XDGDesktopEntry *entry = entry_ptr;
+    ListArgs *args = args_ptr;
+
+    for (Node *node = entry->categories->head; node != NULL; node = node->next)
+    {
+        if (strcmp(node->data, args->category) == 0)
+        {
+            const char *icon = HashMapGet(args->icons, entry->icon);
+            args->Func(entry->name, entry->exec, icon != NULL ? icon : entry->icon, args->args);
+            args->count++;
+            return;
+        }
+    }
+}
+
+int HelperListCategory(Helper *helper, const char *category,
+                       void (*Func)(const char *name, const char *exec, const char *icon, void *args), void *args)
+{
+    if (HelperResolveIcons(helper) != 0)
+        return -1;
+
+    ListArgs list_args =
+    {
+        .icons = helper->icons,
+        .category = category,
+        .Func = Func,
+        .args = args,
+        .count = 0,
+    };
+
+    EntriesForEach(helper->entries, ListEntry, &list_args);
+    return list_args.count;
+}
+
+void HelperDestroy(Helper *helper)
+{
+    if (helper == NULL)
+        return;
+
+    UnloadIcons(helper);
+    UnloadEntries(helper);
+    // Nothing that points at an interned string is left
+    InternDestroy();
+    UnloadConfig(helper);
+    FingerprintDestroy(helper->config_inputs);
+    FingerprintDestroy(helper->app_dirs);
+    free(helper);
+}
@@ -0,0 +1,78 @@
+#ifndef HELPER_H
+#define HELPER_H
+
+// The generators of jwm-helper as a library, libjwmhelper.a. The jwm-helper command line and jwms both run
+// them through a Helper, which keeps what it loaded for the next run in the same process: the config and
+// the desktop entries are read again, the icon themes stay loaded and indexed while the theme and its
+// directories stay the same, and an icon that was resolved once doesn't get looked up again.
+//
+// Needs darray.h and helper_status.h
+
+#define HELPER_VERSION "v0.2"
+
+typedef enum
+{
+    StartupGenerator,
+    GroupGenerator,
+    TrayGenerator,
+    RootMenuGenerator,
+    StylesGenerator,
+    PreferencesGenerator,
+    IconsGenerator,
+    BindsGenerator,
+    AutoStartGenerator,
+    RCFileGenerator,
+    NumGenerators
+} GeneratorType;
+
+// Bit masks of GeneratorType for HelperGenerate
+#define HELPER_OUTPUT(type) (1u << (type))
+#define HELPER_ALL_OUTPUTS (HELPER_OUTPUT(NumGenerators) - 1)
+
+typedef struct Helper Helper;
+
+// JWMS_APP_DIR and JWMS_ICON_DIR point the generators at a different tree, like --app-dir and --icon-dir.
+// -1 when a path is too long, the directory it was meant for stays as it was.
+int HelperReadEnvironment(void);
+int HelperSetAppDir(const char *path);
+
+// jobs > 1 runs the generators on that many threads. The outputs go to output_dir when it isn't NULL,
+// the fingerprint and the readahead list are only written for the paths in jwms.conf.
+Helper *HelperCreate(int jobs, const char *output_dir);
+// For jwms: the startup file leaves the autostart programs out when global_native_autostart is on. Off by
+// default, JWM runs the generated autostart script.
+void HelperSetNativeAutostart(Helper *helper, bool native_autostart);
+// Every call below loads what it needs and isn't loaded yet
+int HelperLoadConfig(Helper *helper);
+int HelperLoadEntries(Helper *helper);
+int HelperResolveIcons(Helper *helper);
+int HelperGenerate(Helper *helper, unsigned int outputs);
+// Remembers the outputs as they are, HelperReportChanges compares them against this
+int HelperSnapshotOutputs(Helper *helper);
+HelperStatus HelperReportChanges(Helper *helper);
+// --all: reloads the config and the entries, generates every output and reports what changed for JWM.
+// Without force nothing is done when none of the inputs changed since the last run.
+HelperStatus HelperGenerateAll(Helper *helper, bool force);
+// The config and desktop files every run reads
+void HelperAddInputs(DArray *inputs);
+// The generator writing the output file name (menu, tray, .jwmrc, ...), NumGenerators if there is none
+GeneratorType HelperFindGenerator(const char *name);
+// For a Helper that stays around: drops the config and the entries when one of the inputs changed since
+// they were loaded, and the icons when the theme did
+void HelperRefresh(Helper *helper);
+// The path of an icon at size, size <= 0 is global_preferred_icon_size. NULL if no loaded theme has it,
+// the path stays valid until the next lookup or until the icons get reloaded.
+const char *HelperLookupIcon(Helper *helper, const char *name, int size);
+// Calls Func with the directories the desktop entries are read from, ending in a slash
+void HelperForEachAppDir(void (*Func)(const char *path, void *args), void *args);
+// Patches the loaded entries with the desktop files that were added, changed or removed, resolves the icons
+// of the names that are new and writes the menu and the tray again. Falls back to --all when anything else
+// changed or the last --all didn't load the entries.
+HelperStatus HelperUpdateEntries(Helper *helper, char **paths, size_t num_paths);
+// Calls Func with the name, the command and the resolved icon of every entry in the main category,
+// returns how many there were or -1
+int HelperListCategory(Helper *helper, const char *category,
+                       void (*Func)(const char *name, const char *exec, const char *icon, void *args), void *args);
+void HelperDestroy(Helper *helper);
+
+#endif
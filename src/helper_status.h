@@ -0,0 +1,15 @@
+#ifndef HELPER_STATUS_H
+#define HELPER_STATUS_H
+
+// Exit statuses of "jwm-helper --report-changes", they tell jwms what a running JWM needs to catch up
+typedef enum
+{
+    HelperUnchanged = 0,
+    HelperFailed = 1,
+    // Only the root menu changed, "jwm -reload" rereads it
+    HelperReloadMenu = 3,
+    // Anything else JWM reads needs "jwm -restart"
+    HelperRestart = 4
+} HelperStatus;
+
+#endif
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <ctype.h>
 
 #include <limits.h>
@@ -11,16 +12,21 @@
 #include <errno.h>
 #include <libgen.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 
 #include <bsd/string.h>
 
-#include "bstree.h"
+#include "containers.h"
+#include "arena.h"
 #include "hashing.h"
+#include "intern.h"
 #include "darray.h"
 #include "common.h"
 #include "list.h"
 #include "desktop_entries.h"
 #include "icons.h"
+#include "trace.h"
+#include "stats.h"
 
 // If enabled, all nested children icon themes get searched
 // If not it will only search two themes, the parent theme, and the default "hicolor" theme
@@ -30,12 +36,33 @@
 // If you have a really slow hard drive you may want to lower this
 #define MAX_FILES_TO_INDEX_PER_DIR 250
 
+// Chunk size of the arena each theme keeps its strings in
+#define THEME_ARENA_CHUNK_SIZE (16 * 1024)
+
 #define MULTIPHASE_ICON_SEARCH
 //#define HYBRID_ICON_SEARCH
 
-static HashMap2 *themes_map = NULL;
-// Keys for fast searching of themes_map
-static DArray *themes_names = NULL;
+// Where the icon themes are installed, can be changed to point at a different tree
+static char icon_base_dir[128] = "/usr/share/icons";
+
+static inline uint32_t ThemeNameHash(const char *name)
+{
+    uint64_t hash = HashBytes(name, strlen(name));
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static inline bool ThemeNameEquals(const char *name_a, const char *name_b)
+{
+    return strcmp(name_a, name_b) == 0;
+}
+
+// Keyed by the name each theme owns
+MAP_DEFINE(ThemeMap, const char*, IconTheme*, ThemeNameHash, ThemeNameEquals)
+
+static ThemeMap themes_map;
+// The loaded themes in search order
+static StrVec themes_names;
+static bool themes_loaded = false;
 
 static const char *extra_icons[] =
 {
@@ -137,27 +164,30 @@ static void ParseInheritedThemes(IconTheme *theme, const char *inherits)
     return;
 #endif
 
-    char *str_copy = strdup(inherits);
+    // A list cut in the middle of a name would make it look for a theme that doesn't exist
+    char str_copy[512];
+    if (strlcpy(str_copy, inherits, sizeof(str_copy)) >= sizeof(str_copy))
+    {
+        fprintf(stderr, "Inherits of %s too long, skipping it: %s\n", theme->name, inherits);
+        return;
+    }
 
     char *reserved;
     char *theme_name = strtok_r(str_copy, ",", &reserved);
     while (theme_name != NULL)
     {
         DEBUG_LOG("Found inherited theme: %s\n", theme_name);
-        DArrayAdd(theme->parents, strdup(theme_name));
+        StrVecPush(&theme->parents, ArenaStrdup(&theme->arena, theme_name));
         theme_name = strtok_r(NULL, ",", &reserved);
     }
-    free(str_copy);
 }
 
+static void IconDestroy(XDGIconDir *icon_dir);
+
 static void ParseThemeIcons(IconTheme *theme)
 {
     char path[512];
-    const char *base = "/usr/share/icons/";
-
-    strlcpy(path, base, sizeof(path));
-    strlcat(path, theme->name, sizeof(path));
-    strlcat(path, "/index.theme", sizeof(path));
+    snprintf(path, sizeof(path), "%s/%s/index.theme", icon_base_dir, theme->name);
 
     FILE *fp = fopen(path, "r");
     if (fp == NULL)
@@ -254,10 +284,11 @@ static void ParseThemeIcons(IconTheme *theme)
             }
             else
             {
-                XDGIconDir *icon = IconCreate(section, type, context, size, min_size, max_size, scale, threshold);
-                if (icon != NULL)
+                XDGIconDir icon_dir;
+                if (IconInit(&icon_dir, section, type, context, size, min_size, max_size, scale, threshold) == 0 &&
+                    IconDirVecPush(&theme->icon_dirs, icon_dir) != 0)
                 {
-                    DArrayAdd(theme->icon_dirs, icon);
+                    IconDestroy(&icon_dir);
                 }
 
                 scale = 1;
@@ -274,10 +305,41 @@ static void ParseThemeIcons(IconTheme *theme)
     fclose(fp);
 }
 
-XDGIconDir *IconCreate(const char *path, IconType type, IconContext context, int size, int min_size, int max_size, int scale, int threshold)
+// A path that doesn't fit is refused, a cut off one would be a different directory
+int SetIconBaseDir(const char *path)
+{
+    if (path[0] == '\0')
+        return 0;
+
+    if (strlen(path) >= sizeof(icon_base_dir))
+    {
+        printf("Icon directory too long: %s\n", path);
+        return -1;
+    }
+
+    strlcpy(icon_base_dir, path, sizeof(icon_base_dir));
+
+    // The theme paths get built with a separator of their own
+    size_t len = strlen(icon_base_dir);
+    while (len > 1 && icon_base_dir[len - 1] == '/')
+        icon_base_dir[--len] = '\0';
+
+    return 0;
+}
+
+const char *GetIconBaseDir(void)
 {
-    XDGIconDir *icon_dir = malloc(sizeof(*icon_dir));
-    icon_dir->path = strdup(path);
+    return icon_base_dir;
+}
+
+int IconInit(XDGIconDir *icon_dir, const char *path, IconType type, IconContext context, int size, int min_size, int max_size, int scale, int threshold)
+{
+    // Every theme has the same few dozen directory names
+    const HashKey *interned = Intern(path);
+    if (interned == NULL)
+        return -1;
+
+    icon_dir->path = interned->str;
     icon_dir->size = size;
     icon_dir->scale = scale;
     icon_dir->context = context;
@@ -285,18 +347,29 @@ XDGIconDir *IconCreate(const char *path, IconType type, IconContext context, int
     icon_dir->max_size = max_size;
     icon_dir->min_size = min_size;
     icon_dir->threshold = threshold;
-    icon_dir->icons = HashMapCreate();
+    // Most directories never get an icon, their map is created with the first one
+    icon_dir->icons = NULL;
     icon_dir->index_state = NotIndexed;
+    icon_dir->indexed_mtime = 0;
+    return 0;
+}
 
-    return icon_dir;
+static HashMap *IconDirMap(XDGIconDir *icon_dir)
+{
+    if (icon_dir->icons == NULL)
+    {
+        icon_dir->icons = HashMapCreate();
+        icon_dir->icons->stats_group = IconDirMapStats;
+    }
+
+    return icon_dir->icons;
 }
 
-void IconDestroy(void *icon_dir_ptr)
+// The directory itself lives in its theme's icon_dirs
+static void IconDestroy(XDGIconDir *icon_dir)
 {
-    XDGIconDir *icon_dir = icon_dir_ptr;
-    HashMapDestroy(icon_dir->icons);
-    free(icon_dir->path);
-    free(icon_dir);
+    if (icon_dir->icons != NULL)
+        HashMapDestroy(icon_dir->icons);
 }
 
 void IconPrint(void *icon_dir_ptr)
@@ -305,32 +378,27 @@ void IconPrint(void *icon_dir_ptr)
     printf("%s\n",icon_dir->path);
 }
 
-static int IconDirCmp(const void *a, const void *b)
+static inline int IconDirCmp(const XDGIconDir *icon_a, const XDGIconDir *icon_b)
 {
-    const XDGIconDir *icon_a = *(XDGIconDir**)a;
-    const XDGIconDir *icon_b = *(XDGIconDir**)b;
-
     return strcasecmp(icon_a->path, icon_b->path);
 }
 
-static int IconDirCmp2(const void *a, const void *b)
+static inline int IconDirKeyCmp(const XDGIconDir *icon_dir, const char *icon_path)
 {
-    const XDGIconDir *icon_a = a;
-    const char *icon_path = b;
-
-    return strcasecmp(icon_a->path, icon_path);
+    return strcasecmp(icon_dir->path, icon_path);
 }
 
-static int IconDirCmpSubStr(const void *a, const void *b)
-{
-    const XDGIconDir *icon_a = a;
-    const char *icon_path = b;
+VEC_DEFINE_SORTED(IconDirVec, XDGIconDir, const char*, IconDirCmp, IconDirKeyCmp)
 
-    return strstr(icon_a->path, icon_path) != NULL;
+static inline bool IconDirCmpSubStr(const XDGIconDir *icon_dir, const char *icon_path)
+{
+    return strstr(icon_dir->path, icon_path) != NULL;
 }
 
 static void IndexSingleIconDir(XDGIconDir *icon_dir, const char *theme_path)
 {
+    TRACE_SCOPE_FMT("index %s/%s", theme_path, icon_dir->path);
+
     char directory_path[512];
     snprintf(directory_path, sizeof(directory_path), "%s/%s", theme_path, icon_dir->path);
 
@@ -340,6 +408,10 @@ static void IndexSingleIconDir(XDGIconDir *icon_dir, const char *theme_path)
         return; // Skip if the directory cannot be opened
     }
 
+    struct stat st;
+    if (fstat(dirfd(dir), &st) == 0)
+        icon_dir->indexed_mtime = (long long)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
     struct dirent *entry;
     size_t file_count = 0;
     while ((entry = readdir(dir)) != NULL)
@@ -371,13 +443,9 @@ static void IndexSingleIconDir(XDGIconDir *icon_dir, const char *theme_path)
 
             if (valid_ext)
             {
-                char full_path[768];
-                char name[128];
-                strlcpy(name, entry->d_name, sizeof(name));
-                snprintf(full_path, sizeof(full_path), "%s/%s", directory_path, name);
-                char *pos = strrchr(name, '.');
-                *pos = '\0';
-                HashMapInsert(icon_dir->icons, name, full_path);
+                // The name is the file name without its extension, only the extension is kept.
+                // The full path is put back together by IconDirGetPath for the icons that get used.
+                HashMapInsertN(IconDirMap(icon_dir), entry->d_name, ext - entry->d_name, ext, strlen(ext));
                 file_count++;
             }
         }
@@ -385,20 +453,32 @@ static void IndexSingleIconDir(XDGIconDir *icon_dir, const char *theme_path)
 
     closedir(dir);
 
+    StatsAdd(&stats.files_indexed, file_count);
+
     // Mark the directory as indexed
     if (icon_dir->index_state == NotIndexed)
+    {
         icon_dir->index_state = FullyIndexed;
+        STATS_INC(dirs_fully_indexed);
+    }
+    else
+    {
+        STATS_INC(dirs_partially_indexed);
+    }
 }
 
 IconTheme *LoadIconTheme(const char *theme_name)
 {
+    TRACE_SCOPE_FMT("theme load %s", theme_name);
+
     IconTheme *theme = malloc(sizeof(*theme));
-    theme->name = strdup(theme_name);
-    theme->icon_dirs = DArrayCreate(64, (void*)IconDestroy, NULL, IconDirCmp);
-    theme->parents = DArrayCreate(8, free, NULL, NULL);
+    ArenaInit(&theme->arena, THEME_ARENA_CHUNK_SIZE);
+    theme->name = ArenaStrdup(&theme->arena, theme_name);
+    IconDirVecInit(&theme->icon_dirs, 64);
+    StrVecInit(&theme->parents, 8);
 
     ParseThemeIcons(theme);
-    DArraySort(theme->icon_dirs);
+    IconDirVecSort(&theme->icon_dirs);
 
     //printf("\n");
     //DArrayPrint(theme->icons, IconPrint);
@@ -410,10 +490,13 @@ void UnLoadIconTheme(IconTheme *icon_theme)
 {
     //HashMapDestroy(icon_theme->icon_index);
     //if (icon_theme->parents != NULL)
-    DArrayDestroy(icon_theme->parents);
-    DArrayDestroy(icon_theme->icon_dirs);
+    StrVecDestroy(&icon_theme->parents);
 
-    free(icon_theme->name);
+    for (size_t i = 0; i < icon_theme->icon_dirs.size; i++)
+        IconDestroy(&icon_theme->icon_dirs.data[i]);
+    IconDirVecDestroy(&icon_theme->icon_dirs);
+
+    ArenaDestroy(&icon_theme->arena);
     free(icon_theme);
 }
 
@@ -565,7 +648,22 @@ static int DirectorySizeDistance(XDGIconDir *icon, int icon_size, int icon_scale
     return 0;
 }
 
-static bool LookupIconBackup(XDGIconDir *icon_dir, const char *icon_name, const char *theme_path)
+// The icon dir maps store the extension of each icon name, the path is built from the theme dir, the icon dir and the name
+static char *IconDirGetPath(XDGIconDir *icon_dir, const char *theme_dir, const HashKey *icon_name)
+{
+    if (icon_dir->icons == NULL)
+        return NULL;
+
+    const char *ext = HashMapGetHashed(icon_dir->icons, icon_name);
+    if (ext == NULL)
+        return NULL;
+
+    char icon_path[768];
+    snprintf(icon_path, sizeof(icon_path), "%s/%s/%s%s", theme_dir, icon_dir->path, icon_name->str, ext);
+    return strdup(icon_path);
+}
+
+static bool LookupIconBackup(XDGIconDir *icon_dir, const HashKey *icon_name, const char *theme_path)
 {
     char icon_path[512];
     const char *icon_exts[] = {".png", ".svg", ".xpm"};
@@ -574,11 +672,12 @@ static bool LookupIconBackup(XDGIconDir *icon_dir, const char *icon_name, const
     {
         // Create the full path.
         // Seems like one big snprintf call is faster then mutliple strlcpy and strlcat calls
-        snprintf(icon_path, sizeof(icon_path), "%s/%s/%s%s", theme_path, icon_dir->path, icon_name, icon_exts[i]);
+        snprintf(icon_path, sizeof(icon_path), "%s/%s/%s%s", theme_path, icon_dir->path, icon_name->str, icon_exts[i]);
 
+        STATS_INC(access_backup);
         if (access(icon_path, F_OK) == 0)
         {
-            HashMapInsert(icon_dir->icons, icon_name, icon_path);
+            HashMapInsertHashed(IconDirMap(icon_dir), icon_name, icon_exts[i], strlen(icon_exts[i]));
             return true;
         }
     }
@@ -586,7 +685,7 @@ static bool LookupIconBackup(XDGIconDir *icon_dir, const char *icon_name, const
     return false;
 }
 
-static char *LookupIconExactSize(IconTheme *theme, const char *icon_name, int size, int scale)
+static char *LookupIconExactSize(IconTheme *theme, const HashKey *icon_name, int size, int scale)
 {
     // Icon size substr
     char icon_size[4];
@@ -594,11 +693,11 @@ static char *LookupIconExactSize(IconTheme *theme, const char *icon_name, int si
 
     size_t found = 0;
 
-    int index_array[theme->icon_dirs->size];
+    int index_array[theme->icon_dirs.size];
 
-    for (size_t i = 0; i < theme->icon_dirs->size; i++)
+    for (size_t i = 0; i < theme->icon_dirs.size; i++)
     {
-        if (IconDirCmpSubStr(theme->icon_dirs->data[i], icon_size))
+        if (IconDirCmpSubStr(&theme->icon_dirs.data[i], icon_size))
         {
             index_array[found++] = i;
         }
@@ -611,7 +710,7 @@ static char *LookupIconExactSize(IconTheme *theme, const char *icon_name, int si
     }
 
     // Build partial path
-    const char *base_dir = "/usr/share/icons";
+    const char *base_dir = icon_base_dir;
     char theme_dir[256];
     snprintf(theme_dir, sizeof(theme_dir), "%s/%s", base_dir, theme->name);
 
@@ -619,7 +718,7 @@ static char *LookupIconExactSize(IconTheme *theme, const char *icon_name, int si
     for (size_t i = 0; i < found; i++)
     {
         int curr_index = index_array[i];
-        XDGIconDir *curr_icon_dir = theme->icon_dirs->data[curr_index];
+        XDGIconDir *curr_icon_dir = &theme->icon_dirs.data[curr_index];
 
         // Skip searching directories that don't match the final icon size (example: icon_name_32x@3x)
         if (!DirectoryMatchesSize(curr_icon_dir, size, scale))
@@ -640,24 +739,24 @@ static char *LookupIconExactSize(IconTheme *theme, const char *icon_name, int si
         }
 
         // Now, search for the icon in the hash map
-        const char *icon_path = HashMapGet(curr_icon_dir->icons, icon_name);
+        char *icon_path = IconDirGetPath(curr_icon_dir, theme_dir, icon_name);
         if (icon_path == NULL)
             continue;
 
-        return strdup(icon_path); // Exact match
+        return icon_path; // Exact match
     }
 
     return NULL;
 }
 
-static char *LookupIconScaled(IconTheme *theme, const char *icon_name)
+static char *LookupIconScaled(IconTheme *theme, const HashKey *icon_name)
 {
     size_t found = 0;
-    int index_array[theme->icon_dirs->size];
+    int index_array[theme->icon_dirs.size];
 
-    for (size_t i = 0; i < theme->icon_dirs->size; i++)
+    for (size_t i = 0; i < theme->icon_dirs.size; i++)
     {
-        if (IconDirCmpSubStr(theme->icon_dirs->data[i], "scalable"))
+        if (IconDirCmpSubStr(&theme->icon_dirs.data[i], "scalable"))
         {
             index_array[found++] = i;
         }
@@ -670,7 +769,7 @@ static char *LookupIconScaled(IconTheme *theme, const char *icon_name)
     }
 
     // Build partial path
-    const char *base_dir = "/usr/share/icons";
+    const char *base_dir = icon_base_dir;
     char theme_dir[256];
     snprintf(theme_dir, sizeof(theme_dir), "%s/%s", base_dir, theme->name);
 
@@ -678,7 +777,7 @@ static char *LookupIconScaled(IconTheme *theme, const char *icon_name)
     for (size_t i = 0; i < found; i++)
     {
         int curr_index = index_array[i];
-        XDGIconDir *curr_icon_dir = theme->icon_dirs->data[curr_index];
+        XDGIconDir *curr_icon_dir = &theme->icon_dirs.data[curr_index];
         // Check if the directory is indexed, if not, index it
         if (curr_icon_dir->index_state == NotIndexed)
         {
@@ -692,33 +791,48 @@ static char *LookupIconScaled(IconTheme *theme, const char *icon_name)
                 continue;
         }
         // Now, search for the icon in the indexed hash map
-        const char *icon_path = HashMapGet(curr_icon_dir->icons, icon_name);
+        char *icon_path = IconDirGetPath(curr_icon_dir, theme_dir, icon_name);
         if (icon_path == NULL)
             continue;
-        return strdup(icon_path); // Exact match
+        return icon_path; // Exact match
     }
 
     return NULL;
 }
 
-static char *LookupIconMultiPhase(IconTheme *theme, const char *icon_name, int size, int scale)
+// Icon names can also be absolute paths
+static bool IsIconPath(const char *icon_name, IconPhase *phase)
+{
+    STATS_INC(access_absolute);
+    if (access(icon_name, F_OK) != 0)
+        return false;
+
+    *phase = AbsolutePathPhase;
+    return true;
+}
+
+static char *LookupIconMultiPhase(IconTheme *theme, const HashKey *icon_name, int size, int scale, IconPhase *phase)
 {
-    if (access(icon_name, F_OK) == 0)
-        return strdup(icon_name);
+    if (IsIconPath(icon_name->str, phase))
+        return strdup(icon_name->str);
 
     char *found_icon = NULL;
 
+    *phase = ExactSizePhase;
     found_icon = LookupIconExactSize(theme, icon_name, size, scale);
     if (found_icon != NULL)
         return found_icon;
 
     if (strcmp(theme->name, "hicolor") == 0)
     {
+        *phase = ScalablePhase;
         found_icon = LookupIconScaled(theme, icon_name);
         if (found_icon != NULL)
             return found_icon;
     }
 
+    *phase = FallbackSizePhase;
+
     for (size_t i = 0; i < ARRAY_SIZE(common_icon_sizes); i++)
     {
         if (common_icon_sizes[i].value == size)
@@ -732,37 +846,38 @@ static char *LookupIconMultiPhase(IconTheme *theme, const char *icon_name, int s
     return NULL;
 }
 
-static char *LookupIconHybrid(IconTheme *theme, const char *icon_name, int size, int scale)
+static char *LookupIconHybrid(IconTheme *theme, const HashKey *icon_name, int size, int scale, IconPhase *phase)
 {
-    if (access(icon_name, F_OK) == 0)
-        return strdup(icon_name);
+    if (IsIconPath(icon_name->str, phase))
+        return strdup(icon_name->str);
 
+    *phase = ExactSizePhase;
     char *found_icon = LookupIconExactSize(theme, icon_name, size, scale);
     if (found_icon != NULL)
         return found_icon;
 
     if (strcmp(theme->name, "hicolor") == 0)
     {
+        *phase = ScalablePhase;
         found_icon = LookupIconScaled(theme, icon_name);
         if (found_icon != NULL)
             return found_icon;
     }
 
+    *phase = FallbackSizePhase;
+
     char closest_icon_path[512];
     int min_size = INT_MAX;
     char icon_path[512];
-    const char *base_dir = "/usr/share/icons/";
-
-    char theme_dir[128];
-    strlcpy(theme_dir, base_dir, sizeof(theme_dir));
-    strlcat(theme_dir, theme->name, sizeof(theme_dir));
+    char theme_dir[256];
+    snprintf(theme_dir, sizeof(theme_dir), "%s/%s", icon_base_dir, theme->name);
 
     const char *icon_exts[] = {".png", ".svg", ".xpm"};
     const int num_exts = 3;
 
-    for (size_t i = 0; i < theme->icon_dirs->size; i++)
+    for (size_t i = 0; i < theme->icon_dirs.size; i++)
     {
-        XDGIconDir *curr_icon_dir = theme->icon_dirs->data[i];
+        XDGIconDir *curr_icon_dir = &theme->icon_dirs.data[i];
 
         // Skip already searched paths
         if (curr_icon_dir->index_state == FullyIndexed)
@@ -774,8 +889,9 @@ static char *LookupIconHybrid(IconTheme *theme, const char *icon_name, int size,
         {
             // Create the full path.
             // Seems like one big snprintf call is faster then mutliple strlcpy and strlcat calls
-            snprintf(icon_path, sizeof(icon_path), "%s/%s/%s%s", theme_dir, curr_icon_dir->path, icon_name, icon_exts[j]);
+            snprintf(icon_path, sizeof(icon_path), "%s/%s/%s%s", theme_dir, curr_icon_dir->path, icon_name->str, icon_exts[j]);
 
+            STATS_INC(access_hybrid);
             if (access(icon_path, F_OK) == 0)
             {
                 int size_delta = DirectorySizeDistance(curr_icon_dir, size, scale);
@@ -797,38 +913,37 @@ static char *LookupIconHybrid(IconTheme *theme, const char *icon_name, int size,
     return NULL;
 }
 
-static char *LookupIconLinear(IconTheme *theme, const char *icon_name, int size, int scale)
+static char *LookupIconLinear(IconTheme *theme, const HashKey *icon_name, int size, int scale, IconPhase *phase)
 {
-    if (access(icon_name, F_OK) == 0)
-        return strdup(icon_name);
+    if (IsIconPath(icon_name->str, phase))
+        return strdup(icon_name->str);
 
     char icon_path[512];
     char closest_icon_path[512];
-    const char *base_dir = "/usr/share/icons/";
-
-    char theme_dir[128];
-    strlcpy(theme_dir, base_dir, sizeof(theme_dir));
-    strlcat(theme_dir, theme->name, sizeof(theme_dir));
+    char theme_dir[256];
+    snprintf(theme_dir, sizeof(theme_dir), "%s/%s", icon_base_dir, theme->name);
 
     const char *icon_exts[] = {".png", ".svg", ".xpm"};
     const int num_exts = 3;
 
     int min_size = INT_MAX;
 
-    for (size_t i = 0; i < theme->icon_dirs->size; i++)
+    for (size_t i = 0; i < theme->icon_dirs.size; i++)
     {
-        XDGIconDir *current_icon = theme->icon_dirs->data[i];
+        XDGIconDir *current_icon = &theme->icon_dirs.data[i];
 
         for (int j = 0; j < num_exts; j++)
         {
             // Create the full path.
             // Seems like one big snprintf call is faster then mutliple strlcpy and strlcat calls
-            snprintf(icon_path, sizeof(icon_path), "%s/%s/%s%s", theme_dir, current_icon->path, icon_name, icon_exts[j]);
+            snprintf(icon_path, sizeof(icon_path), "%s/%s/%s%s", theme_dir, current_icon->path, icon_name->str, icon_exts[j]);
 
+            STATS_INC(access_linear);
             if (access(icon_path, F_OK) == 0)
             {
                 if (DirectoryMatchesSize(current_icon, size, scale))
                 {
+                    *phase = ExactSizePhase;
                     return strdup(icon_path);
                 }
 
@@ -843,6 +958,7 @@ static char *LookupIconLinear(IconTheme *theme, const char *icon_name, int size,
     }
 
     // Return the closest icon path found
+    *phase = FallbackSizePhase;
     if (min_size != INT_MAX)
         return strdup(closest_icon_path);
 
@@ -850,17 +966,25 @@ static char *LookupIconLinear(IconTheme *theme, const char *icon_name, int size,
     return NULL;
 }
 
-char *LookupIcon(IconTheme *theme, const char *icon_name, int size, int scale)
+// Also reports which step of the lookup found the icon
+static char *LookupIconWithPhase(IconTheme *theme, const HashKey *icon_name, int size, int scale, IconPhase *phase)
 {
 #ifdef HYBRID_ICON_SEARCH
-    return LookupIconHybrid(theme, icon_name, size, scale);
+    return LookupIconHybrid(theme, icon_name, size, scale, phase);
 #elif defined(MULTIPHASE_ICON_SEARCH)
-    return LookupIconMultiPhase(theme, icon_name, size, scale);
+    return LookupIconMultiPhase(theme, icon_name, size, scale, phase);
 #else
-    return LookupIconLinear(theme, icon_name, size, scale);
+    return LookupIconLinear(theme, icon_name, size, scale, phase);
 #endif
 }
 
+char *LookupIcon(IconTheme *theme, const char *icon_name, int size, int scale)
+{
+    IconPhase phase;
+    HashKey key = HashKeyInit(icon_name);
+    return LookupIconWithPhase(theme, &key, size, scale, &phase);
+}
+
 char *LookupFallbackIcon(const char *icon)
 {
     /*
@@ -884,12 +1008,46 @@ static int SearchThemeNameCmp1(const void *a, const void *b)
     return strcmp(theme->name, theme_name) == 0;
 }
 
-static int SearchThemeNameCmp2(const void *a, const void *b)
+static int InitThemes(void)
+{
+    if (ThemeMapInit(&themes_map, 16) != 0)
+        return -1;
+
+    StrVecInit(&themes_names, 8);
+    themes_loaded = true;
+    return 0;
+}
+
+static IconTheme *GetTheme(const char *theme_name)
 {
-    const char *theme_name_a = a;
-    const char *theme_name_b = b;
+    if (!themes_loaded)
+        return NULL;
+
+    size_t probes;
+    IconTheme **theme = ThemeMapGet(&themes_map, theme_name, &probes);
 
-    return strcmp(theme_name_a, theme_name_b) == 0;
+    StatsRecordProbe(ThemesMapStats, probes);
+    return theme != NULL ? *theme : NULL;
+}
+
+// The theme gets unloaded if it can't be added
+static int AddTheme(IconTheme *theme)
+{
+    bool found;
+    IconTheme **slot = ThemeMapInsert(&themes_map, theme->name, &found);
+    if (slot == NULL)
+    {
+        UnLoadIconTheme(theme);
+        return -1;
+    }
+
+    // Loaded twice, the old one goes
+    if (found && *slot != theme)
+        UnLoadIconTheme(*slot);
+
+    *slot = theme;
+    StrVecPush(&themes_names, strdup(theme->name));
+    return 0;
 }
 
 int PreloadIconThemesOld(const char *theme)
@@ -899,21 +1057,21 @@ int PreloadIconThemesOld(const char *theme)
     if (icon_theme == NULL)
         return -1;
 
-    if (themes_map == NULL)
+    if (!themes_loaded && InitThemes() != 0)
     {
-        themes_map = HashMapCreate2((void*)UnLoadIconTheme, NULL);
-        themes_names = DArrayCreate(8, free, SearchThemeNameCmp2, NULL);
+        UnLoadIconTheme(icon_theme);
+        return -1;
     }
 
-    HashMapInsert2(themes_map, theme, icon_theme);
-    DArrayAdd(themes_names, strdup(theme));
+    if (AddTheme(icon_theme) != 0)
+        return -1;
 
-    if (icon_theme->parents->size != 0)
+    if (icon_theme->parents.size != 0)
     {
-        for (int i = 0; i < icon_theme->parents->size; i++)
+        for (int i = 0; i < icon_theme->parents.size; i++)
         {
-            char *parent = icon_theme->parents->data[i];
-            if (HashMapGet2(themes_map, parent) != NULL)
+            char *parent = icon_theme->parents.data[i];
+            if (GetTheme(parent) != NULL)
             {
                 continue;
             }
@@ -930,18 +1088,15 @@ static int LoadInheritedTheme(const char *theme)
 {
     IconTheme *icon_theme = LoadIconTheme(theme);
 
-    if (icon_theme == NULL)
+    if (icon_theme == NULL || AddTheme(icon_theme) != 0)
         return -1;
 
-    HashMapInsert2(themes_map, theme, icon_theme);
-    DArrayAdd(themes_names, strdup(theme));
-
-    if (icon_theme->parents->size != 0)
+    if (icon_theme->parents.size != 0)
     {
-        for (int i = 0; i < icon_theme->parents->size; i++)
+        for (int i = 0; i < icon_theme->parents.size; i++)
         {
-            char *parent = icon_theme->parents->data[i];
-            if (HashMapGet2(themes_map, parent) != NULL)
+            char *parent = icon_theme->parents.data[i];
+            if (GetTheme(parent) != NULL)
             {
                 continue;
             }
@@ -961,21 +1116,21 @@ int PreloadIconThemes(const char *theme)
     if (icon_theme == NULL)
         return -1;
 
-    if (themes_map == NULL)
+    if (!themes_loaded && InitThemes() != 0)
     {
-        themes_map = HashMapCreate2((void*)UnLoadIconTheme, NULL);
-        themes_names = DArrayCreate(8, free, SearchThemeNameCmp2, NULL);
+        UnLoadIconTheme(icon_theme);
+        return -1;
     }
 
-    HashMapInsert2(themes_map, theme, icon_theme);
-    DArrayAdd(themes_names, strdup(theme));
+    if (AddTheme(icon_theme) != 0)
+        return -1;
 
-    if (icon_theme->parents->size)
+    if (icon_theme->parents.size)
     {
-        for (int i = 0; i < icon_theme->parents->size; i++)
+        for (int i = 0; i < icon_theme->parents.size; i++)
         {
-            char *parent = icon_theme->parents->data[i];
-            if (HashMapGet2(themes_map, parent) != NULL)
+            char *parent = icon_theme->parents.data[i];
+            if (GetTheme(parent) != NULL)
                 continue;
             if (LoadInheritedTheme(parent) != 0)
                 continue;
@@ -983,14 +1138,11 @@ int PreloadIconThemes(const char *theme)
     }
 
     const char *default_theme_name = "hicolor";
-    if (!DArrayContains(themes_names, default_theme_name))
+    if (StrVecIndexOf(&themes_names, default_theme_name) == VEC_NOT_FOUND)
     {
         IconTheme *default_theme = LoadIconTheme(default_theme_name);
-        if (default_theme == NULL)
+        if (default_theme == NULL || AddTheme(default_theme) != 0)
             return -1;
-    
-        HashMapInsert2(themes_map, default_theme_name, default_theme);
-        DArrayAdd(themes_names, strdup(default_theme_name));
     }
 
     return 0;
@@ -1011,59 +1163,114 @@ int PreloadIconThemesFast(const char *theme)
     if (default_theme == NULL)
         return -1;
 
-    themes_map = HashMapCreate2((void*)UnLoadIconTheme, NULL);
-    themes_names = DArrayCreate(8, free, SearchThemeNameCmp2, NULL);
+    if (InitThemes() != 0)
+    {
+        UnLoadIconTheme(icon_theme);
+        UnLoadIconTheme(default_theme);
+        return -1;
+    }
 
-    HashMapInsert2(themes_map, theme, icon_theme);
-    DArrayAdd(themes_names, strdup(theme));
+    if (AddTheme(icon_theme) != 0)
+    {
+        UnLoadIconTheme(default_theme);
+        return -1;
+    }
 
-    HashMapInsert2(themes_map, default_theme_name, default_theme);
-    DArrayAdd(themes_names, strdup(default_theme_name));
+    return AddTheme(default_theme);
 
     return 0;
 }
 
 void DestroyIconThemes(void)
 {
-    if (themes_map == NULL)
+    if (!themes_loaded)
         return;
 
-    HashMapDestroy2(themes_map);
-    DArrayDestroy(themes_names);
+    for (size_t i = 0; i < themes_map.capacity; i++)
+    {
+        if (themes_map.hashes[i] != 0)
+            UnLoadIconTheme(themes_map.values[i]);
+    }
+    ThemeMapDestroy(&themes_map);
+
+    for (size_t i = 0; i < themes_names.size; i++)
+        free(themes_names.data[i]);
+    StrVecDestroy(&themes_names);
+
+    // So the themes get loaded again by the next run in the same process
+    themes_loaded = false;
 }
 
-char *SearchIconInThemes(const char *icon, int size, int scale, int max_theme_depth)
+// Visits the directory, index.theme and every sub directory of each loaded theme
+void IconThemesForEachPath(void (*Func)(const char*, void*), void *args)
+{
+    if (!themes_loaded)
+        return;
+
+    const char *base_dir = icon_base_dir;
+    char path[512];
+
+    for (size_t i = 0; i < themes_names.size; i++)
+    {
+        IconTheme *theme = GetTheme(themes_names.data[i]);
+        if (theme == NULL)
+            continue;
+
+        snprintf(path, sizeof(path), "%s/%s", base_dir, theme->name);
+        Func(path, args);
+
+        snprintf(path, sizeof(path), "%s/%s/index.theme", base_dir, theme->name);
+        Func(path, args);
+
+        for (size_t j = 0; j < theme->icon_dirs.size; j++)
+        {
+            XDGIconDir *icon_dir = &theme->icon_dirs.data[j];
+            snprintf(path, sizeof(path), "%s/%s/%s", base_dir, theme->name, icon_dir->path);
+            Func(path, args);
+        }
+    }
+}
+
+// The icon name is hashed once by the caller and every icon dir of every theme looks it up with that hash
+static char *SearchIconInThemesHashed(const HashKey *icon, int size, int scale, int max_theme_depth)
 {
-    int themes_to_search = themes_names->size;
+    int themes_to_search = themes_names.size;
     if (max_theme_depth != 0)
         themes_to_search = MIN(themes_to_search, max_theme_depth);
 
     for (int i = 0; i < themes_to_search; i++)
     {
-        char *theme_name = themes_names->data[i];
+        char *theme_name = themes_names.data[i];
     
-        IconTheme *theme = HashMapGet2(themes_map, theme_name);
+        IconTheme *theme = GetTheme(theme_name);
         if (theme == NULL)
-            return NULL;
+            break;
 
-        char *filename = LookupIcon(theme, icon, size, scale);
+        IconPhase phase;
+        char *filename = LookupIconWithPhase(theme, icon, size, scale, &phase);
         if (filename != NULL)
         {
+            STATS_INC(icon_phases[i == 0 || phase == AbsolutePathPhase ? phase : InheritedThemePhase]);
             return filename;
         }
     }
 
+    STATS_INC(icon_phases[NotFoundPhase]);
     return NULL;
 }
 
-char *SearchIconInTheme(const char *theme_name, const char *icon, int size, int scale)
+char *SearchIconInThemes(const char *icon, int size, int scale, int max_theme_depth)
 {
-    const char *found_theme_name = DArrayLinearSearch(themes_names, theme_name);
+    HashKey key = HashKeyInit(icon);
+    return SearchIconInThemesHashed(&key, size, scale, max_theme_depth);
+}
 
-    if (!found_theme_name)
+char *SearchIconInTheme(const char *theme_name, const char *icon, int size, int scale)
+{
+    if (StrVecIndexOf(&themes_names, theme_name) == VEC_NOT_FOUND)
         return NULL;
 
-    IconTheme *theme = HashMapGet2(themes_map, found_theme_name);
+    IconTheme *theme = GetTheme(theme_name);
     if (theme != NULL)
     {
         return LookupIcon(theme, icon, size, scale);
@@ -1086,11 +1293,11 @@ char *FindIconHelper(const char *icon, int size, int scale, const char *theme)
         return filename;
     }
 
-    if (icon_theme->parents->size != 0)
+    if (icon_theme->parents.size != 0)
     {
-        for (int i = 0; i < icon_theme->parents->size; i++)
+        for (int i = 0; i < icon_theme->parents.size; i++)
         {
-            char *parent = icon_theme->parents->data[i];
+            char *parent = icon_theme->parents.data[i];
             filename = FindIconHelper(icon, size, scale, parent);
             if (filename != NULL)
                 return filename;
@@ -1122,20 +1329,69 @@ success:
     return filename;
 }
 
-static void SearchAndStoreIconHelper(HashMap *icons, const char *icon, int size, int scale)
+// Resolves one icon name and stores the found path under that name
+void ResolveIcon(HashMap *icons, const char *icon, int size, int scale)
 {
+    TRACE_SCOPE_FMT("resolve %s", icon);
+
     // TEST
     //char *filename = SearchIconInTheme("hicolor", icon, size, scale);
 
-    char *filename = SearchIconInThemes(icon, size, scale, 3);
+    HashKey key = HashKeyInit(icon);
+    char *filename = SearchIconInThemesHashed(&key, size, scale, 3);
 
     if (filename != NULL)
     {
-        HashMapInsert(icons, icon, filename);
+        HashMapInsertHashed(icons, &key, filename, strlen(filename));
         free(filename);
     }
 }
 
+void DropChangedIconDirs(void)
+{
+    TRACE_SCOPE("drop changed icon dirs");
+
+    if (!themes_loaded)
+        return;
+
+    char path[512];
+    struct stat st;
+
+    for (size_t i = 0; i < themes_names.size; i++)
+    {
+        IconTheme *theme = GetTheme(themes_names.data[i]);
+        if (theme == NULL)
+            continue;
+
+        for (size_t j = 0; j < theme->icon_dirs.size; j++)
+        {
+            XDGIconDir *icon_dir = &theme->icon_dirs.data[j];
+            if (icon_dir->index_state == NotIndexed)
+                continue;
+
+            snprintf(path, sizeof(path), "%s/%s/%s", icon_base_dir, theme->name, icon_dir->path);
+            if (stat(path, &st) == 0 &&
+                (long long)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec == icon_dir->indexed_mtime)
+            {
+                continue;
+            }
+
+            IconDestroy(icon_dir);
+            icon_dir->icons = NULL;
+            icon_dir->index_state = NotIndexed;
+        }
+    }
+}
+
+// Extra icons that are needed by the menu, should put this somewhere else
+void ResolveExtraIcons(HashMap *icons, int size, int scale)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(extra_icons); i++)
+    {
+        ResolveIcon(icons, extra_icons[i], size, scale);
+    }
+}
+
 typedef struct
 {
     HashMap *valid_icons;
@@ -1149,12 +1405,14 @@ static void SearchAndStoreIcon(void *entry_ptr, void *args_ptr)
     Args *args = args_ptr;
     const char *icon = entry->icon;
 
-    SearchAndStoreIconHelper(args->valid_icons, icon, args->size, args->scale);
+    ResolveIcon(args->valid_icons, icon, args->size, args->scale);
 }
 
-HashMap *FindAllIcons(BTreeNode *entries, int size, int scale)
+int LoadCurrentIconThemes(void)
 {
-    char theme[256];
+    TRACE_SCOPE("load icon themes");
+
+    char theme[256] = "\0";
     int found = GetCurrentGTKIconThemeName(theme);
     //char *theme = GetCurrentGTKIconThemeName();
     //char *theme = "Papirus";
@@ -1164,24 +1422,70 @@ HashMap *FindAllIcons(BTreeNode *entries, int size, int scale)
     if (found != 0 || theme[0] == '\0')
     {
         printf("Failed to get GTK icon theme name!\n");
-        return NULL;
+        return -1;
     }
 
 #ifdef SEARCH_INHERITED_ICON_THEMES
     if (PreloadIconThemes(theme) != 0)
     {
         printf("Failed to load current GTK icon theme!\n");
-        return NULL;
+        return -1;
     }
 #else
     if (PreloadIconThemesFast(theme) != 0)
     {
         printf("Failed to load current GTK icon theme!\n");
-        return NULL;
+        return -1;
     }
 #endif
 
+    return 0;
+}
+
+// Indexes up front the directories the first lookup phase would index lazily,
+// so it can happen before any icon name is known
+void IndexIconThemes(int size, int scale)
+{
+    TRACE_SCOPE("index icon themes");
+
+    const char *base_dir = icon_base_dir;
+    char icon_size[4];
+    snprintf(icon_size, sizeof(icon_size), "%d", size);
+
+    for (size_t i = 0; i < themes_names.size; i++)
+    {
+        IconTheme *theme = GetTheme(themes_names.data[i]);
+        if (theme == NULL)
+            continue;
+
+        char theme_dir[256];
+        snprintf(theme_dir, sizeof(theme_dir), "%s/%s", base_dir, theme->name);
+
+        bool is_hicolor = strcmp(theme->name, "hicolor") == 0;
+
+        for (size_t j = 0; j < theme->icon_dirs.size; j++)
+        {
+            XDGIconDir *icon_dir = &theme->icon_dirs.data[j];
+
+            if (icon_dir->index_state != NotIndexed)
+                continue;
+
+            bool exact_size = IconDirCmpSubStr(icon_dir, icon_size) && DirectoryMatchesSize(icon_dir, size, scale);
+            bool scalable = is_hicolor && IconDirCmpSubStr(icon_dir, "scalable");
+
+            if (exact_size || scalable)
+                IndexSingleIconDir(icon_dir, theme_dir);
+        }
+    }
+}
+
+HashMap *FindAllIcons(EntryStore *entries, int size, int scale)
+{
+    if (LoadCurrentIconThemes() != 0)
+        return NULL;
+
     HashMap *valid_icons = HashMapCreate();
+    valid_icons->stats_group = ResolvedIconsMapStats;
 
     Args args =
     {
@@ -1191,13 +1495,9 @@ HashMap *FindAllIcons(BTreeNode *entries, int size, int scale)
     };
 
     // Desktop entry icons
-    BSTInOrderTraverse(entries, SearchAndStoreIcon, &args);
+    EntriesForEach(entries, SearchAndStoreIcon, &args);
 
-    // Extra icons that are needed, should put this somewhere else
-    for (size_t i = 0; i < ARRAY_SIZE(extra_icons); i++)
-    {
-        SearchAndStoreIconHelper(valid_icons, extra_icons[i], size, scale);
-    }
+    ResolveExtraIcons(valid_icons, size, scale);
 
     return valid_icons;
 }
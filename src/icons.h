@@ -60,9 +60,11 @@ typedef enum
 
 typedef struct
 {
+    // Icon name to extension, created with the first icon
     HashMap *icons;
 
-    char *path;
+    // Interned
+    const char *path;
     int size;
     int scale;
     IconContext context;
@@ -72,29 +74,48 @@ typedef struct
     int threshold;
 
     IndexedState index_state;
+    // Modification time of the directory when it was indexed, in nanoseconds
+    long long indexed_mtime;
 } XDGIconDir;
 
+VEC_DEFINE(IconDirVec, XDGIconDir)
+
 typedef struct
 {
-    DArray *icon_dirs;
+    // Sorted by path
+    IconDirVec icon_dirs;
     char *name;
-    DArray *parents;
+    StrVec parents;
+    // Holds the name and the parents
+    Arena arena;
     //bool valid;
     //char **gtk_caches;
 } IconTheme;
 
-XDGIconDir *IconCreate(const char *path, IconType type, IconContext context, int size, int min_size, int max_size, int scale, int threshold);
+int SetIconBaseDir(const char *path);
+const char *GetIconBaseDir(void);
+IconTheme *LoadIconTheme(const char *theme_name);
+void UnLoadIconTheme(IconTheme *icon_theme);
+int IconInit(XDGIconDir *icon_dir, const char *path, IconType type, IconContext context, int size, int min_size, int max_size, int scale, int threshold);
 
 int GetCurrentGTKIconThemeName(char *theme_name);
 //char *LookupIcon(char *icon_name, int size, int scale, char *theme);
 char *LookupIcon2(IconTheme *theme, const char *icon_name, int size, int scale);
 char *LookupIcon(IconTheme *theme, const char *icon_name, int size, int scale);
 char *FindIcon(const char *icon, int size, int scale);
-HashMap *FindAllIcons(BTreeNode *entries, int size, int scale);
+HashMap *FindAllIcons(EntryStore *entries, int size, int scale);
+int LoadCurrentIconThemes(void);
+void IndexIconThemes(int size, int scale);
+void ResolveIcon(HashMap *icons, const char *icon, int size, int scale);
+void ResolveExtraIcons(HashMap *icons, int size, int scale);
+// Forgets the index of the directories that changed since they were indexed, the next lookup in them
+// indexes them again
+void DropChangedIconDirs(void);
 
 int PreloadIconThemes(const char *theme);
 int PreloadIconThemesFast(const char *theme);
 void DestroyIconThemes(void);
+void IconThemesForEachPath(void (*Func)(const char*, void*), void *args);
 /*
 * max_theme_depth: 0 = search all available sub themes
 */
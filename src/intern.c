@@ -0,0 +1,111 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "containers.h"
+#include "arena.h"
+#include "hashing.h"
+#include "intern.h"
+#include "stats.h"
+
+// The handles and the strings are packed into the same chunks
+#define INTERN_ARENA_CHUNK_SIZE (64 * 1024)
+#define INTERN_MAP_CAPACITY 1024
+
+static inline uint32_t InternKeyHash(const HashKey *key)
+{
+    return key->hash;
+}
+
+static inline bool InternKeyEquals(const HashKey *a, const HashKey *b)
+{
+    return a->len == b->len && memcmp(a->str, b->str, a->len) == 0;
+}
+
+// Keys and values are the same handle, the map is only used as a set
+MAP_DEFINE(InternMap, const HashKey*, const HashKey*, InternKeyHash, InternKeyEquals)
+
+static InternMap intern_map;
+static Arena intern_arena;
+static bool intern_ready = false;
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const HashKey *InternLocked(const HashKey *key)
+{
+    if (!intern_ready)
+    {
+        if (InternMapInit(&intern_map, INTERN_MAP_CAPACITY) != 0)
+            return NULL;
+
+        ArenaInit(&intern_arena, INTERN_ARENA_CHUNK_SIZE);
+        intern_ready = true;
+    }
+
+    size_t probes;
+    const HashKey **existing = InternMapGet(&intern_map, key, &probes);
+    if (existing != NULL)
+        return *existing;
+
+    HashKey *handle = ArenaAlloc(&intern_arena, sizeof(*handle));
+    if (handle == NULL)
+        return NULL;
+
+    handle->str = ArenaStrndup(&intern_arena, key->str, key->len);
+    if (handle->str == NULL)
+        return NULL;
+
+    handle->len = key->len;
+    handle->hash = key->hash;
+
+    bool found;
+    const HashKey **slot = InternMapInsert(&intern_map, handle, &found);
+    if (slot == NULL)
+        return NULL;
+
+    *slot = handle;
+
+    STATS_INC(interned_strings);
+    StatsAdd(&stats.interned_bytes, key->len + 1);
+    return handle;
+}
+
+const HashKey *InternHashed(const HashKey *key)
+{
+    STATS_INC(intern_lookups);
+
+    pthread_mutex_lock(&intern_lock);
+    const HashKey *handle = InternLocked(key);
+    pthread_mutex_unlock(&intern_lock);
+
+    return handle;
+}
+
+const HashKey *InternN(const char *str, size_t len)
+{
+    HashKey key = HashKeyInitN(str, len);
+    return InternHashed(&key);
+}
+
+const HashKey *Intern(const char *str)
+{
+    return InternN(str, strlen(str));
+}
+
+// Every handle handed out so far becomes invalid
+void InternDestroy(void)
+{
+    pthread_mutex_lock(&intern_lock);
+
+    if (intern_ready)
+    {
+        InternMapDestroy(&intern_map);
+        ArenaDestroy(&intern_arena);
+        intern_ready = false;
+    }
+
+    pthread_mutex_unlock(&intern_lock);
+}
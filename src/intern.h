@@ -0,0 +1,13 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+// Interned strings are stored once and live until InternDestroy.
+// Equal strings get the same handle, so handles and their strings can be compared by pointer.
+// The handle is a HashKey, so it can be looked up in any HashMap without hashing the string again.
+// Safe to call from several threads. NULL when out of memory.
+const HashKey *Intern(const char *str);
+const HashKey *InternN(const char *str, size_t len);
+const HashKey *InternHashed(const HashKey *key);
+void InternDestroy(void);
+
+#endif
@@ -2,11 +2,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <getopt.h>
 
 #include <bsd/string.h>
@@ -15,19 +19,23 @@
 #include "common.h"
 #include "darray.h"
 #include "list.h"
+#include "arena.h"
 #include "hashing.h"
-#include "bstree.h"
-#include "icons.h"
+#include "intern.h"
+#include "containers.h"
 #include "desktop_entries.h"
+#include "icons.h"
 #include "list.h"
 #include "config.h"
-
-
-#define VERSION "v0.2"
+#include "helper_status.h"
+#include "helper.h"
+#include "daemon.h"
+#include "trace.h"
+#include "stats.h"
 
 static void About(void)
 {
-    printf("jwm-helper " VERSION " by Matt W\n");
+    printf("jwm-helper " HELPER_VERSION " by Matt W\n");
 }
 
 static void Usage(void)
@@ -42,6 +50,18 @@ static void Help(void)
            "  -h, --help         Display this information\n"
            "  -v, --version      Display version information\n"
            "  -a, --all          Generate all JWM files\n"
+           "  -f, --force        Regenerate even if no inputs changed since the last run\n"
+           "  -J, --jobs=N       Run the --all generators on N threads (default 1)\n"
+           "      --trace=FILE   Write a Chrome trace of every stage to FILE\n"
+           "      --stats[=json] Print counters for the icon lookups and allocations at exit\n"
+           "      --app-dir=DIR  Read the system desktop entries from DIR (default /usr/share/applications)\n"
+           "      --icon-dir=DIR Look for icon themes in DIR (default /usr/share/icons)\n"
+           "      --bench=N      Run --all N times into a scratch directory and print the stage timings\n"
+           "      --cold         Drop the inputs from the page cache before every --bench run\n"
+           "      --report-changes Exit with 3 if only the menu changed and 4 if JWM needs a restart\n"
+           "      --daemon       Keep everything loaded and answer requests on a socket, see src/daemon.h\n"
+           "      --client REQUEST... Send a request to the daemon and print the answer\n"
+           "      --socket=PATH  Socket of --daemon and --client (default $XDG_RUNTIME_DIR/jwm-helper.sock)\n"
            "  -A, --autostart    Generate the JWM autostart script\n"
            "  -b, --binds        Generate the JWM keybinds\n"
            "  -g, --groups       Generate the JWM program groups\n"
@@ -58,6 +78,18 @@ static const struct option long_opts[] =
     {"help",      no_argument, 0, 'h'},
     {"version",   no_argument, 0, 'v'},
     {"all",       no_argument, 0, 'a'},
+    {"force",     no_argument, 0, 'f'},
+    {"jobs",      required_argument, 0, 'J'},
+    {"trace",     required_argument, 0, 'T'},
+    {"stats",     optional_argument, 0, 'S'},
+    {"app-dir",   required_argument, 0, 'D'},
+    {"icon-dir",  required_argument, 0, 'I'},
+    {"bench",     required_argument, 0, 'B'},
+    {"cold",      no_argument, 0, 'C'},
+    {"report-changes", no_argument, 0, 'R'},
+    {"daemon",    no_argument, 0, 'N'},
+    {"client",    no_argument, 0, 'K'},
+    {"socket",    required_argument, 0, 'O'},
     {"autostart", no_argument, 0, 'A'},
     {"binds",     no_argument, 0, 'b'},
     {"groups",    no_argument, 0, 'g'},
@@ -70,195 +102,331 @@ static const struct option long_opts[] =
     {0, 0, 0, 0}  // terminator
 };
 
-static int LoadAllDesktopEntries(BTreeNode **entries)
+static void WriteTrace(const char *path)
 {
-    // These paths should not be hardcoded, but they work for now
-    const char *default_app_dir = "/usr/share/applications/";
-    const char *user_app_dir = "~/.local/share/applications/";
+    if (path == NULL)
+        return;
+
+    if (TraceWrite(path) == 0)
+        printf("Wrote trace to %s\n", path);
 
-    int success = LoadDesktopEntries(entries, default_app_dir);
+    TraceStop();
+}
 
-    if (success != 0)
+// The generator behind each single output option
+static GeneratorType OptionGenerator(int opt)
+{
+    switch (opt)
     {
-        printf("Failed to load desktop entries from the default path %s!\n", default_app_dir);
-        return -1;
+        case 'A': // --autostart
+            return AutoStartGenerator;
+        case 'b': // --binds
+            return BindsGenerator;
+        case 'g': // --groups
+            return GroupGenerator;
+        case 'i': // --icons
+            return IconsGenerator;
+        case 'j': // --jwmrc
+            return RCFileGenerator;
+        case 'm': // --menu
+            return RootMenuGenerator;
+        case 'p': // --prefs
+            return PreferencesGenerator;
+        case 's': // --styles
+            return StylesGenerator;
+        case 't': // --tray
+            return TrayGenerator;
+        default:
+            return NumGenerators;
     }
+}
+
+typedef enum
+{
+    ConfigStage,
+    LoadStage,
+    GenerateStage,
+    CleanUpStage,
+    TotalStage,
+    NumBenchStages
+} BenchStage;
+
+static const char *bench_stage_names[] =
+{
+    "config",
+    "load",
+    "generate",
+    "cleanup",
+    "total"
+};
+
+static void AddBenchInput(const char *path, void *inputs)
+{
+    DArrayAdd(inputs, strdup(path));
+}
 
-    char user_app_dir_buffer[512];
-    ExpandPath(user_app_dir_buffer, user_app_dir, sizeof(user_app_dir_buffer));
-    success = LoadDesktopEntries(entries, user_app_dir_buffer);
+// Every file --all reads, the icon themes have to be loaded once to know which ones are in use
+static DArray *CollectBenchInputs(void)
+{
+    DArray *inputs = DArrayCreate(256, free, NULL, NULL);
 
-    if (success != 0)
+    HelperAddInputs(inputs);
+
+    if (LoadCurrentIconThemes() == 0)
     {
-        printf("Failed to load desktop entries from the user %s! Skipping...\n", user_app_dir_buffer);
+        IconThemesForEachPath(AddBenchInput, inputs);
+        DestroyIconThemes();
     }
 
-    return 0;
+    return inputs;
 }
 
-static int LoadIcons(JWM *jwm, BTreeNode *entries, HashMap **icons)
+// Only the cached file contents can be dropped this way, dentries and inodes stay cached
+static size_t EvictBenchInputs(DArray *inputs)
 {
-    printf("Loading icons...\n");
+    size_t evicted = 0;
 
-    *icons = FindAllIcons(entries, jwm->global_preferred_icon_size, 1);
-    if (*icons == NULL)
+    for (size_t i = 0; i < inputs->size; i++)
     {
-        printf("Failed to load icons!\n");
-        return -1;
+        int fd = open(inputs->data[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        if (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0)
+            evicted++;
+
+        close(fd);
     }
 
-    printf("Finished loading icons\n");
-    //HashMapPrint(*icons);
-    return 0;
+    return evicted;
 }
 
-static int GenerateAll(JWM *jwm, cfg_t *cfg, BTreeNode *entries, HashMap *icons)
+static long CurrentRSS(void)
 {
-    if (CreateJWMStartup(jwm) != 0)
-        return -1;
+    long pages = 0;
 
-    if (CreateJWMGroup(jwm) != 0)
-        return -1;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL)
+        return 0;
 
-    if (CreateJWMTray(jwm, entries, icons) != 0)
-        return -1;
+    if (fscanf(fp, "%*s %ld", &pages) != 1)
+        pages = 0;
 
-    if (CreateJWMRootMenu(jwm, entries, icons, NULL) != 0)
-        return -1;
+    fclose(fp);
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
 
-    if (CreateJWMStyles(jwm) != 0)
-        return -1;
+// Same as --all, but starting from nothing and freeing everything again afterwards
+static int RunBenchIteration(const char *output_dir, int jobs, long long *durations)
+{
+    int ret = -1;
 
-    if (CreateJWMPreferences(jwm) != 0)
-        return -1;
+    long long start = TraceNow();
+    long long mark = start;
+    long long now;
 
-    if (CreateJWMIcons(jwm) != 0)
-        return -1;
+    Helper *helper = HelperCreate(jobs, output_dir);
+    if (helper == NULL || HelperLoadConfig(helper) != 0)
+        goto cleanup;
 
-    if (CreateJWMBinds(jwm, cfg) != 0)
-        return -1;
+    now = TraceNow();
+    durations[ConfigStage] = now - mark;
+    mark = now;
 
-    if (CreateJWMAutoStart(jwm, cfg) != 0)
-        return -1;
+    // The parallel generators overlap with the loading, so both end up in the load stage
+    if (jobs > 1)
+    {
+        if (HelperGenerate(helper, HELPER_ALL_OUTPUTS) != 0)
+            goto cleanup;
 
-    if (CreateJWMRCFile(jwm) != 0)
-        return -1;
+        now = TraceNow();
+        durations[LoadStage] = now - mark;
+        durations[GenerateStage] = 0;
+        mark = now;
+    }
+    else
+    {
+        if (HelperResolveIcons(helper) != 0)
+            goto cleanup;
+
+        now = TraceNow();
+        durations[LoadStage] = now - mark;
+        mark = now;
+
+        if (HelperGenerate(helper, HELPER_ALL_OUTPUTS) != 0)
+            goto cleanup;
+
+        now = TraceNow();
+        durations[GenerateStage] = now - mark;
+        mark = now;
+    }
+
+    ret = 0;
+
+cleanup:
+    HelperDestroy(helper);
 
-    return 0;
+    now = TraceNow();
+    durations[CleanUpStage] = now - mark;
+    durations[TotalStage] = now - start;
+    return ret;
 }
 
-static int InitializeConfig(JWM **jwm, cfg_t **cfg)
+static void RemoveBenchOutputs(const char *output_dir)
 {
-    if (*cfg != NULL && *jwm != NULL)
-    {
-        return 0;
-    }
+    char path[1024];
 
-    if (LoadJWMConfig(jwm, cfg) != 0)
-    {
-        printf("Failed to properly load the jwms.conf file! Aborting!\n");
-        return -1;
-    }
+    DIR *dir = opendir(output_dir);
+    if (dir == NULL)
+        return;
 
-    if (CreateJWMFolder(*jwm) != 0)
+    struct dirent *dirp;
+    while ((dirp = readdir(dir)) != NULL)
     {
-        return -1;
+        if (strcmp(dirp->d_name, ".") == 0 || strcmp(dirp->d_name, "..") == 0)
+            continue;
+
+        snprintf(path, sizeof(path), "%s/%s", output_dir, dirp->d_name);
+        unlink(path);
     }
 
-    return 0;
+    closedir(dir);
+    rmdir(output_dir);
 }
 
-static void CleanUp(JWM *jwm, cfg_t *cfg, HashMap *icons, BTreeNode *entries)
+static int LongLongCmp(const void *a, const void *b)
 {
-    if (icons)
-    {
-        DestroyIconThemes();
-        HashMapDestroy(icons);
-    }
-    if (entries)
-        EntriesDestroy(entries);
-    if (jwm)
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+// Percentile of an already sorted array
+#define PERCENTILE(array, count, p) ((array)[MIN((count) - 1, (size_t)((double)(count) * (p) / 100.0))])
+
+// samples holds the durations of every run for one stage after another, in microseconds
+static void ReportBench(long long *samples, int runs, int jobs)
+{
+    for (int i = 0; i < NumBenchStages; i++)
     {
-        free(jwm->autogen_config_path);
-        free(jwm);
+        if (jobs > 1 && i == GenerateStage)
+            continue;
+
+        long long *stage = &samples[i * runs];
+        qsort(stage, runs, sizeof(*stage), LongLongCmp);
+
+        printf("bench=%s runs=%d jobs=%d min_ms=%.3f median_ms=%.3f p95_ms=%.3f\n",
+               jobs > 1 && i == LoadStage ? "load_generate" : bench_stage_names[i], runs, jobs,
+               stage[0] / 1000.0, PERCENTILE(stage, (size_t)runs, 50) / 1000.0,
+               PERCENTILE(stage, (size_t)runs, 95) / 1000.0);
     }
-    if (cfg)
-        cfg_free(cfg);
 }
 
-int HandleCmd(int opt, JWM *jwm, cfg_t *cfg, BTreeNode **entries, HashMap **icons)
+// Runs --all over and over in this process, the outputs go to a scratch directory that is removed afterwards
+static int RunBench(int runs, bool cold, int jobs)
 {
-    switch (opt)
-    {
-        case 'a': // --all
-        {
-            if (*entries == NULL && LoadAllDesktopEntries(entries) != 0)
-            {
-                return EXIT_FAILURE;
-            }
-            if (*icons == NULL && LoadIcons(jwm, *entries, icons) != 0)
-            {
-                return EXIT_FAILURE;
-            }
-            return GenerateAll(jwm, cfg, *entries, *icons);
-        }
-        case 'A': // --autostart
-            return CreateJWMAutoStart(jwm, cfg);
+    char output_dir[] = "/tmp/jwm-helper-bench-XXXXXX";
 
-        case 'b': // --binds
-            return CreateJWMBinds(jwm, cfg);
+    if (mkdtemp(output_dir) == NULL)
+    {
+        fprintf(stderr, "Failed to create the scratch directory: %s\n", strerror(errno));
+        return -1;
+    }
 
-        case 'g': // --groups
-            return CreateJWMGroup(jwm);
+    DArray *inputs = cold ? CollectBenchInputs() : NULL;
+    long long *samples = calloc((size_t)runs * NumBenchStages, sizeof(*samples));
+    long long durations[NumBenchStages];
+    size_t evicted = 0;
+    long first_rss = 0;
+    long last_rss = 0;
+    long peak_rss = 0;
+    int ret = 0;
+
+    printf("Running --all %d times into %s...\n", runs, output_dir);
+
+    // The generators are chatty, keep their output out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (null_fd >= 0)
+    {
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    }
 
-        case 'i': // --icons
-            return CreateJWMIcons(jwm);
+    int run;
+    for (run = 0; run < runs; run++)
+    {
+        if (inputs != NULL)
+            evicted = EvictBenchInputs(inputs);
 
-        case 'j': // --jwmrc
-            return CreateJWMRCFile(jwm);
+        if (RunBenchIteration(output_dir, jobs, durations) != 0)
+        {
+            ret = -1;
+            break;
+        }
 
-        case 'm': // --menu
+        for (int i = 0; i < NumBenchStages; i++)
         {
-            if (*entries == NULL && LoadAllDesktopEntries(entries) != 0)
-            {
-                return EXIT_FAILURE;
-            }
-            if (*icons == NULL && LoadIcons(jwm, *entries, icons) != 0)
-            {
-                return EXIT_FAILURE;
-            }
-            return CreateJWMRootMenu(jwm, *entries, *icons, NULL);
+            samples[i * runs + run] = durations[i];
         }
 
-        case 'p': // --prefs
-            return CreateJWMPreferences(jwm);
+        last_rss = CurrentRSS();
+        peak_rss = MAX(peak_rss, last_rss);
+        if (run == 0)
+            first_rss = last_rss;
+    }
 
-        case 's': // --styles
-            return CreateJWMStyles(jwm);
+    fflush(stdout);
+    if (saved_stdout >= 0)
+    {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+    }
 
-        case 't': // --tray
-        {
-            if (*entries == NULL && LoadAllDesktopEntries(entries) != 0)
-            {
-                return EXIT_FAILURE;
-            }
-            if (*icons == NULL && LoadIcons(jwm, *entries, icons) != 0)
-            {
-                return EXIT_FAILURE;
-            }
-            return CreateJWMTray(jwm, *entries, *icons);
-        }
-        default:
-            return EXIT_FAILURE;
+    if (ret == 0)
+    {
+        ReportBench(samples, runs, jobs);
+
+        // The kernel updates ru_maxrss lazily, it can lag behind what was just read from /proc
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        peak_rss = MAX(peak_rss, usage.ru_maxrss);
+        printf("bench=rss peak_kb=%ld first_run_kb=%ld last_run_kb=%ld\n", peak_rss, first_rss, last_rss);
+
+        if (cold)
+            printf("bench=cold inputs=%zu evicted=%zu\n", inputs->size, evicted);
     }
+    else
+    {
+        printf("Run %d failed, run --all on its own to see why\n", run + 1);
+    }
+
+    if (inputs != NULL)
+        DArrayDestroy(inputs);
+    free(samples);
+    RemoveBenchOutputs(output_dir);
+    return ret;
 }
 
 int main(int argc, char *argv[])
 {
-    JWM *jwm = NULL;
-    cfg_t *cfg = NULL;
-    BTreeNode *entries = NULL;
-    HashMap *icons = NULL;
+    Helper *helper = NULL;
+    const char *trace_path = NULL;
+    bool print_stats = false;
+    bool stats_json = false;
+    bool force = false;
+    bool cold = false;
+    bool report_changes = false;
+    bool outputs_snapshot = false;
+    bool daemon_mode = false;
+    bool client_mode = false;
+    char socket_path[108] = "\0";
+    int bench_runs = 0;
+    int jobs = 1;
+
+    int actions[ARRAY_SIZE(long_opts)];
+    size_t num_actions = 0;
 
     if (argc < 2)
     {
@@ -267,10 +435,13 @@ int main(int argc, char *argv[])
         return EXIT_SUCCESS;
     }
 
-    // Handle help and version options explicitly first
+    if (HelperReadEnvironment() != 0)
+        return EXIT_FAILURE;
+
+    // Handle help, version and modifier options first, the generators run afterwards in the given order
     int opt;
     int index = 0;
-    while ((opt = getopt_long(argc, argv, "hvaAbgijmpst", long_opts,
+    while ((opt = getopt_long(argc, argv, "hvafJ:Abgijmpst", long_opts,
                               &index)) != -1)
     {
         switch (opt)
@@ -282,31 +453,183 @@ int main(int argc, char *argv[])
             case 'v': // --version
                 About();
                 return EXIT_SUCCESS;
+
+            case 'f': // --force
+                force = true;
+                break;
+
+            case 'J': // --jobs
+            {
+                char *end;
+                long value = strtol(optarg, &end, 10);
+                if (*end != '\0' || value < 1)
+                {
+                    printf("Invalid number of jobs: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                jobs = MIN(value, NumGenerators);
+                break;
+            }
+
+            case 'T': // --trace
+                if (!TraceAvailable())
+                {
+                    printf("Tracing is not available in this build, rebuild with \"make TRACE=1\"\n");
+                    break;
+                }
+                trace_path = optarg;
+                TraceStart();
+                break;
+
+            case 'S': // --stats
+                if (optarg != NULL && strcmp(optarg, "json") != 0)
+                {
+                    printf("Invalid stats format: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                print_stats = true;
+                stats_json = optarg != NULL;
+                StatsStart();
+                break;
+
+            case 'B': // --bench
+            {
+                char *end;
+                long value = strtol(optarg, &end, 10);
+                if (*end != '\0' || value < 1 || value > 100000)
+                {
+                    printf("Invalid number of bench runs: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                bench_runs = value;
+                break;
+            }
+
+            case 'C': // --cold
+                cold = true;
+                break;
+
+            case 'R': // --report-changes
+                report_changes = true;
+                break;
+
+            case 'N': // --daemon
+                daemon_mode = true;
+                break;
+            case 'K': // --client
+                client_mode = true;
+                break;
+            case 'O': // --socket
+                strlcpy(socket_path, optarg, sizeof(socket_path));
+                break;
+            case 'D': // --app-dir
+                if (HelperSetAppDir(optarg) != 0)
+                    return EXIT_FAILURE;
+                break;
+
+            case 'I': // --icon-dir
+                if (SetIconBaseDir(optarg) != 0)
+                    return EXIT_FAILURE;
+                break;
+
             case '?':
                 Usage();
                 Help();
                 return EXIT_FAILURE;
 
             default:
-                if (InitializeConfig(&jwm, &cfg) != 0)
-                {
-                    goto failure;
-                }
+                if (num_actions < ARRAY_SIZE(actions))
+                    actions[num_actions++] = opt;
+                break;
+        }
+    }
 
-                if (HandleCmd(opt, jwm, cfg, &entries, &icons) != 0)
-                {
-                    goto failure;
-                }
+    // The bench replaces the actions and never touches the fingerprint
+    if (bench_runs > 0)
+    {
+        int ret = RunBench(bench_runs, cold, jobs);
+        WriteTrace(trace_path);
+        if (print_stats)
+            StatsPrint(stats_json);
+        return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (socket_path[0] == '\0')
+        DaemonSocketPath(socket_path, sizeof(socket_path));
+
+    // The words after the options make up the request
+    if (client_mode)
+    {
+        char request[1024] = "\0";
+        for (int i = optind; i < argc; i++)
+        {
+            if (i > optind)
+                strlcat(request, " ", sizeof(request));
+            strlcat(request, argv[i], sizeof(request));
         }
 
+        return DaemonRequest(socket_path, request) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    helper = HelperCreate(jobs, NULL);
+    if (helper == NULL)
+        goto failure;
+
+    if (daemon_mode)
+    {
+        int ret = DaemonRun(helper, socket_path);
+        HelperDestroy(helper);
+        WriteTrace(trace_path);
+        if (print_stats)
+            StatsPrint(stats_json);
+        return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+
+    for (size_t i = 0; i < num_actions; i++)
+    {
+        opt = actions[i];
+
         if (opt == 'a')
+        {
+            HelperStatus all_status = HelperGenerateAll(helper, force);
+            if (all_status == HelperFailed)
+                goto failure;
+
+            if (report_changes)
+                status = all_status;
+
+            outputs_snapshot = false;
             break;
+        }
+
+        if (report_changes && !outputs_snapshot)
+        {
+            if (HelperSnapshotOutputs(helper) != 0)
+                goto failure;
+            outputs_snapshot = true;
+        }
+
+        if (HelperGenerate(helper, HELPER_OUTPUT(OptionGenerator(opt))) != 0)
+        {
+            goto failure;
+        }
     }
 
-    CleanUp(jwm, cfg, icons, entries);
-    return EXIT_SUCCESS;
+    if (outputs_snapshot)
+        status = HelperReportChanges(helper);
+
+    HelperDestroy(helper);
+    WriteTrace(trace_path);
+    if (print_stats)
+        StatsPrint(stats_json);
+    return status;
 
 failure:
-    CleanUp(jwm, cfg, icons, entries);
+    HelperDestroy(helper);
+    WriteTrace(trace_path);
+    if (print_stats)
+        StatsPrint(stats_json);
     return EXIT_FAILURE;
 }
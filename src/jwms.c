@@ -1,28 +1,78 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <signal.h>
+#include <sched.h>
 #include <sys/syslog.h>
 #include <sys/wait.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <time.h>
 #include <unistd.h>
 #include <limits.h>
 #include <errno.h>
-#include <fcntl.h>
 
 #include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+
+#include "common.h"
+#include "darray.h"
+#include "event_loop.h"
+#include "supervisor.h"
+#include "autostart.h"
+#include "helper_status.h"
+#include "helper.h"
+#include "app_watch.h"
+#include "readahead.h"
+#include "trace.h"
 
-static void SignalHandler(int signal)
+// Everything the session waits for, jwm, the autostart programs, signals, the X server and the application
+// directories, goes through one event loop in one thread. The generators of jwm-helper run in a thread of
+// their own and tell the loop when they are done through an eventfd.
+typedef struct
 {
-    switch (signal)
-    {
-        case SIGINT:
-        case SIGTERM:
-            syslog(LOG_NOTICE, "JWMS: Received termination signal. Stopping session...");
-            exit(0);
-            break;
-        default:
-            break;
-    }
-}
+    EventLoop loop;
+    Supervisor supervisor;
+    Autostart autostart;
+    bool autostart_started;
+
+    int signals;
+    EventSource *signal_source;
+
+    // Watches WM_S0, a restarted jwm takes it over again
+    Display *display;
+    Atom wm_selection;
+    EventSource *display_source;
+    bool wm_ready;
+
+    bool fast_start;
+    // Loaded once and reused by every run after, SIGHUP runs the generators again
+    Helper *helper;
+    pthread_t helper_thread;
+    bool helper_running;
+    // A SIGHUP while the generators run, they run once more afterwards
+    bool helper_rerun;
+    // A full run that can't trust the fingerprint, the app watch lost events and edits may be missing from it
+    bool helper_force;
+    bool helper_rerun_force;
+    int helper_event;
+    EventSource *helper_source;
+    // What JWM hasn't been told about yet, the most it needs of every run since it was last told
+    HelperStatus pending_status;
+    // Desktop files that changed, they get patched into the loaded entries once the generators are free
+    AppWatch app_watch;
+    DArray *changed_entries;
+    // The ones the running generators work on, NULL for a full run
+    DArray *helper_batch;
+    const char *helper_mark;
+
+    const char *trace_path;
+} Session;
 
 static int CheckForOtherWM(void)
 {
@@ -53,85 +103,526 @@ static int CheckForOtherWM(void)
     return 0;
 }
 
-int main(int argc, char *argv[])
+// A fingerprint is only left behind by a jwm-helper run that wrote every file, so JWM can start from those
+static bool HasLastGoodConfig(void)
 {
-    signal(SIGINT, SignalHandler);
-    signal(SIGTERM, SignalHandler);
+    const char *home = getenv("HOME");
+    if (home == NULL)
+        return false;
 
-    syslog(LOG_INFO, "JWMS: Starting JWMS");
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/.config/jwm/.fingerprint", home);
+    if (access(path, F_OK) != 0)
+        return false;
 
-    if (CheckForOtherWM() != 0)
+    snprintf(path, sizeof(path), "%s/.jwmrc", home);
+    return access(path, F_OK) == 0;
+}
+
+static pid_t SpawnJWM(void *data)
+{
+    char *jwm_args[] = { "jwm", NULL };
+
+    (void)data;
+    return SpawnProgram("jwm", jwm_args);
+}
+
+static pid_t SpawnJWMAction(void *data)
+{
+    char *jwm_args[] = { "jwm", data, NULL };
+    return SpawnProgram("jwm", jwm_args);
+}
+
+// Tells JWM about what the generators changed in the config it was started with
+static void UpdateRunningJWM(Session *session)
+{
+    const char *action = NULL;
+
+    switch (session->pending_status)
     {
-        return EXIT_FAILURE;
+        case HelperReloadMenu:
+            action = "-reload";
+            break;
+        case HelperRestart:
+            action = "-restart";
+            break;
+        default:
+            syslog(LOG_INFO, "JWMS: The generated config did not change");
+            return;
     }
 
-    char *jwm_helper_args[] = { "jwm-helper", "-a", NULL };
+    syslog(LOG_INFO, "JWMS: Running jwm %s", action);
+    if (SupervisorRunOnce(&session->supervisor, action, SpawnJWMAction, (void*)action) == 0)
+        session->pending_status = HelperUnchanged;
+}
 
-    pid_t jwm_helper_pid = fork();
-    if (jwm_helper_pid < 0)
+// A restart covers a reload, and a failed run changed nothing
+static void AddPendingStatus(Session *session, HelperStatus status)
+{
+    if (status == HelperFailed)
     {
-        syslog(LOG_ERR, "JWMS: Failed to create child process for jwm-helper: %s", strerror(errno));
-        return EXIT_FAILURE;
+        syslog(LOG_ERR, "JWMS: jwm-helper failed, jwm keeps running with the last config");
+        return;
+    }
+
+    if (status > session->pending_status)
+        session->pending_status = status;
+}
+
+static void WriteTrace(const char *path)
+{
+    if (path != NULL && TraceWrite(path) != 0)
+        syslog(LOG_ERR, "JWMS: Failed to write the trace to %s", path);
+}
+
+static void CloseDisplay(Session *session)
+{
+    if (session->display == NULL)
+        return;
+
+    EventLoopRemove(&session->loop, session->display_source);
+    XCloseDisplay(session->display);
+    session->display = NULL;
+    session->display_source = NULL;
+}
+
+// JWM manages the screen, the autostart programs can come and it listens for -reload and -restart from now on
+static void WMReady(Session *session)
+{
+    session->wm_ready = true;
+    syslog(LOG_INFO, "JWMS: jwm is running");
+
+    if (session->pending_status != HelperUnchanged)
+        UpdateRunningJWM(session);
+
+    if (!session->autostart_started)
+    {
+        session->autostart_started = true;
+        if (AutostartStart(&session->autostart, &session->loop, &session->supervisor) != 0)
+            syslog(LOG_ERR, "JWMS: Failed to start the autostart programs");
+    }
+
+    // The session can last for a long time, so write what we have so far
+    WriteTrace(session->trace_path);
+}
+
+static void OnDisplay(uint32_t events, void *data)
+{
+    Session *session = data;
+
+    (void)events;
+
+    while (XPending(session->display))
+    {
+        XEvent event;
+        XNextEvent(session->display, &event);
+    }
+
+    if (!session->wm_ready && XGetSelectionOwner(session->display, session->wm_selection) != None)
+        WMReady(session);
+}
+
+// A new owner of WM_S0 is an XFixes event. Without XFixes JWM setting _NET_SUPPORTING_WM_CHECK on the root
+// window wakes the loop up just as well.
+static int WatchForWM(Session *session)
+{
+    int event_base;
+    int error_base;
+
+    session->display = XOpenDisplay(NULL);
+    if (session->display == NULL)
+    {
+        syslog(LOG_ERR, "JWMS: Failed to open X display.");
+        return -1;
     }
 
-    if (jwm_helper_pid == 0)
+    Window root = DefaultRootWindow(session->display);
+    session->wm_selection = XInternAtom(session->display, "WM_S0", False);
+    XSelectInput(session->display, root, PropertyChangeMask | StructureNotifyMask);
+    if (XFixesQueryExtension(session->display, &event_base, &error_base))
+        XFixesSelectSelectionInput(session->display, root, session->wm_selection, XFixesSetSelectionOwnerNotifyMask);
+
+    XFlush(session->display);
+
+    session->display_source = EventLoopAdd(&session->loop, ConnectionNumber(session->display), OnDisplay, session);
+    return session->display_source != NULL ? 0 : -1;
+}
+
+// For bench/login.sh, the time the generators were done on the clock it measures with
+static void WriteHelperMark(Session *session)
+{
+    if (session->helper_mark == NULL)
+        return;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    FILE *fp = fopen(session->helper_mark, "a");
+    if (fp != NULL)
     {
-        //const char *username = getenv("USER");
-        //const char *home = getenv("HOME");
-        //syslog(LOG_INFO, "JWMS: Logged as user: %s", username);
-        //syslog(LOG_INFO, "JWMS: Home dir at: %s", home);
+        fprintf(fp, "%lld\n", (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+        fclose(fp);
+    }
+}
+
+// The status is handed back through pthread_join, the main thread only looks at it once the run is over
+static void *GenerateThread(void *data)
+{
+    Session *session = data;
+    DArray *batch = session->helper_batch;
+    HelperStatus status;
+    uint64_t done = 1;
+
+    if (batch != NULL)
+        status = HelperUpdateEntries(session->helper, (char**)batch->data, batch->size);
+    else
+        status = HelperGenerateAll(session->helper, session->helper_force);
+
+    while (write(session->helper_event, &done, sizeof(done)) < 0 && errno == EINTR);
+    return (void*)(intptr_t)status;
+}
+
+static void StartHelper(Session *session, DArray *batch)
+{
+    if (batch != NULL)
+        syslog(LOG_INFO, "JWMS: Updating the menu for %zu desktop files...", batch->size);
+    else
+        syslog(LOG_INFO, "JWMS: Generating the JWM config...");
+
+    session->helper_batch = batch;
+
+    if (pthread_create(&session->helper_thread, NULL, GenerateThread, session) != 0)
+    {
+        syslog(LOG_ERR, "JWMS: Failed to create the thread for jwm-helper: %s", strerror(errno));
+        session->helper_batch = NULL;
+        if (batch != NULL)
+            DArrayDestroy(batch);
+        return;
+    }
+
+    session->helper_running = true;
+}
+
+static void StartGenerating(Session *session, bool force)
+{
+    if (session->helper_running)
+    {
+        session->helper_rerun = true;
+        session->helper_rerun_force |= force;
+        return;
+    }
+
+    // A full run reads every desktop file again
+    if (session->changed_entries != NULL)
+    {
+        DArrayDestroy(session->changed_entries);
+        session->changed_entries = NULL;
+    }
+
+    session->helper_force = force;
+    StartHelper(session, NULL);
+}
+
+// Otherwise the changes wait for the running generators to be done
+static void StartUpdating(Session *session)
+{
+    if (session->helper_running || session->changed_entries == NULL)
+        return;
+
+    DArray *batch = session->changed_entries;
+    session->changed_entries = NULL;
+    StartHelper(session, batch);
+}
+
+static void OnAppsChanged(DArray *paths, void *data)
+{
+    Session *session = data;
 
-        syslog(LOG_INFO, "JWMS: Running jwm-helper...");
-        // Child process: Execute jwm-helper
-        if (execvp("jwm-helper", jwm_helper_args) < 0)
+    // The events were lost, only a forced run catches the desktop files edited in place
+    if (paths == NULL)
+    {
+        StartGenerating(session, true);
+        return;
+    }
+
+    if (session->changed_entries == NULL)
+    {
+        session->changed_entries = paths;
+    }
+    else
+    {
+        for (size_t i = 0; i < paths->size; i++)
+            DArrayAdd(session->changed_entries, strdup(paths->data[i]));
+
+        DArrayDestroy(paths);
+    }
+
+    StartUpdating(session);
+}
+
+static void OnHelperDone(uint32_t events, void *data)
+{
+    Session *session = data;
+    uint64_t done;
+
+    (void)events;
+
+    if (read(session->helper_event, &done, sizeof(done)) != sizeof(done))
+        return;
+
+    void *result;
+    pthread_join(session->helper_thread, &result);
+    session->helper_running = false;
+
+    HelperStatus status = (HelperStatus)(intptr_t)result;
+    syslog(LOG_INFO, "JWMS: jwm-helper finished with status %d", status);
+    AddPendingStatus(session, status);
+
+    if (session->helper_batch != NULL)
+    {
+        DArrayDestroy(session->helper_batch);
+        session->helper_batch = NULL;
+    }
+    WriteHelperMark(session);
+
+    // Otherwise this happens once jwm is up
+    if (session->wm_ready)
+        UpdateRunningJWM(session);
+
+    if (session->helper_rerun)
+    {
+        bool force = session->helper_rerun_force;
+        session->helper_rerun = false;
+        session->helper_rerun_force = false;
+        StartGenerating(session, force);
+    }
+    else
+    {
+        StartUpdating(session);
+    }
+}
+
+static void JWMExited(Process *process, int status, bool restarting, void *data)
+{
+    Session *session = data;
+
+    (void)process;
+
+    if (restarting)
+    {
+        // The next owner of WM_S0 is the restarted jwm, nothing gets sent to it twice
+        session->wm_ready = false;
+        return;
+    }
+
+    if (WIFSIGNALED(status))
+        syslog(LOG_INFO, "JWMS: jwm was terminated by signal %d", WTERMSIG(status));
+
+    EventLoopStop(&session->loop);
+}
+
+static void OnSignal(uint32_t events, void *data)
+{
+    Session *session = data;
+    struct signalfd_siginfo info;
+
+    (void)events;
+
+    while (read(session->signals, &info, sizeof(info)) == sizeof(info))
+    {
+        switch (info.ssi_signo)
         {
-            syslog(LOG_ERR, "JWMS: jwm-helper failed to run: %s", strerror(errno));
-            return EXIT_FAILURE;
+            case SIGINT:
+            case SIGTERM:
+                syslog(LOG_NOTICE, "JWMS: Received termination signal. Stopping session...");
+                EventLoopStop(&session->loop);
+                break;
+            case SIGCHLD:
+                SupervisorReap(&session->supervisor);
+                break;
+            case SIGUSR1:
+                SupervisorPrintStats(&session->supervisor);
+                WriteTrace(session->trace_path);
+                break;
+            case SIGHUP:
+                StartGenerating(session, false);
+                break;
+            default:
+                break;
         }
     }
+}
+
+// The signals are blocked and read from a signalfd in the loop, SpawnProgram unblocks them for the children
+static int WatchSignals(Session *session)
+{
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGUSR1);
+    sigaddset(&mask, SIGHUP);
+
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) != 0)
+        return -1;
 
-    // Wait for jwm-helper to finish
-    int jwm_helper_status;
-    if (waitpid(jwm_helper_pid, &jwm_helper_status, 0) < 0)
+    session->signals = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (session->signals < 0)
     {
-        syslog(LOG_ERR, "JWMS: Error waiting for jwm-helper: %s", strerror(errno));
+        syslog(LOG_ERR, "JWMS: Failed to create the signalfd: %s", strerror(errno));
+        return -1;
     }
-    else if (WIFEXITED(jwm_helper_status))
+
+    session->signal_source = EventLoopAdd(&session->loop, session->signals, OnSignal, session);
+    return session->signal_source != NULL ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    Session session = { 0 };
+    bool sync = false;
+    bool print_stats = false;
+
+    session.signals = -1;
+    session.helper_event = -1;
+
+    for (int i = 1; i < argc; i++)
     {
-        syslog(LOG_INFO, "JWMS: jwm-helper exited with status %d", WEXITSTATUS(jwm_helper_status));
+        if (strncmp(argv[i], "--trace=", 8) == 0 && argv[i][8] != '\0')
+        {
+            session.trace_path = argv[i] + 8;
+        }
+        else if (strcmp(argv[i], "--sync") == 0)
+        {
+            sync = true;
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            print_stats = true;
+        }
+        else if (strncmp(argv[i], "--helper-mark=", 14) == 0 && argv[i][14] != '\0')
+        {
+            session.helper_mark = argv[i] + 14;
+        }
     }
 
-    // jwm-helper is done, let's now start JWM
-    pid_t jwm_pid = fork();
-    if (jwm_pid < 0)
+    syslog(LOG_INFO, "JWMS: Starting JWMS");
+
+    if (session.trace_path != NULL)
+    {
+        if (TraceAvailable())
+        {
+            TraceStart();
+        }
+        else
+        {
+            syslog(LOG_ERR, "JWMS: Tracing is not available in this build");
+            session.trace_path = NULL;
+        }
+    }
+
+    if (CheckForOtherWM() != 0)
     {
-        syslog(LOG_ERR, "JWMS: Failed to create child process for jwm: %s", strerror(errno));
         return EXIT_FAILURE;
     }
 
-    if (jwm_pid == 0)
+    if (EventLoopInit(&session.loop) != 0 || WatchSignals(&session) != 0 ||
+        SupervisorInit(&session.supervisor, &session.loop) != 0)
     {
-        syslog(LOG_INFO, "JWMS: Starting jwm");
-        // Child process: Execute JWM
-        if (execlp("jwm", "jwm", NULL) < 0)
-        {
-            syslog(LOG_ERR, "JWMS: jwm failed to run: %s", strerror(errno));
-            return EXIT_FAILURE;
-        }
+        return EXIT_FAILURE;
     }
 
-    // Wait for JWM to finish
-    int jwm_status;
-    syslog(LOG_INFO, "JWMS: Session manager running...");
+    // The files the last login read go into the page cache while jwm-helper, JWM and the autostart programs start.
+    // The thread inherits the blocked signals, so they still only arrive through the signalfd.
+    char readahead_path[PATH_MAX];
+    if (ExpandPath(readahead_path, READAHEAD_LIST_PATH, sizeof(readahead_path)) == 0)
+        ReadaheadStart(readahead_path);
 
-    if (waitpid(jwm_pid, &jwm_status, 0) < 0)
+    // With the config of the last successful run still around, JWM starts right away and jwm-helper catches up
+    // in the background. The first login, or one after a failed run, waits for jwm-helper like --sync does.
+    session.fast_start = !sync && HasLastGoodConfig();
+
+    // The session still has to come up, the directory that was too long stays the default one
+    if (HelperReadEnvironment() != 0)
+        syslog(LOG_ERR, "JWMS: Ignoring JWMS_APP_DIR or JWMS_ICON_DIR, the path is too long");
+    session.helper = HelperCreate(1, NULL);
+    if (session.helper != NULL)
+        HelperSetNativeAutostart(session.helper, true);
+
+    session.helper_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (session.helper == NULL || session.helper_event < 0)
     {
-        syslog(LOG_ERR, "JWMS: Error waiting for jwm: %s", strerror(errno));
+        return EXIT_FAILURE;
     }
-    else if (WIFSIGNALED(jwm_status))
+
+    session.helper_source = EventLoopAdd(&session.loop, session.helper_event, OnHelperDone, &session);
+
+    // Watched before the first run, a program installed while the session starts still makes it to the menu
+    if (AppWatchStart(&session.app_watch, &session.loop, OnAppsChanged, &session) != 0)
+        syslog(LOG_ERR, "JWMS: The menu won't follow programs being installed or removed");
+
+    // libconfuse's parser isn't reentrant, so jwms.conf is read for the autostart programs before the
+    // generators get to read it in their thread
+    if (AutostartLoad(&session.autostart) != 0)
     {
-        syslog(LOG_INFO, "JWMS:jwm was terminated by signal %d", WTERMSIG(jwm_status));
+        syslog(LOG_ERR, "JWMS: Failed to read the autostart programs");
     }
 
+    if (session.fast_start)
+    {
+        StartGenerating(&session, false);
+    }
+    else
+    {
+        // Nothing else is running yet, JWM can only start once there is a config
+        syslog(LOG_INFO, "JWMS: Generating the JWM config...");
+        HelperStatus status = HelperGenerateAll(session.helper, false);
+        syslog(LOG_INFO, "JWMS: jwm-helper finished with status %d", status);
+        WriteHelperMark(&session);
+    }
+
+    // Watching WM_S0 before jwm starts means its taking over can't be missed
+    WatchForWM(&session);
+
+    // The generators are done, or replace the files they change atomically, let's now start JWM.
+    // A crashed JWM gets started again, the session only ends when it exits on its own.
+    syslog(LOG_INFO, "JWMS: Starting jwm");
+
+    if (SupervisorStart(&session.supervisor, "jwm", SpawnJWM, JWMExited, &session, true) == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    syslog(LOG_INFO, "JWMS: Session manager running...");
+
+    EventLoopRun(&session.loop);
+
+    WriteTrace(session.trace_path);
+
+    if (print_stats)
+        SupervisorPrintStats(&session.supervisor);
+
+    // A run that is still going has to finish before what it works on can be freed
+    if (session.helper_running)
+        pthread_join(session.helper_thread, NULL);
+
+    AppWatchDestroy(&session.app_watch);
+    if (session.helper_batch != NULL)
+        DArrayDestroy(session.helper_batch);
+    if (session.changed_entries != NULL)
+        DArrayDestroy(session.changed_entries);
+
+    HelperDestroy(session.helper);
+    EventLoopRemove(&session.loop, session.helper_source);
+    close(session.helper_event);
+    AutostartDestroy(&session.autostart);
+    CloseDisplay(&session);
+    SupervisorDestroy(&session.supervisor);
+    EventLoopRemove(&session.loop, session.signal_source);
+    close(session.signals);
+    EventLoopDestroy(&session.loop);
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,215 @@
+// readahead() is only exposed with _GNU_SOURCE
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#include "readahead.h"
+#include "trace.h"
+
+typedef struct
+{
+    char *path;
+    dev_t dev;
+    // Where the first extent starts on the disk, the inode number on file systems without FIEMAP
+    bool mapped;
+    uint64_t location;
+    off_t size;
+} ReadaheadFile;
+
+typedef struct
+{
+    ReadaheadFile *files;
+    size_t num_files;
+} ReadaheadList;
+
+static int StrPtrCmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+int ReadaheadWrite(const char *path, char **files, size_t num_files)
+{
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    qsort(files, num_files, sizeof(char*), StrPtrCmp);
+
+    for (size_t i = 0; i < num_files; i++)
+    {
+        if (i == 0 || strcmp(files[i - 1], files[i]) != 0)
+            fprintf(fp, "%s\n", files[i]);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static void ReadaheadListDestroy(ReadaheadList *list)
+{
+    for (size_t i = 0; i < list->num_files; i++)
+        free(list->files[i].path);
+
+    free(list->files);
+    free(list);
+}
+
+static ReadaheadList *ReadaheadListLoad(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL)
+        return NULL;
+
+    ReadaheadList *list = calloc(1, sizeof(*list));
+    size_t capacity = 0;
+    char *line = NULL;
+    size_t len = 0;
+
+    while (list != NULL && getline(&line, &len, fp) != -1)
+    {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] != '/')
+            continue;
+
+        if (list->num_files == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 256;
+            ReadaheadFile *files = realloc(list->files, sizeof(ReadaheadFile) * capacity);
+            if (files == NULL)
+                break;
+
+            list->files = files;
+        }
+
+        list->files[list->num_files++] = (ReadaheadFile){ .path = strdup(line) };
+    }
+
+    free(line);
+    fclose(fp);
+    return list;
+}
+
+// Opening the file already brings its inode in, the contents follow once the list is sorted
+static void LocateFile(ReadaheadFile *file)
+{
+    int fd = file->path != NULL ? open(file->path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return;
+    }
+
+    file->dev = st.st_dev;
+    file->size = st.st_size;
+    file->location = st.st_ino;
+
+    struct
+    {
+        struct fiemap map;
+        struct fiemap_extent extent;
+    } fiemap = { .map = { .fm_start = 0, .fm_length = FIEMAP_MAX_OFFSET, .fm_extent_count = 1 } };
+
+    if (ioctl(fd, FS_IOC_FIEMAP, &fiemap) == 0 && fiemap.map.fm_mapped_extents > 0)
+    {
+        file->mapped = true;
+        file->location = fiemap.extent.fe_physical;
+    }
+
+    close(fd);
+}
+
+static int ReadaheadFileCmp(const void *a, const void *b)
+{
+    const ReadaheadFile *fa = a;
+    const ReadaheadFile *fb = b;
+
+    if (fa->dev != fb->dev)
+        return fa->dev < fb->dev ? -1 : 1;
+    if (fa->mapped != fb->mapped)
+        return fa->mapped ? -1 : 1;
+    if (fa->location != fb->location)
+        return fa->location < fb->location ? -1 : 1;
+
+    return 0;
+}
+
+static void *ReadaheadThread(void *data)
+{
+    ReadaheadList *list = data;
+    long long start = TRACE_NOW();
+    size_t done = 0;
+
+    for (size_t i = 0; i < list->num_files; i++)
+        LocateFile(&list->files[i]);
+
+    // Files that couldn't be opened have a size of 0 and are skipped
+    qsort(list->files, list->num_files, sizeof(ReadaheadFile), ReadaheadFileCmp);
+
+    for (size_t i = 0; i < list->num_files; i++)
+    {
+        ReadaheadFile *file = &list->files[i];
+        if (file->size <= 0)
+            continue;
+
+        int fd = open(file->path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        // Some file systems don't support readahead(), the hint does the same there
+        if (readahead(fd, 0, file->size) != 0)
+            posix_fadvise(fd, 0, file->size, POSIX_FADV_WILLNEED);
+
+        close(fd);
+        done++;
+    }
+
+    TRACE_EVENT_FMT(start, TRACE_NOW(), "readahead %zu files", done);
+    ReadaheadListDestroy(list);
+    return NULL;
+}
+
+// Opening and stating cold files blocks, so it gets a thread of its own instead of holding up the caller
+int ReadaheadStart(const char *path)
+{
+    ReadaheadList *list = ReadaheadListLoad(path);
+    if (list == NULL)
+        return -1;
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    int ret = pthread_create(&thread, &attr, ReadaheadThread, list);
+    pthread_attr_destroy(&attr);
+
+    if (ret != 0)
+    {
+        ReadaheadListDestroy(list);
+        return -1;
+    }
+
+    return 0;
+}
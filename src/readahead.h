@@ -0,0 +1,14 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+// The files a login reads: the config, the desktop files and icon themes jwm-helper loads, the icons and
+// outputs JWM loads and the programs that get started. jwm-helper writes the list after --all and jwms reads
+// it ahead at the next login, in the order the files are laid out on disk.
+#define READAHEAD_LIST_PATH "~/.config/jwm/.readahead"
+
+// Sorts files and leaves out the duplicates
+int ReadaheadWrite(const char *path, char **files, size_t num_files);
+// Reads the files ahead from a detached thread, -1 if there is no list
+int ReadaheadStart(const char *path);
+
+#endif
@@ -0,0 +1,175 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "stats.h"
+
+Stats stats;
+bool stats_enabled = false;
+
+static const char *map_group_names[] =
+{
+    "other",
+    "icon_dirs",
+    "resolved_icons",
+    "themes"
+};
+
+static const char *icon_phase_names[] =
+{
+    "absolute_path",
+    "exact_size",
+    "scalable",
+    "fallback_size",
+    "inherited_theme",
+    "not_found"
+};
+
+void StatsStart(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    stats_enabled = true;
+}
+
+void StatsRecordProbe(MapStatsGroup group, unsigned long long probes)
+{
+    if (!stats_enabled)
+        return;
+
+    MapStats *map = &stats.maps[group];
+
+    __atomic_fetch_add(&map->gets, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&map->probes, probes, __ATOMIC_RELAXED);
+
+    unsigned long long max_probe = __atomic_load_n(&map->max_probe, __ATOMIC_RELAXED);
+    while (probes > max_probe &&
+           !__atomic_compare_exchange_n(&map->max_probe, &max_probe, probes, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static double AverageProbe(const MapStats *map)
+{
+    return map->gets ? (double)map->probes / map->gets : 0.0;
+}
+
+static void StatsPrintJSON(void)
+{
+    printf("{\n");
+    printf("  \"access\": {\"backup\": %llu, \"hybrid\": %llu, \"linear\": %llu, \"absolute_path\": %llu},\n",
+           stats.access_backup, stats.access_hybrid, stats.access_linear, stats.access_absolute);
+    printf("  \"icon_dirs\": {\"fully_indexed\": %llu, \"partially_indexed\": %llu, \"files_indexed\": %llu},\n",
+           stats.dirs_fully_indexed, stats.dirs_partially_indexed, stats.files_indexed);
+
+    printf("  \"hash_maps\": {");
+    for (int i = 0; i < NumMapStats; i++)
+    {
+        const MapStats *map = &stats.maps[i];
+        printf("%s\n    \"%s\": {\"gets\": %llu, \"avg_probe\": %.2f, \"max_probe\": %llu}",
+               i ? "," : "", map_group_names[i], map->gets, AverageProbe(map), map->max_probe);
+    }
+    printf("\n  },\n");
+
+    printf("  \"icons\": {");
+    for (int i = 0; i < NumIconPhases; i++)
+    {
+        printf("%s\"%s\": %llu", i ? ", " : "", icon_phase_names[i], stats.icon_phases[i]);
+    }
+    printf("}");
+
+    printf(",\n  \"arenas\": {\"allocs\": %llu, \"chunks\": %llu, \"bytes\": %llu}",
+           stats.arena_allocs, stats.arena_chunks, stats.arena_bytes);
+
+    printf(",\n  \"interned\": {\"lookups\": %llu, \"strings\": %llu, \"bytes\": %llu}",
+           stats.intern_lookups, stats.interned_strings, stats.interned_bytes);
+
+#ifdef ALLOC_STATS_ENABLED
+    printf(",\n  \"allocations\": {\"allocs\": %llu, \"frees\": %llu, \"bytes\": %llu}",
+           stats.allocs, stats.frees, stats.bytes_allocated);
+#endif
+
+    printf("\n}\n");
+}
+
+void StatsPrint(bool json)
+{
+    // Don't count the allocations made while printing
+    stats_enabled = false;
+
+    if (json)
+    {
+        StatsPrintJSON();
+        return;
+    }
+
+    printf("\nStats:\n");
+    printf("  access() calls      : backup %llu, hybrid %llu, linear %llu, absolute path %llu\n",
+           stats.access_backup, stats.access_hybrid, stats.access_linear, stats.access_absolute);
+    printf("  Icon dirs indexed   : fully %llu, partially %llu (%llu files)\n",
+           stats.dirs_fully_indexed, stats.dirs_partially_indexed, stats.files_indexed);
+
+    for (int i = 0; i < NumMapStats; i++)
+    {
+        const MapStats *map = &stats.maps[i];
+        printf("  HashMapGet %-15s: %llu calls, avg probe %.2f, max probe %llu\n",
+               map_group_names[i], map->gets, AverageProbe(map), map->max_probe);
+    }
+
+    printf("  Icons resolved      :");
+    for (int i = 0; i < NumIconPhases; i++)
+    {
+        printf("%s %s %llu", i ? "," : "", icon_phase_names[i], stats.icon_phases[i]);
+    }
+    printf("\n");
+
+    printf("  Arenas              : %llu allocs in %llu chunks, %llu bytes\n",
+           stats.arena_allocs, stats.arena_chunks, stats.arena_bytes);
+    printf("  Interned strings    : %llu lookups, %llu unique, %llu bytes\n",
+           stats.intern_lookups, stats.interned_strings, stats.interned_bytes);
+
+#ifdef ALLOC_STATS_ENABLED
+    printf("  Allocations         : %llu allocs, %llu frees, %llu bytes\n",
+           stats.allocs, stats.frees, stats.bytes_allocated);
+#else
+    printf("  Allocations         : not counted in this build, rebuild with \"make STATS=1\"\n");
+#endif
+}
+
+#ifdef ALLOC_STATS_ENABLED
+
+// glibc lets programs replace malloc, these are its own implementations
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    STATS_INC(allocs);
+    StatsAdd(&stats.bytes_allocated, size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size)
+{
+    STATS_INC(allocs);
+    StatsAdd(&stats.bytes_allocated, num * size);
+    return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        STATS_INC(allocs);
+    StatsAdd(&stats.bytes_allocated, size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr != NULL)
+        STATS_INC(frees);
+    __libc_free(ptr);
+}
+
+#endif
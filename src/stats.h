@@ -0,0 +1,84 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Counters for the hot paths, printed with --stats.
+// They only get updated once StatsStart() has been called, and are safe to update from several threads.
+
+// Replacing malloc and friends to count allocations is only done in debug builds or with "make STATS=1"
+#if !defined(DISABLE_DEBUG) || defined(ENABLE_ALLOC_STATS)
+#define ALLOC_STATS_ENABLED
+#endif
+
+// What a hash map is used for, the probe lengths are grouped by it
+typedef enum
+{
+    OtherMapStats,
+    IconDirMapStats,
+    ResolvedIconsMapStats,
+    ThemesMapStats,
+    NumMapStats
+} MapStatsGroup;
+
+// Which step of the lookup found an icon
+typedef enum
+{
+    AbsolutePathPhase,
+    ExactSizePhase,
+    ScalablePhase,
+    FallbackSizePhase,
+    InheritedThemePhase,
+    NotFoundPhase,
+    NumIconPhases
+} IconPhase;
+
+typedef struct
+{
+    unsigned long long gets;
+    unsigned long long probes;
+    unsigned long long max_probe;
+} MapStats;
+
+typedef struct
+{
+    unsigned long long access_backup;
+    unsigned long long access_hybrid;
+    unsigned long long access_linear;
+    unsigned long long access_absolute;
+
+    unsigned long long dirs_fully_indexed;
+    unsigned long long dirs_partially_indexed;
+    unsigned long long files_indexed;
+
+    MapStats maps[NumMapStats];
+    unsigned long long icon_phases[NumIconPhases];
+
+    // Allocations served by arenas and the chunks they took from malloc
+    unsigned long long arena_allocs;
+    unsigned long long arena_chunks;
+    unsigned long long arena_bytes;
+
+    unsigned long long intern_lookups;
+    unsigned long long interned_strings;
+    unsigned long long interned_bytes;
+
+    unsigned long long allocs;
+    unsigned long long frees;
+    unsigned long long bytes_allocated;
+} Stats;
+
+extern Stats stats;
+extern bool stats_enabled;
+
+static inline void StatsAdd(unsigned long long *counter, unsigned long long value)
+{
+    if (stats_enabled)
+        __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+#define STATS_INC(counter) StatsAdd(&stats.counter, 1)
+
+void StatsStart(void);
+void StatsRecordProbe(MapStatsGroup group, unsigned long long probes);
+void StatsPrint(bool json);
+
+#endif
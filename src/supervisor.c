@@ -0,0 +1,464 @@
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syslog.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "event_loop.h"
+#include "supervisor.h"
+#include "trace.h"
+
+// From linux/ioprio.h, which not every libc ships
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+extern char **environ;
+
+int PidfdOpen(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int PidfdSendSignal(int pidfd, int signal)
+{
+#ifdef SYS_pidfd_send_signal
+    return syscall(SYS_pidfd_send_signal, pidfd, signal, NULL, 0);
+#else
+    (void)pidfd;
+    (void)signal;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+pid_t SpawnProgram(const char *file, char *const argv[])
+{
+    posix_spawnattr_t attr;
+    sigset_t mask;
+    pid_t pid;
+
+    sigemptyset(&mask);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    long long spawn_start = TRACE_NOW();
+    int ret = posix_spawnp(&pid, file, NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+
+    if (ret != 0)
+    {
+        syslog(LOG_ERR, "JWMS: Failed to start %s: %s", file, strerror(ret));
+        return -1;
+    }
+
+    // posix_spawnp only returns once the exec went through
+    TRACE_EVENT_FMT(spawn_start, TRACE_NOW(), "spawn %s", file);
+    return pid;
+}
+
+static bool HasOptions(const SpawnOptions *options)
+{
+    return options != NULL && (options->nice != 0 || options->ioprio_class != 0 || options->has_affinity ||
+                               options->sched_idle);
+}
+
+// Runs in the forked child, a setting it isn't allowed to make (a negative nice level) is skipped
+static void ApplyOptions(const SpawnOptions *options)
+{
+    if (options->nice != 0)
+        setpriority(PRIO_PROCESS, 0, options->nice);
+
+#ifdef SYS_ioprio_set
+    if (options->ioprio_class != 0)
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                (options->ioprio_class << IOPRIO_CLASS_SHIFT) | options->ioprio_level);
+#endif
+
+    if (options->has_affinity)
+        sched_setaffinity(0, sizeof(cpu_set_t), &options->affinity);
+
+    if (options->sched_idle)
+    {
+        struct sched_param param = { .sched_priority = 0 };
+        sched_setscheduler(0, SCHED_IDLE, &param);
+    }
+}
+
+// posix_spawn can set SCHED_IDLE but not the nice level, I/O priority or affinity of the child, so a child that
+// needs any of them is forked and sets them on itself. The close-on-exec pipe carries errno back if the exec fails.
+pid_t SpawnProgramWithOptions(const char *file, char *const argv[], const SpawnOptions *options)
+{
+    if (!HasOptions(options))
+        return SpawnProgram(file, argv);
+
+    int exec_pipe[2];
+    if (pipe2(exec_pipe, O_CLOEXEC) != 0)
+    {
+        syslog(LOG_ERR, "JWMS: Failed to start %s: %s", file, strerror(errno));
+        return -1;
+    }
+
+    long long spawn_start = TRACE_NOW();
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        syslog(LOG_ERR, "JWMS: Failed to create child process for %s: %s", file, strerror(errno));
+        close(exec_pipe[0]);
+        close(exec_pipe[1]);
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigprocmask(SIG_SETMASK, &mask, NULL);
+
+        close(exec_pipe[0]);
+        ApplyOptions(options);
+        execvp(file, argv);
+
+        int error = errno;
+        while (write(exec_pipe[1], &error, sizeof(error)) < 0 && errno == EINTR);
+        _exit(127);
+    }
+
+    close(exec_pipe[1]);
+
+    int error = 0;
+    ssize_t len;
+    while ((len = read(exec_pipe[0], &error, sizeof(error))) < 0 && errno == EINTR);
+    close(exec_pipe[0]);
+
+    if (len == sizeof(error))
+    {
+        syslog(LOG_ERR, "JWMS: Failed to start %s: %s", file, strerror(error));
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+
+    TRACE_EVENT_FMT(spawn_start, TRACE_NOW(), "spawn %s", file);
+    return pid;
+}
+
+static bool IsCrash(int status)
+{
+    if (WIFSIGNALED(status))
+    {
+        int signal = WTERMSIG(status);
+        return signal != SIGTERM && signal != SIGINT && signal != SIGHUP;
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) != 0;
+}
+
+static void ArmRestartTimer(Supervisor *supervisor)
+{
+    long long earliest = -1;
+
+    for (Process *p = supervisor->processes; p != NULL; p = p->next)
+    {
+        if (p->restart_due >= 0 && (earliest < 0 || p->restart_due < earliest))
+            earliest = p->restart_due;
+    }
+
+    TimerSetDeadline(supervisor->timer, earliest);
+}
+
+static void OnPidfd(uint32_t events, void *data);
+
+static void Forget(Supervisor *supervisor, Process *process)
+{
+    Process **link = &supervisor->processes;
+    while (*link != NULL && *link != process)
+        link = &(*link)->next;
+
+    if (*link != NULL)
+        *link = process->next;
+
+    free(process->name);
+    free(process);
+}
+
+static int Run(Process *process)
+{
+    process->pid = process->spawn(process->data);
+    if (process->pid < 0)
+        return -1;
+
+    process->runs++;
+    process->started = NowMs();
+    process->trace_started = TRACE_NOW();
+    process->pidfd = PidfdOpen(process->pid);
+
+    // Without a pidfd the process is only noticed through SIGCHLD
+    if (process->pidfd >= 0)
+    {
+        process->source = EventLoopAdd(process->supervisor->loop, process->pidfd, OnPidfd, process);
+        if (process->source == NULL)
+        {
+            close(process->pidfd);
+            process->pidfd = -1;
+        }
+    }
+
+    return 0;
+}
+
+static void Exited(Process *process, int status)
+{
+    Supervisor *supervisor = process->supervisor;
+    long long now = NowMs();
+    long long run_ms = now - process->started;
+    bool restarting = false;
+
+    TRACE_EVENT_FMT(process->trace_started, TRACE_NOW(), "%s run %d", process->name, process->runs);
+
+    process->uptime += run_ms;
+    process->pid = -1;
+
+    if (process->source != NULL)
+    {
+        EventLoopRemove(supervisor->loop, process->source);
+        process->source = NULL;
+    }
+
+    if (process->pidfd >= 0)
+    {
+        close(process->pidfd);
+        process->pidfd = -1;
+    }
+
+    if (IsCrash(status))
+    {
+        process->crashes++;
+
+        if (WIFSIGNALED(status))
+            syslog(LOG_ERR, "JWMS: %s crashed with signal %d", process->name, WTERMSIG(status));
+        else
+            syslog(LOG_ERR, "JWMS: %s exited with status %d", process->name, WEXITSTATUS(status));
+    }
+
+    if (IsCrash(status) && process->restart_on_crash)
+    {
+        if (run_ms >= RESTART_STABLE_MS)
+            process->backoff = 0;
+
+        if (now - process->burst_start > RESTART_BURST_WINDOW_MS)
+        {
+            process->burst_start = now;
+            process->burst = 0;
+        }
+
+        if (process->burst >= RESTART_BURST_MAX)
+        {
+            process->gave_up = true;
+            syslog(LOG_ERR, "JWMS: %s crashed %d times within %d seconds, not restarting it again",
+                   process->name, process->burst + 1, RESTART_BURST_WINDOW_MS / 1000);
+        }
+        else
+        {
+            process->burst++;
+            process->backoff = process->backoff == 0 ? RESTART_BACKOFF_MIN_MS : process->backoff * 2;
+            if (process->backoff > RESTART_BACKOFF_MAX_MS)
+                process->backoff = RESTART_BACKOFF_MAX_MS;
+
+            process->restart_due = now + process->backoff;
+            restarting = true;
+
+            syslog(LOG_INFO, "JWMS: Restarting %s in %lld ms", process->name, process->backoff);
+            ArmRestartTimer(supervisor);
+        }
+    }
+
+    if (process->exited != NULL)
+        process->exited(process, status, restarting, process->data);
+
+    if (process->once)
+        Forget(supervisor, process);
+}
+
+static void Reap(Process *process)
+{
+    int status = 0;
+    pid_t ret = waitpid(process->pid, &status, WNOHANG);
+
+    if (ret == 0 || (ret < 0 && errno != ECHILD))
+        return;
+
+    // ECHILD would leave the pidfd readable forever, the child is gone either way
+    if (ret < 0)
+    {
+        syslog(LOG_ERR, "JWMS: Lost track of %s", process->name);
+        status = 0;
+    }
+
+    Exited(process, status);
+}
+
+static void OnPidfd(uint32_t events, void *data)
+{
+    (void)events;
+    Reap(data);
+}
+
+static void OnRestartTimer(uint32_t events, void *data)
+{
+    Supervisor *supervisor = data;
+    long long now = NowMs();
+
+    (void)events;
+    TimerClear(supervisor->timer);
+
+    for (Process *p = supervisor->processes; p != NULL; p = p->next)
+    {
+        if (p->restart_due < 0 || p->restart_due > now)
+            continue;
+
+        TRACE_EVENT_FMT((p->restart_due - p->backoff) * 1000, now * 1000, "%s backoff", p->name);
+
+        p->restart_due = -1;
+        p->restarts++;
+
+        // Not starting counts as another crash, the burst limit ends it eventually
+        p->started = now;
+        p->trace_started = TRACE_NOW();
+        if (Run(p) != 0)
+            Exited(p, W_EXITCODE(127, 0));
+    }
+
+    ArmRestartTimer(supervisor);
+}
+
+int SupervisorInit(Supervisor *supervisor, EventLoop *loop)
+{
+    supervisor->loop = loop;
+    supervisor->processes = NULL;
+    supervisor->timer_source = NULL;
+    supervisor->timer = TimerCreate();
+
+    if (supervisor->timer < 0)
+        return -1;
+
+    supervisor->timer_source = EventLoopAdd(loop, supervisor->timer, OnRestartTimer, supervisor);
+    return supervisor->timer_source != NULL ? 0 : -1;
+}
+
+static Process *Start(Supervisor *supervisor, const char *name, ProcessSpawn spawn, ProcessExit exited,
+                      void *data, bool restart_on_crash, bool once)
+{
+    Process *process = calloc(1, sizeof(Process));
+    if (process == NULL)
+        return NULL;
+
+    process->name = strdup(name);
+    process->restart_on_crash = restart_on_crash;
+    process->once = once;
+    process->spawn = spawn;
+    process->exited = exited;
+    process->data = data;
+    process->supervisor = supervisor;
+    process->pid = -1;
+    process->pidfd = -1;
+    process->restart_due = -1;
+    process->burst_start = NowMs();
+
+    if (process->name == NULL || Run(process) != 0)
+    {
+        free(process->name);
+        free(process);
+        return NULL;
+    }
+
+    // Kept in the order they were started for the stats
+    Process **tail = &supervisor->processes;
+    while (*tail != NULL)
+        tail = &(*tail)->next;
+
+    *tail = process;
+    return process;
+}
+
+Process *SupervisorStart(Supervisor *supervisor, const char *name, ProcessSpawn spawn, ProcessExit exited,
+                         void *data, bool restart_on_crash)
+{
+    return Start(supervisor, name, spawn, exited, data, restart_on_crash, false);
+}
+
+int SupervisorRunOnce(Supervisor *supervisor, const char *name, ProcessSpawn spawn, void *data)
+{
+    return Start(supervisor, name, spawn, NULL, data, false, true) != NULL ? 0 : -1;
+}
+
+void SupervisorReap(Supervisor *supervisor)
+{
+    // Reaping a one-shot process frees it
+    Process *next;
+    for (Process *p = supervisor->processes; p != NULL; p = next)
+    {
+        next = p->next;
+        if (p->pid > 0 && p->pidfd < 0)
+            Reap(p);
+    }
+}
+
+void SupervisorPrintStats(Supervisor *supervisor)
+{
+    long long now = NowMs();
+
+    printf("\nProcesses:\n");
+
+    for (Process *p = supervisor->processes; p != NULL; p = p->next)
+    {
+        long long uptime = p->uptime + (p->pid > 0 ? now - p->started : 0);
+        const char *state = p->pid > 0 ? "running" : p->restart_due >= 0 ? "restarting" :
+                            p->gave_up ? "gave up" : "exited";
+
+        printf("  %-20s: %d runs, %d restarts, %d crashes, up %.1f s, %s\n",
+               p->name, p->runs, p->restarts, p->crashes, uptime / 1000.0, state);
+    }
+
+    fflush(stdout);
+}
+
+void SupervisorDestroy(Supervisor *supervisor)
+{
+    while (supervisor->processes != NULL)
+    {
+        Process *next = supervisor->processes->next;
+
+        EventLoopRemove(supervisor->loop, supervisor->processes->source);
+        if (supervisor->processes->pidfd >= 0)
+            close(supervisor->processes->pidfd);
+
+        free(supervisor->processes->name);
+        free(supervisor->processes);
+        supervisor->processes = next;
+    }
+
+    EventLoopRemove(supervisor->loop, supervisor->timer_source);
+    if (supervisor->timer >= 0)
+        close(supervisor->timer);
+}
@@ -0,0 +1,95 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+// The children of jwms, each one watched through a pidfd in the event loop.
+// A process that crashes, it was killed by a signal other than SIGTERM, SIGINT and SIGHUP or it exited with a
+// status other than 0, gets started again if it asked for that. The restarts are spaced out by a backoff that
+// doubles from RESTART_BACKOFF_MIN_MS up to RESTART_BACKOFF_MAX_MS and starts over after a run that lasted
+// RESTART_STABLE_MS. More than RESTART_BURST_MAX restarts within RESTART_BURST_WINDOW_MS and it stays down.
+#define RESTART_BACKOFF_MIN_MS 500
+#define RESTART_BACKOFF_MAX_MS 30000
+#define RESTART_STABLE_MS 30000
+#define RESTART_BURST_MAX 5
+#define RESTART_BURST_WINDOW_MS 60000
+
+typedef struct Process Process;
+
+// Starts the process, returns its pid or -1
+typedef pid_t (*ProcessSpawn)(void *data);
+// Called on every exit, restarting tells if the supervisor brings the process back
+typedef void (*ProcessExit)(Process *process, int status, bool restarting, void *data);
+
+struct Process
+{
+    char *name;
+    bool restart_on_crash;
+    // Started by SupervisorRunOnce, freed as soon as it exited
+    bool once;
+    ProcessSpawn spawn;
+    ProcessExit exited;
+    void *data;
+    struct Supervisor *supervisor;
+
+    pid_t pid;
+    int pidfd;
+    EventSource *source;
+
+    int runs;
+    int restarts;
+    int crashes;
+    bool gave_up;
+    // CLOCK_MONOTONIC in milliseconds
+    long long started;
+    long long uptime;
+    long long backoff;
+    long long restart_due;
+    long long burst_start;
+    int burst;
+    // Trace clock, when the current run started
+    long long trace_started;
+
+    Process *next;
+};
+
+typedef struct Supervisor
+{
+    EventLoop *loop;
+    Process *processes;
+    int timer;
+    EventSource *timer_source;
+} Supervisor;
+
+int SupervisorInit(Supervisor *supervisor, EventLoop *loop);
+// Returns NULL if the process could not be started
+Process *SupervisorStart(Supervisor *supervisor, const char *name, ProcessSpawn spawn, ProcessExit exited,
+                         void *data, bool restart_on_crash);
+// A one-shot command like "jwm -reload": never restarted and forgotten once it exited, so running it again and
+// again doesn't add up. -1 if it could not be started.
+int SupervisorRunOnce(Supervisor *supervisor, const char *name, ProcessSpawn spawn, void *data);
+// Reaps the children that have no pidfd (kernels before 5.3), jwms calls it on SIGCHLD
+void SupervisorReap(Supervisor *supervisor);
+void SupervisorPrintStats(Supervisor *supervisor);
+void SupervisorDestroy(Supervisor *supervisor);
+
+// How a child gets scheduled, it sets them on itself before the exec. A zeroed SpawnOptions changes nothing.
+#define SPAWN_IOPRIO_BEST_EFFORT 2
+#define SPAWN_IOPRIO_IDLE 3
+
+typedef struct
+{
+    int nice;
+    // 0 keeps the I/O priority of jwms, level only counts for best effort (0 to 7, 0 goes first)
+    int ioprio_class;
+    int ioprio_level;
+    bool has_affinity;
+    cpu_set_t affinity;
+    bool sched_idle;
+} SpawnOptions;
+
+// posix_spawnp with the signal mask cleared, jwms keeps the signals it reads from a signalfd blocked
+pid_t SpawnProgram(const char *file, char *const argv[]);
+pid_t SpawnProgramWithOptions(const char *file, char *const argv[], const SpawnOptions *options);
+int PidfdOpen(pid_t pid);
+int PidfdSendSignal(int pidfd, int signal);
+
+#endif
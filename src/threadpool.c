@@ -0,0 +1,151 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "threadpool.h"
+
+static void *ThreadPoolWorker(void *ptr)
+{
+    ThreadPool *pool = ptr;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (true)
+    {
+        while (pool->head == NULL && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->task_ready, &pool->lock);
+        }
+
+        // Only stop once every queued task has been run
+        if (pool->head == NULL)
+            break;
+
+        ThreadPoolTask *task = pool->head;
+        pool->head = task->next;
+        if (pool->head == NULL)
+            pool->tail = NULL;
+
+        pthread_mutex_unlock(&pool->lock);
+
+        task->Func(task->args);
+        free(task);
+
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->pending == 0)
+            pthread_cond_broadcast(&pool->all_done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool *ThreadPoolCreate(size_t num_threads)
+{
+    ThreadPool *pool = malloc(sizeof(*pool));
+
+    if (pool == NULL)
+        return NULL;
+
+    pool->threads = malloc(sizeof(pthread_t) * num_threads);
+    if (pool->threads == NULL)
+    {
+        free(pool);
+        return NULL;
+    }
+
+    pool->num_threads = 0;
+    pool->head = NULL;
+    pool->tail = NULL;
+    pool->pending = 0;
+    pool->stopping = false;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->task_ready, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, ThreadPoolWorker, pool) != 0)
+        {
+            fprintf(stderr, "Failed to create worker thread %zu\n", i);
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0)
+    {
+        ThreadPoolDestroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+int ThreadPoolSubmit(ThreadPool *pool, void (*Func)(void*), void *args)
+{
+    ThreadPoolTask *task = malloc(sizeof(*task));
+
+    if (task == NULL)
+        return -1;
+
+    task->Func = Func;
+    task->args = args;
+    task->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->tail != NULL)
+        pool->tail->next = task;
+    else
+        pool->head = task;
+
+    pool->tail = task;
+    pool->pending++;
+
+    pthread_cond_signal(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+// Blocks until every submitted task has finished running
+void ThreadPoolWait(ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->pending != 0)
+    {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void ThreadPoolDestroy(ThreadPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->num_threads; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->task_ready);
+    pthread_cond_destroy(&pool->all_done);
+
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,33 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+typedef struct ThreadPoolTask
+{
+    void (*Func)(void*);
+    void *args;
+    struct ThreadPoolTask *next;
+} ThreadPoolTask;
+
+typedef struct
+{
+    pthread_t *threads;
+    size_t num_threads;
+
+    // FIFO of tasks that have not been picked up by a worker yet
+    ThreadPoolTask *head;
+    ThreadPoolTask *tail;
+    // Queued plus currently running tasks
+    size_t pending;
+    bool stopping;
+
+    pthread_mutex_t lock;
+    pthread_cond_t task_ready;
+    pthread_cond_t all_done;
+} ThreadPool;
+
+ThreadPool *ThreadPoolCreate(size_t num_threads);
+int ThreadPoolSubmit(ThreadPool *pool, void (*Func)(void*), void *args);
+void ThreadPoolWait(ThreadPool *pool);
+void ThreadPoolDestroy(ThreadPool *pool);
+
+#endif
@@ -0,0 +1,196 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+
+typedef struct
+{
+    char name[TRACE_NAME_SIZE];
+    long long start;
+    long long duration;
+    long tid;
+} TraceRecord;
+
+static TraceRecord *records = NULL;
+static size_t num_records = 0;
+static size_t records_capacity = 0;
+static bool recording = false;
+static pthread_mutex_t records_lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool TraceAvailable(void)
+{
+#ifdef TRACE_ENABLED
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Nothing gets recorded until this is called, so the timers only cost a flag check otherwise
+void TraceStart(void)
+{
+    recording = TraceAvailable();
+}
+
+// Microseconds on the monotonic clock, which is shared by every process so separate traces line up
+long long TraceNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+TraceScope TraceScopeBegin(const char *fmt, ...)
+{
+    TraceScope scope;
+
+    if (!recording)
+    {
+        scope.name[0] = '\0';
+        scope.start = -1;
+        return scope;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(scope.name, sizeof(scope.name), fmt, args);
+    va_end(args);
+
+    scope.start = TraceNow();
+    return scope;
+}
+
+void TraceScopeEnd(TraceScope *scope)
+{
+    if (scope->start < 0)
+        return;
+
+    TraceEvent(scope->name, scope->start, TraceNow());
+}
+
+void TraceEvent(const char *name, long long start, long long end)
+{
+    if (!recording)
+        return;
+
+    long tid = syscall(SYS_gettid);
+
+    pthread_mutex_lock(&records_lock);
+
+    if (num_records == records_capacity)
+    {
+        size_t new_capacity = records_capacity ? records_capacity * 2 : 256;
+        TraceRecord *new_records = realloc(records, sizeof(*records) * new_capacity);
+
+        if (new_records == NULL)
+        {
+            pthread_mutex_unlock(&records_lock);
+            return;
+        }
+
+        records = new_records;
+        records_capacity = new_capacity;
+    }
+
+    TraceRecord *record = &records[num_records++];
+    strncpy(record->name, name, sizeof(record->name) - 1);
+    record->name[sizeof(record->name) - 1] = '\0';
+    record->start = start;
+    record->duration = end - start;
+    record->tid = tid;
+
+    pthread_mutex_unlock(&records_lock);
+}
+
+void TraceEventFmt(long long start, long long end, const char *fmt, ...)
+{
+    if (!recording)
+        return;
+
+    char name[TRACE_NAME_SIZE];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(name, sizeof(name), fmt, args);
+    va_end(args);
+
+    TraceEvent(name, start, end);
+}
+
+static void WriteJSONString(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+
+    for (const char *c = str; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', fp);
+
+        // Control characters are not allowed in JSON strings
+        if ((unsigned char)*c < 0x20)
+            continue;
+
+        fputc(*c, fp);
+    }
+
+    fputc('"', fp);
+}
+
+int TraceWrite(const char *path)
+{
+    if (!TraceAvailable())
+        return -1;
+
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    pid_t pid = getpid();
+
+    pthread_mutex_lock(&records_lock);
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (size_t i = 0; i < num_records; i++)
+    {
+        TraceRecord *record = &records[i];
+
+        fprintf(fp, "{\"name\":");
+        WriteJSONString(fp, record->name);
+        fprintf(fp, ",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%ld}%s\n",
+                record->start, record->duration, pid, record->tid, i + 1 < num_records ? "," : "");
+    }
+
+    fprintf(fp, "]}\n");
+
+    pthread_mutex_unlock(&records_lock);
+
+    fclose(fp);
+    return 0;
+}
+
+void TraceStop(void)
+{
+    pthread_mutex_lock(&records_lock);
+
+    recording = false;
+    free(records);
+    records = NULL;
+    num_records = 0;
+    records_capacity = 0;
+
+    pthread_mutex_unlock(&records_lock);
+}
@@ -0,0 +1,55 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Stage timers that get exported as a Chrome trace (open it in Perfetto or chrome://tracing).
+// They are always available in debug builds, release builds need to be built with "make TRACE=1".
+#if !defined(DISABLE_DEBUG) || defined(ENABLE_TRACE)
+#define TRACE_ENABLED
+#endif
+
+#define TRACE_NAME_SIZE 96
+
+typedef struct
+{
+    char name[TRACE_NAME_SIZE];
+    long long start;
+} TraceScope;
+
+#ifdef TRACE_ENABLED
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// Times everything from here to the end of the enclosing block
+#define TRACE_SCOPE(name) \
+    TraceScope TRACE_CONCAT(trace_scope_, __LINE__) __attribute__((cleanup(TraceScopeEnd))) = TraceScopeBegin("%s", name)
+
+#define TRACE_SCOPE_FMT(fmt, ...) \
+    TraceScope TRACE_CONCAT(trace_scope_, __LINE__) __attribute__((cleanup(TraceScopeEnd))) = TraceScopeBegin(fmt, __VA_ARGS__)
+
+// For spans that don't line up with a block, like the lifetime of a child process
+#define TRACE_NOW() TraceNow()
+#define TRACE_EVENT(name, start, end) TraceEvent(name, start, end)
+#define TRACE_EVENT_FMT(start, end, fmt, ...) TraceEventFmt(start, end, fmt, __VA_ARGS__)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_FMT(fmt, ...) ((void)0)
+#define TRACE_NOW() 0LL
+#define TRACE_EVENT(name, start, end) ((void)(start), (void)(end))
+#define TRACE_EVENT_FMT(start, end, fmt, ...) ((void)(start), (void)(end))
+
+#endif
+
+bool TraceAvailable(void);
+void TraceStart(void);
+long long TraceNow(void);
+TraceScope TraceScopeBegin(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void TraceScopeEnd(TraceScope *scope);
+void TraceEvent(const char *name, long long start, long long end);
+void TraceEventFmt(long long start, long long end, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+int TraceWrite(const char *path);
+void TraceStop(void);
+
+#endif